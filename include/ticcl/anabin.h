@@ -0,0 +1,65 @@
+#ifndef TICCL_ANABIN_H
+#define TICCL_ANABIN_H
+
+#include <cstdint>
+#include <string>
+#include <set>
+#include <map>
+#include "unicode/unistr.h"
+
+// A binary version of the .anahash file, as written by TICCL-anahash with
+// the --binary option. It is meant to be mmap()-ed, so it needs no parsing
+// at all. Programs that look up their keys and words in the mapped file
+// (with find()), instead of copying it, share its pages with the other
+// programs of a pipeline.
+//
+// layout: (all values in native byte order, 8 byte aligned)
+//   char     magic[8]                  "TICCLAB1"
+//   uint64_t num_keys
+//   uint64_t num_words
+//   uint64_t pool_size
+//   int64_t  keys[num_keys]            sorted anagram hash values
+//   uint64_t first_word[num_keys+1]    key i has words first_word[i] ..
+//                                      first_word[i+1]-1
+//   uint64_t word_pos[num_words]       offset of the word in the pool
+//   uint64_t word_len[num_words]       length (in bytes) of the word
+//   char     pool[pool_size]           UTF-8 strings, every string once
+
+const std::string ANABIN_EXT = ".anabin";
+
+bool write_anabin( const std::string&,
+		   const std::map<unsigned long,std::set<icu::UnicodeString>>& );
+
+class anabin_reader {
+ public:
+  anabin_reader();
+  ~anabin_reader();
+  static bool is_anabin( const std::string& );
+  bool open( const std::string& );
+  size_t size() const { return num_keys; };
+  size_t find( int64_t ) const;
+  int64_t key( size_t i ) const { return keys[i]; };
+  size_t word_count( size_t i ) const {
+    return first_word[i+1] - first_word[i];
+  };
+  // all words are numbered 0 .. word_total()-1, key after key
+  size_t word_total() const { return num_keys > 0 ? first_word[num_keys] : 0; };
+  size_t word_index( size_t i, size_t j ) const { return first_word[i] + j; };
+  std::string word( size_t i, size_t j ) const {
+    uint64_t w = first_word[i] + j;
+    return std::string( pool + word_pos[w], word_len[w] );
+  };
+ private:
+  anabin_reader( const anabin_reader& ); // no copies
+  anabin_reader& operator=( const anabin_reader& );
+  void *mapped;
+  size_t mapped_size;
+  uint64_t num_keys;
+  const int64_t *keys;
+  const uint64_t *first_word;
+  const uint64_t *word_pos;
+  const uint64_t *word_len;
+  const char *pool;
+};
+
+#endif // TICCL_ANABIN_H
@@ -0,0 +1,51 @@
+#ifndef TICCL_CHARCLASS_H
+#define TICCL_CHARCLASS_H
+
+#include <cstdint>
+#include <vector>
+#include "unicode/unistr.h"
+
+// A dense table with an entry for every UTF-16 code unit, so the per
+// character tests of the TICCL tools become array lookups, instead of
+// ICU calls and std::map or std::set searches.
+//
+// The ICU based classes, types and lowercase mappings are filled in by the
+// constructor. The alphabet (with the anagram values of the characters, when
+// needed) is added afterwards with add().
+
+enum char_class {
+  CC_SPACE  = 1,    // u_isspace()
+  CC_PUNCT  = 2,    // ticc_ispunct()
+  CC_DIGIT  = 4,    // ticc_isdigit()
+  CC_LETTER = 8,    // ticc_isletter()
+  CC_OTHER  = 16,   // ticc_isother()
+  CC_ALPHA  = 32,   // in the alphabet
+  CC_NOCASE = 64    // lowercasing this code unit depends on its context
+};
+
+class char_table {
+ public:
+  char_table();
+  void add( UChar, uint64_t = 0 );
+  size_t alphabet_size() const { return alpha_cnt; };
+  bool in_alphabet( UChar uc ) const { return bits[uc] & CC_ALPHA; };
+  bool is( UChar uc, int cls ) const { return bits[uc] & cls; };
+  int8_t type( UChar uc ) const { return types[uc]; };
+  UChar lower( UChar uc ) const { return lowers[uc]; };
+  uint64_t value( UChar uc ) const { return values[uc]; };
+  bool simple_lower( const icu::UnicodeString& ) const;
+ private:
+  std::vector<uint64_t> values;
+  std::vector<UChar> lowers;
+  std::vector<int8_t> types;
+  std::vector<unsigned char> bits;
+  size_t alpha_cnt;
+};
+
+// The anagram value of a word, as used by TICCL-anahash: the sum of the
+// values of the characters of the lowercased word. Characters outside the
+// alphabet count as 101^5, except for spaces, which are ignored, and
+// punctuation, which counts as 100^5, but only once per word.
+uint64_t anagram_hash( const icu::UnicodeString&, const char_table& );
+
+#endif // TICCL_CHARCLASS_H
@@ -0,0 +1,18 @@
+#ifndef TICCL_DOTPRODUCT_H
+#define TICCL_DOTPRODUCT_H
+
+#include <cstddef>
+
+// The inner product of two float vectors, as used for the cosine
+// similarity of (normalised) word vectors.
+//
+// On x86 CPUs with AVX-512 or AVX2 and FMA a vectorised kernel is used,
+// otherwise a plain loop. The choice is made once, at runtime, so the
+// same binary runs on every CPU.
+
+float dot_product( const float *, const float *, size_t );
+
+// the name of the kernel in use: "avx512", "avx2" or "scalar"
+const char *dot_product_kernel();
+
+#endif // TICCL_DOTPRODUCT_H
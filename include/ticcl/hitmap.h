@@ -0,0 +1,35 @@
+#ifndef TICCL_HITMAP_H
+#define TICCL_HITMAP_H
+
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <iostream>
+#include "roaring/roaring64map.hh"
+
+// The results of the indexers, as compressed (roaring) bitmaps: for every
+// key (a character confusion value, or an anagram value) the set of values
+// it is chained to. A set<bitType> costs about 40 bytes per hit, a bitmap
+// mostly 2 bytes or less.
+//
+// Every thread adds its hits to its own table, so no locking is needed.
+// merge() ORs all tables together, in parallel.
+//
+// Only available when CRoaring is installed (HAVE_ROARING)
+
+class hit_bitmaps {
+ public:
+  explicit hit_bitmaps( size_t );
+  void add( size_t, std::vector<std::pair<int64_t,int64_t>>& );
+  void add( size_t thread, int64_t key, uint64_t value ){
+    tables[thread][key].add( value );
+  };
+  void merge();
+  size_t size_in_bytes() const;
+  void write_text( std::ostream& ) const;
+  void write_roaring( std::ostream& ) const;
+ private:
+  std::vector<std::map<int64_t,Roaring64Map>> tables;
+};
+
+#endif // TICCL_HITMAP_H
@@ -0,0 +1,56 @@
+#ifndef TICCL_HNSW_H
+#define TICCL_HNSW_H
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <utility>
+
+// An approximate nearest neighbour index, using a Hierarchical Navigable
+// Small World graph (Malkov & Yashunin, 2016).
+// The similarity is the inner product, which is the cosine similarity for
+// normalised vectors.
+// The index only stores the graph. The vectors stay owned by the caller:
+// node 'i' of the graph is vectors[i].
+//
+// The graph can be stored in a file, so it has to be built only once per
+// model. The 'signature' of the vectors (e.g. a hash of the vocabulary) is
+// stored too, and checked on loading.
+
+class hnsw_index {
+ public:
+  hnsw_index();
+  void build( const std::vector<const float*>&, size_t,
+	      size_t = 16, size_t = 200 );
+  bool save( const std::string&, uint64_t ) const;
+  bool load( const std::string&, const std::vector<const float*>&, size_t,
+	     uint64_t );
+  void search( const float *, size_t, size_t,
+	       std::vector<std::pair<float,uint32_t>>& ) const;
+  size_t size() const { return vectors.size(); };
+  bool empty() const { return vectors.empty(); };
+  void clear();
+ private:
+  typedef std::pair<float,uint32_t> candidate;
+  float similarity( const float *, uint32_t ) const;
+  uint32_t *link_list( uint32_t, int );
+  const uint32_t *link_list( uint32_t, int ) const;
+  size_t max_links( int level ) const { return level == 0 ? M0 : M; };
+  void search_layer( const float *, uint32_t, size_t, int,
+		     std::vector<candidate>& ) const;
+  uint32_t greedy_search( const float *, uint32_t, int ) const;
+  void select_neighbours( std::vector<candidate>&, size_t ) const;
+  void connect( uint32_t, uint32_t, int );
+  void insert( uint32_t, size_t );
+  std::vector<const float*> vectors;
+  size_t dim;
+  size_t M;
+  size_t M0;
+  std::vector<int> levels;
+  std::vector<uint32_t> links0;               // level 0: (M0+1) per node
+  std::vector<std::vector<uint32_t>> upper;  // levels 1.. : (M+1) per level
+  uint32_t entry_point;
+  int max_level;
+};
+
+#endif // TICCL_HNSW_H
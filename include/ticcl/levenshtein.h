@@ -0,0 +1,34 @@
+#ifndef TICCL_LEVENSHTEIN_H
+#define TICCL_LEVENSHTEIN_H
+
+#include "unicode/unistr.h"
+
+// Levenshtein (edit) distance on UTF-16 code units.
+//
+// For strings where the shortest one has at most 64 code units, the
+// bit-parallel algorithm of Myers (1999), in the formulation of Hyyrö (2003),
+// is used. This needs no heap allocation at all.
+// Longer strings fall back to the classic dynamic programming algorithm.
+//
+// The 'limit' variants stop as soon as it is certain that the distance
+// exceeds 'limit', and then return limit+1. Distances <= limit are exact.
+
+unsigned int ldCompare( const UChar *, int, const UChar *, int );
+unsigned int ldCompare( const UChar *, int, const UChar *, int,
+			unsigned int );
+
+inline unsigned int ldCompare( const icu::UnicodeString& s1,
+			       const icu::UnicodeString& s2 ){
+  return ldCompare( s1.getBuffer(), s1.length(),
+		    s2.getBuffer(), s2.length() );
+}
+
+inline unsigned int ldCompare( const icu::UnicodeString& s1,
+			       const icu::UnicodeString& s2,
+			       unsigned int limit ){
+  return ldCompare( s1.getBuffer(), s1.length(),
+		    s2.getBuffer(), s2.length(),
+		    limit );
+}
+
+#endif // TICCL_LEVENSHTEIN_H
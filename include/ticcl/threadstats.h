@@ -0,0 +1,26 @@
+#ifndef TICCL_THREADSTATS_H
+#define TICCL_THREADSTATS_H
+
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+// Small helpers for the multithreaded indexers: a lock free progress
+// counter, and the busy and idle time per thread.
+
+// the number of the calling OpenMP thread (0 without OpenMP)
+int thread_num();
+
+// the time since 'start' in seconds
+double seconds_since( const std::chrono::steady_clock::time_point& );
+
+// increment 'count', and print a dot every 100 steps and the count
+// every 5000 steps on stdout. Only the printing takes a lock
+void show_progress( std::atomic<size_t>& );
+
+// print the busy and idle time of every thread, given the busy times and
+// the total wall time
+void show_thread_stats( const std::vector<double>&, double );
+
+#endif // TICCL_THREADSTATS_H
@@ -4,6 +4,24 @@
 #include <unordered_map>
 #include <vector>
 #include <string>
+#include "ticcl/hnsw.h"
+
+// The vectors can be read from a binary word2vec model, or from a cache
+// file made with save_cache(). Both are mmap()-ed. A cache holds the
+// normalised vectors in exactly the layout of the matrix, so it is used
+// without any copying, and its pages are shared between processes.
+//
+// cache layout: (all values in native byte order)
+//   char     magic[8]                  "TICCLWV1"
+//   uint64_t num_words
+//   uint64_t dim
+//   uint64_t stride                    floats per row, a multiple of 16
+//   uint64_t pool_size
+//   uint64_t word_pos[num_words+1]     word i is pool[word_pos[i]] ..
+//                                      pool[word_pos[i+1]-1]
+//   char     pool[pool_size]           the UTF-8 words
+//   ...                                zeroes, upto a 64 byte boundary
+//   float    matrix[num_words*stride]  the normalised vectors
 
 struct word_dist {
   std::string w;
@@ -12,19 +30,75 @@ struct word_dist {
 
 class wordvec_tester {
  public:
+  wordvec_tester();
+  ~wordvec_tester();
   bool fill( const std::string& );
+  bool save_cache( const std::string& ) const;
+  bool use_cache( const std::string&, const std::string& );
+  static bool is_cache( const std::string& );
   bool lookup( const std::string&,
 	       size_t,
 	       std::vector<word_dist>& ) const;
+  void lookup( const std::vector<std::string>&,
+	       size_t,
+	       std::vector<std::vector<word_dist>>& ) const;
   double distance( const std::string&, const std::string& ) const;
   bool analogy( const std::vector<std::string>&,
 		size_t,
 		std::vector<word_dist>& );
-  size_t size() const { return vocab.size(); };
+  size_t size() const { return row_words.size(); };
   size_t dimension() const { return _dim; };
+  // optional approximate nearest neighbour index, used by lookup() and
+  // analogy() instead of comparing with ALL the vectors
+  void build_index( size_t = 16, size_t = 200 );
+  bool save_index( const std::string& ) const;
+  bool load_index( const std::string& );
+  bool use_index( const std::string& );
+  bool has_index() const { return !index.empty(); };
+  void set_search_ef( size_t ef ) { ann_ef = ef; };
  private:
-  std::unordered_map<std::string,std::vector<float>> vocab;
+  wordvec_tester( const wordvec_tester& ); // inhibit copies
+  wordvec_tester& operator=( const wordvec_tester& ); // inhibit copies
+  void clear();
+  bool read_model( const char *, size_t );
+  bool read_cache( const char *, size_t );
+  const float *row( size_t r ) const { return matrix + r * stride; };
+  const float *find( const std::string& ) const;
+  std::vector<size_t> rows_of( const std::vector<std::string>& ) const;
+  bool query_vector( const std::string&,
+		     std::vector<float>&,
+		     std::vector<std::string>& ) const;
+  void nearest( const std::vector<float>&,
+		const std::vector<std::string>&,
+		size_t,
+		std::vector<word_dist>& ) const;
+  void exact_nearest( const float *,
+		      const std::vector<size_t>&,
+		      size_t,
+		      std::vector<std::pair<float,uint32_t>>& ) const;
+  void exact_nearest( const std::vector<std::vector<float>>&,
+		      const std::vector<std::vector<size_t>>&,
+		      size_t,
+		      std::vector<std::vector<std::pair<float,uint32_t>>>& ) const;
+  void to_result( const std::vector<std::pair<float,uint32_t>>&,
+		  const std::vector<size_t>&,
+		  size_t,
+		  std::vector<word_dist>& ) const;
+  std::vector<const float*> row_pointers() const;
+  uint64_t signature() const;
+  // all the vectors, row by row, in the order of the model file.
+  // every row starts on a 64 byte boundary (padded with zeroes)
+  // it points into 'storage' for a model, or into 'mapped' for a cache
+  const float *matrix;
+  size_t stride;
+  float *storage;
+  void *mapped;
+  size_t mapped_size;
+  std::unordered_map<std::string,size_t> vocab; // word -> row
+  std::vector<std::string> row_words;
+  hnsw_index index;
   size_t _dim;
+  size_t ann_ef;
 };
 
 #endif
@@ -0,0 +1,62 @@
+#ifndef TICCL_WORDFREQ_H
+#define TICCL_WORDFREQ_H
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+// Sorting the (word,frequency) tables of the TICCL tools for output.
+// The tables can be large, so we sort pointers to their entries, and not
+// copies of them.
+
+// the order of the frequency lists: highest frequency first, then on the word
+template <class W, class F>
+inline bool freq_before( const W& w1, F f1, const W& w2, F f2 ){
+  if ( f1 != f2 ){
+    return f1 > f2;
+  }
+  return w1 < w2;
+}
+
+// sort (word pointer,frequency) pairs in the order of freq_before()
+template <class W, class F>
+void sort_on_freq( std::vector<std::pair<const W*,F>>& wf ){
+  std::sort( wf.begin(), wf.end(),
+	     []( const std::pair<const W*,F>& a,
+		 const std::pair<const W*,F>& b ){
+	       return freq_before( *a.first, a.second, *b.first, b.second );
+	     } );
+}
+
+// the entries of 'table' as (word pointer,frequency) pairs, in the order of
+// freq_before()
+template <class T>
+std::vector<std::pair<const typename T::key_type*,typename T::mapped_type>>
+sorted_on_freq( const T& table ){
+  std::vector<std::pair<const typename T::key_type*,
+			typename T::mapped_type>> result;
+  result.reserve( table.size() );
+  for ( const auto& it : table ){
+    result.push_back( std::make_pair( &it.first, it.second ) );
+  }
+  sort_on_freq( result );
+  return result;
+}
+
+// pointers to the entries of 'table', sorted on the word
+template <class T>
+std::vector<const typename T::value_type*> sorted_on_word( const T& table ){
+  std::vector<const typename T::value_type*> result;
+  result.reserve( table.size() );
+  for ( const auto& it : table ){
+    result.push_back( &it );
+  }
+  std::sort( result.begin(), result.end(),
+	     []( const typename T::value_type *a,
+		 const typename T::value_type *b ){
+	       return a->first < b->first;
+	     } );
+  return result;
+}
+
+#endif // TICCL_WORDFREQ_H
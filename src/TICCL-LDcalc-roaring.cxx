@@ -44,6 +44,8 @@
 #include "ticcutils/PrettyPrint.h"
 #include "ticcutils/Unicode.h"
 #include "ticcl/unicode.h"
+#include "ticcl/levenshtein.h"
+#include "ticcl/anabin.h"
 #include "roaring/roaring64map.hh"
 #include "config.h"
 
@@ -57,7 +59,7 @@ int verbose = 0;
 void usage( const string& progname ){
   cerr << "usage: " << progname << endl;
   cerr << "\t--index <confuslist> as produced by TICCL-indexer or TICCL-indexerNT." << endl;
-  cerr << "\t--hash <anahash>, as produced by TICCl-anahash," << endl;
+  cerr << "\t--hash <anahash>, as produced by TICCl-anahash, (.anahash or .anabin)" << endl;
   cerr << "\t--clean <cleanfile> as produced by TICCL-unk" << endl;
   cerr << "\t--diac <diacritics file> a list of 'diacritical' confusions." << endl;
   cerr << "\t--hist <historicalfile> a list of 'historical' confusions." << endl;
@@ -84,23 +86,6 @@ bitType high_five( int val ){
   return result;
 }
 
-unsigned int ldCompare( const UnicodeString& s1, const UnicodeString& s2 ){
-  const size_t len1 = s1.length(), len2 = s2.length();
-  vector<unsigned int> col(len2+1), prevCol(len2+1);
-  for ( unsigned int i = 0; i < prevCol.size(); ++i ){
-    prevCol[i] = i;
-  }
-  for ( unsigned int i = 0; i < len1; ++i ) {
-    col[0] = i+1;
-    for ( unsigned int j = 0; j < len2; ++j )
-      col[j+1] = min( min( 1 + col[j], 1 + prevCol[1 + j]),
-		      prevCol[j] + (s1[i]==s2[j] ? 0 : 1) );
-    col.swap(prevCol);
-  }
-  unsigned int result = prevCol[len2];
-  return result;
-}
-
 bool isClean( const UnicodeString& us, const set<UChar>& alfabet ){
   if ( alfabet.empty() )
     return true;
@@ -225,7 +210,13 @@ void handleTranspositions( ostream& os, const set<string>& s,
 	++it2;
 	continue;
       }
-      unsigned int ld = ldCompare( us1, us2 );
+      unsigned int ld;
+      if ( isKHC && noKHCld ){
+	ld = ldCompare( us1, us2 );
+      }
+      else {
+	ld = ldCompare( us1, us2, 2 );
+      }
       if ( ld != 2 ){
 	if ( !( isKHC && noKHCld ) ){
 	  if ( verbose > 1 ){
@@ -336,7 +327,13 @@ void compareSets( ostream& os, unsigned int ldValue,
       size_t freq2 = fit->second;
       UnicodeString us2 = TiCC::UnicodeFromUTF8( str2 );
       us2.toLower();
-      unsigned int ld = ldCompare( us1, us2 );
+      unsigned int ld;
+      if ( isKHC && noKHCld ){
+	ld = ldCompare( us1, us2 );
+      }
+      else {
+	ld = ldCompare( us1, us2, ldValue );
+      }
       if ( ld > ldValue ){
 	if ( !( isKHC && noKHCld ) ){
 	  if ( verbose > 2 ){
@@ -439,6 +436,79 @@ void compareSets( ostream& os, unsigned int ldValue,
   }
 }
 
+class hash_words {
+  // the words of every anagram value.
+  // For a text .anahash file these are kept in a map. For an .anabin file
+  // they are looked up in the mmap()-ed file itself, so nothing is copied.
+public:
+  hash_words(): binary(false){};
+  bool read_anabin( const string& );
+  bool read_text( istream& );
+  const set<string> *find( bitType, set<string>& ) const;
+  size_t size() const;
+private:
+  bool binary;
+  map<bitType,set<string>> text_map;
+  anabin_reader store;
+};
+
+bool hash_words::read_anabin( const string& file_name ){
+  binary = store.open( file_name );
+  return binary;
+}
+
+bool hash_words::read_text( istream& is ){
+  string line;
+  while ( getline( is, line ) ){
+    vector<string> v1;
+    if ( TiCC::split_at( line, v1, "~" ) != 2 )
+      continue;
+    else {
+      vector<string> v2;
+      if ( TiCC::split_at( v1[1], v2, "#" ) < 1 ){
+	cerr << progname << ": strange line: " << line << endl
+	     << " in anagram hashes file" << endl;
+	return false;
+      }
+      else {
+	bitType key = TiCC::stringTo<bitType>( v1[0] );
+	for ( size_t i=0; i < v2.size(); ++i )
+	  text_map[key].insert( v2[i] );
+      }
+    }
+  }
+  return true;
+}
+
+const set<string> *hash_words::find( bitType key,
+				     set<string>& buffer ) const {
+  // returns the words of 'key', or 0 when it is unknown.
+  // For an .anabin file, these are gathered in 'buffer'
+  if ( !binary ){
+    auto const it = text_map.find( key );
+    if ( it == text_map.end() ){
+      return 0;
+    }
+    return &it->second;
+  }
+  size_t i = store.find( key );
+  if ( i == store.size() ){
+    return 0;
+  }
+  buffer.clear();
+  for ( size_t j=0; j < store.word_count( i ); ++j ){
+    buffer.insert( store.word( i, j ) );
+  }
+  return &buffer;
+}
+
+size_t hash_words::size() const {
+  if ( !binary ){
+    return text_map.size();
+  }
+  return store.size();
+}
+
 int main( int argc, char **argv ){
   TiCC::CL_Options opts;
   try {
@@ -693,25 +763,17 @@ int main( int argc, char **argv ){
     cerr << progname << ": problem opening anagram hashes file: " << anahashFile << endl;
     exit(EXIT_FAILURE);
   }
-  map<bitType,set<string> > hashMap;
-  while ( getline( anaf, line ) ){
-    vector<string> v1;
-    if ( TiCC::split_at( line, v1, "~" ) != 2 )
-      continue;
-    else {
-      vector<string> v2;
-      if ( TiCC::split_at( v1[1], v2, "#" ) < 1 ){
-	cerr << progname << ": strange line: " << line << endl
-	     << " in anagram hashes file" << endl;
-	exit(EXIT_FAILURE);
-      }
-      else {
-	bitType key = TiCC::stringTo<bitType>( v1[0] );
-	for ( size_t i=0; i < v2.size(); ++i )
-	  hashMap[key].insert( v2[i] );
-      }
+  hash_words hashMap;
+  if ( anabin_reader::is_anabin( anahashFile ) ){
+    if ( !hashMap.read_anabin( anahashFile ) ){
+      cerr << progname << ": problem reading anagram hashes file: "
+	   << anahashFile << endl;
+      exit(EXIT_FAILURE);
     }
   }
+  else if ( !hashMap.read_text( anaf ) ){
+    exit(EXIT_FAILURE);
+  }
   cout << progname << ": read " << hashMap.size() << " hash values" << endl;
 
   size_t count=0;
@@ -757,14 +819,15 @@ int main( int argc, char **argv ){
 #pragma omp critical (debugout)
 	cout << "bekijk key1 " << key << endl;
       }
-      map<bitType,set<string> >::const_iterator sit1 = hashMap.find(key);
-      if ( sit1 == hashMap.end() ){
+      set<string> buf1;
+      const set<string> *words1 = hashMap.find( key, buf1 );
+      if ( !words1 ){
 #pragma omp critical (debugout)
 	cerr << progname << ": WARNING: found a key '" << key
 	     << "' in the input that isn't present in the hashes." << endl;
 	continue;
       }
-      if ( sit1->second.size() > 0
+      if ( words1->size() > 0
 	   && LDvalue >= 2 ){
 	bool do_trans = false;
 #pragma omp critical (debugout)
@@ -776,7 +839,7 @@ int main( int argc, char **argv ){
 	  }
 	}
 	if ( do_trans ){
-	  handleTranspositions( os, sit1->second,
+	  handleTranspositions( os, *words1,
 				freqMap, low_freqMap, alfabet,
 				artifreq, isKHC, noKHCld, isDIAC );
 	}
@@ -785,8 +848,9 @@ int main( int argc, char **argv ){
 #pragma omp critical (debugout)
 	cout << "bekijk key2 " << mainKey + key << endl;
       }
-      map<bitType, set<string> >::const_iterator sit2 = hashMap.find(mainKey+key);
-      if ( sit2 == hashMap.end() ){
+      set<string> buf2;
+      const set<string> *words2 = hashMap.find( mainKey+key, buf2 );
+      if ( !words2 ){
 	if ( verbose ){
 #pragma omp critical (debugout)
 	  cerr << progname << ": WARNING: found a key '" << key
@@ -796,7 +860,7 @@ int main( int argc, char **argv ){
 	continue;
       }
       compareSets( os, LDvalue, mainKeyS,
-		   sit1->second, sit2->second,
+		   *words1, *words2,
 		   freqMap, low_freqMap, alfabet,
 		   artifreq, isKHC, noKHCld, isDIAC );
     }
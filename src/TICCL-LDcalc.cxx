@@ -29,8 +29,14 @@
 #include <cassert>
 #include <set>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <limits>
 #include <vector>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
 #include <cstdlib>
 #include <string>
 #include <stdexcept>
@@ -45,6 +51,8 @@
 #include "ticcutils/PrettyPrint.h"
 #include "ticcutils/Unicode.h"
 #include "ticcl/unicode.h"
+#include "ticcl/levenshtein.h"
+#include "ticcl/anabin.h"
 #include "config.h"
 
 using namespace std;
@@ -58,7 +66,7 @@ int verbose = 0;
 void usage( const string& progname ){
   cerr << "usage: " << progname << endl;
   cerr << "\t--index <confuslist> as produced by TICCL-indexer or TICCL-indexerNT." << endl;
-  cerr << "\t--hash <anahash>, as produced by TICCl-anahash," << endl;
+  cerr << "\t--hash <anahash>, as produced by TICCl-anahash, (.anahash or .anabin)" << endl;
   cerr << "\t--clean <cleanfile> as produced by TICCL-unk" << endl;
   cerr << "\t--diac <diacritics file> a list of 'diacritical' confusions." << endl;
   cerr << "\t--hist <historicalfile> a list of 'historical' confusions." << endl;
@@ -91,48 +99,127 @@ bitType high_five( int val ){
   return result;
 }
 
-unsigned int ldCompare( const UnicodeString& s1, const UnicodeString& s2 ){
-  const size_t len1 = s1.length(), len2 = s2.length();
-  vector<unsigned int> col(len2+1), prevCol(len2+1);
-  for ( unsigned int i = 0; i < prevCol.size(); ++i ){
-    prevCol[i] = i;
+const UChar SEPARATOR = '_';
+
+set<string> follow_words;
+
+typedef unsigned int word_id;
+const word_id NO_WORD = numeric_limits<word_id>::max();
+
+struct lexicon_entry {
+  string word;         // as found in the .clean file
+  UnicodeString lower; // lowercased, used for the LD calculations
+  size_t freq;
+  size_t low_freq;     // the frequency of the lowercased word
+  bool is_ngram;
+  bool follow;
+};
+
+class word_table {
+  // all the words we know about, with all the information we need about
+  // them calculated once.
+  // the words from the .clean file are stored sorted, so comparing the
+  // word_id's of 2 of those gives the same result as comparing the words
+public:
+  void fill( const map<string,size_t>&, const map<UnicodeString,size_t>& );
+  word_id lookup( const string& ) const;
+  word_id add( const string&, const map<UnicodeString,size_t>& );
+  const lexicon_entry& operator[]( word_id id ) const { return entries[id]; };
+  size_t size() const { return entries.size(); };
+private:
+  lexicon_entry make_entry( const string&,
+			    size_t,
+			    const map<UnicodeString,size_t>& ) const;
+  vector<lexicon_entry> entries;
+  size_t sorted_size;
+  unordered_map<string,word_id> extras;
+};
+
+lexicon_entry word_table::make_entry( const string& word,
+				      size_t freq,
+				      const map<UnicodeString,size_t>& low_freqs ) const {
+  lexicon_entry entry;
+  entry.word = word;
+  entry.freq = freq;
+  UnicodeString us = TiCC::UnicodeFromUTF8( word );
+  entry.is_ngram = ( TiCC::split_at( us, SEPARATOR ).size() != 1 );
+  us.toLower();
+  entry.lower = us;
+  auto const it = low_freqs.find( us );
+  if ( it != low_freqs.end() ){
+    entry.low_freq = it->second;
   }
-  for ( unsigned int i = 0; i < len1; ++i ) {
-    col[0] = i+1;
-    for ( unsigned int j = 0; j < len2; ++j )
-      col[j+1] = min( min( 1 + col[j], 1 + prevCol[1 + j]),
-		      prevCol[j] + (s1[i]==s2[j] ? 0 : 1) );
-    col.swap(prevCol);
+  else {
+    entry.low_freq = 0;
   }
-  unsigned int result = prevCol[len2];
-  return result;
+  entry.follow = ( follow_words.find( word ) != follow_words.end() );
+  return entry;
 }
 
-const UChar SEPARATOR = '_';
+void word_table::fill( const map<string,size_t>& freqs,
+		       const map<UnicodeString,size_t>& low_freqs ){
+  entries.clear();
+  extras.clear();
+  entries.reserve( freqs.size() );
+  for ( const auto& it : freqs ){
+    entries.push_back( make_entry( it.first, it.second, low_freqs ) );
+  }
+  sorted_size = entries.size();
+}
 
-set<string> follow_words;
+word_id word_table::lookup( const string& word ) const {
+  // returns NO_WORD for unknown words
+  size_t low = 0;
+  size_t high = sorted_size;
+  while ( low < high ){
+    size_t mid = low + (high-low)/2;
+    int cmp = entries[mid].word.compare( word );
+    if ( cmp == 0 ){
+      return mid;
+    }
+    else if ( cmp < 0 ){
+      low = mid + 1;
+    }
+    else {
+      high = mid;
+    }
+  }
+  auto const it = extras.find( word );
+  if ( it != extras.end() ){
+    return it->second;
+  }
+  return NO_WORD;
+}
+
+word_id word_table::add( const string& word,
+			 const map<UnicodeString,size_t>& low_freqs ){
+  // add a word that isn't in the .clean file. (with frequency 0)
+  // NOT thread safe!
+  word_id id = lookup( word );
+  if ( id == NO_WORD ){
+    id = entries.size();
+    entries.push_back( make_entry( word, 0, low_freqs ) );
+    extras[word] = id;
+  }
+  return id;
+}
+
+word_table lexicon;
+
+struct ld_results;
 
 class ld_record {
+  // a small POD, the words are stored in the global lexicon
 public:
-  ld_record( const string&,
-	     const string&,
-	     const map<string,size_t>&,
-	     const map<UnicodeString,size_t>&,
+  ld_record( word_id, word_id,
 	     bool, bool, bool,
 	     bool );
   void flip(){
-    str1.swap(str2);
-    //    ls1.swap(ls2); UnicodeString.swap() is introduced in ICU56.
-    //                   Way to new for some systems :{
-    UnicodeString tmp = ls1; ls1 = ls2; ls2 = tmp; // stupid...
-    swap( freq1, freq2 );
-    swap( low_freq1, low_freq2 );
+    swap( w1, w2 );
   }
   bool analyze_ngrams( const map<UnicodeString, size_t>&,
 		       size_t, size_t,
-		       map<UnicodeString,set<UnicodeString>>&,
-		       map<UnicodeString, size_t>&,
-		       map<UnicodeString, size_t>& );
+		       ld_results& );
   bool ld_is( int );
   bool ld_check( int );
   void fill_fields( size_t );
@@ -141,108 +228,91 @@ public:
   bool acceptable( size_t, const set<UChar>& );
   UnicodeString get_key() const;
   string toString() const;
-  string str1;
-  UnicodeString ls1;
-  size_t freq1;
-  size_t low_freq1;
-  string str2;
-  UnicodeString ls2;
-  size_t freq2;
-  size_t low_freq2;
+  const string& str1() const { return lexicon[w1].word; };
+  const string& str2() const { return lexicon[w2].word; };
+  const UnicodeString& ls1() const { return lexicon[w1].lower; };
+  const UnicodeString& ls2() const { return lexicon[w2].lower; };
+  size_t freq1() const { return lexicon[w1].freq; };
+  size_t freq2() const { return lexicon[w2].freq; };
+  size_t low_freq1() const { return lexicon[w1].low_freq; };
+  size_t low_freq2() const { return lexicon[w2].low_freq; };
+  word_id w1;
+  word_id w2;
   int ld;
   int cls;
   bitType KWC;
+  int ngram_point;
   bool canon;
   bool FLoverlap;
   bool LLoverlap;
-  UnicodeString KHC;
-  int ngram_point;
   bool isKHC;
   bool noKHCld;
   bool is_diac;
   bool follow;
 };
 
+struct us_hash {
+  size_t operator()( const UnicodeString& us ) const {
+    return us.hashCode();
+  }
+};
+
+inline uint64_t record_key( word_id w1, word_id w2 ){
+  return ( (uint64_t)w1 << 32 ) | w2;
+}
 
-ld_record::ld_record( const string& s1, const string& s2,
-		      const map<string,size_t>& f_map,
-		      const map<UnicodeString,size_t>& low_f_map,
+struct ld_results {
+  // the results of one thread, so no locking is needed.
+  // At the end these are merged into sorted maps.
+  unordered_map<UnicodeString,set<UnicodeString>,us_hash> dis_map;
+  unordered_map<UnicodeString,size_t,us_hash> dis_count;
+  unordered_map<UnicodeString,size_t,us_hash> ngram_count;
+  unordered_map<uint64_t,ld_record> record_store;
+};
+
+ld_record::ld_record( word_id id1, word_id id2,
 		      bool is_KHC, bool no_KHCld, bool is_diachrone,
 		      bool following ):
-  str1(s1),
-  str2(s2),
+  w1(id1),
+  w2(id2),
   ld(-1),
   cls(0),
   KWC(0),
+  ngram_point(0),
   canon(false),
   FLoverlap(false),
   LLoverlap(false),
-  ngram_point(0),
   isKHC(is_KHC),
   noKHCld(no_KHCld),
-  is_diac(is_diachrone)
+  is_diac(is_diachrone),
+  follow(following)
 {
-  ls1 = TiCC::UnicodeFromUTF8(s1);
-  auto const it1 = f_map.find( s1 );
-  if ( it1 != f_map.end() ){
-    freq1 = it1->second;
-  }
-  else {
-    freq1 = 0;
-  }
-  ls1.toLower();
-  auto const lit1 = low_f_map.find( ls1 );
-  if ( lit1 != low_f_map.end() ){
-    low_freq1 = lit1->second;
-  }
-  else {
-    low_freq1 = 0;
-  }
-  ls2 = TiCC::UnicodeFromUTF8(s2);
-  auto const it2 = f_map.find( s2 );
-  if ( it2 != f_map.end() ){
-    freq2 = it2->second;
-  }
-  else {
-    freq2 = 0;
-  }
-  ls2.toLower();
-  auto const lit2 = low_f_map.find( ls2 );
-  if ( lit2 != low_f_map.end() ){
-    low_freq2 = lit2->second;
-  }
-  else {
-    low_freq2 = 0;
-  }
-  follow = following;
 }
 
 UnicodeString ld_record::get_key() const {
-  return TiCC::UnicodeFromUTF8( str1 ) + "~"
-    + TiCC::UnicodeFromUTF8( str2 );
+  return TiCC::UnicodeFromUTF8( str1() ) + "~"
+    + TiCC::UnicodeFromUTF8( str2() );
 }
 
 bool ld_record::analyze_ngrams( const map<UnicodeString, size_t>& low_freqMap,
 				size_t freqThreshold,
 				size_t low_limit,
-				map<UnicodeString,set<UnicodeString>>& dis_map,
-				map<UnicodeString, size_t>& dis_count,
-				map<UnicodeString, size_t>& ngram_count ){
+				ld_results& results ){
   ngram_point = 0;
-  UnicodeString us1 = TiCC::UnicodeFromUTF8(str1);
-  UnicodeString us2 = TiCC::UnicodeFromUTF8(str2);
-  vector<UnicodeString> parts1 = TiCC::split_at( us1, SEPARATOR );
-  vector<UnicodeString> parts2 = TiCC::split_at( us2, SEPARATOR );
-  if ( parts1.size() == 1 && parts2.size() == 1 ){
+  if ( !lexicon[w1].is_ngram && !lexicon[w2].is_ngram ){
     if ( follow ){
 #pragma omp critical (debugout)
       {
-	cerr << "ngram candidates: " << parts1[0] << " AND " << parts2[0]
+	cerr << "ngram candidates: " << str1() << " AND " << str2()
 	     << " are UNIGRAMS: nothing to do" << endl;
       }
     }
     return false; // nothing special for unigrams
   }
+  UnicodeString us1 = TiCC::UnicodeFromUTF8(str1());
+  UnicodeString us2 = TiCC::UnicodeFromUTF8(str2());
+  vector<UnicodeString> parts1 = TiCC::split_at( us1, SEPARATOR );
+  vector<UnicodeString> parts2 = TiCC::split_at( us2, SEPARATOR );
   UnicodeString diff_part1;
   UnicodeString diff_part2;
   if ( parts1.size() == parts2.size() ){
@@ -399,32 +469,26 @@ bool ld_record::analyze_ngrams( const map<UnicodeString, size_t>& low_freqMap,
   if ( (size_t)diff_part1.length() < low_limit ){
     // a 'short' word
     // count this short words pair AND store the original n-gram pair
-#pragma omp critical (update)
-    {
-      dis_map[disamb_pair].insert( us1 + "~" + us2 );
-      ++dis_count[disamb_pair];
-    }
+    results.dis_map[disamb_pair].insert( us1 + "~" + us2 );
+    ++results.dis_count[disamb_pair];
     if ( follow ){
 #pragma omp critical (debugout)
       {
 	cerr << "stored: short " << disamb_pair << " and forget about "
-	     << str1 << "~" << str2 << endl;
+	     << str1() << "~" << str2() << endl;
       }
     }
   }
   else {
     // count the pair
-#pragma omp critical (update)
-    {
-      ++ngram_count[disamb_pair];
-      // keep pair for later
-    }
+    ++results.ngram_count[disamb_pair];
+    // keep pair for later
     // signal to discard this ngram (in favor of the unigram within)
     if ( follow ){
 #pragma omp critical (debugout)
       {
 	cerr << "stored: " << disamb_pair << " and forget about "
-	     << str1 << "~" << str2 << endl;
+	     << str1() << "~" << str2() << endl;
       }
     }
   }
@@ -432,7 +496,14 @@ bool ld_record::analyze_ngrams( const map<UnicodeString, size_t>& low_freqMap,
 }
 
 bool ld_record::ld_is( int wanted ) {
-  ld = ldCompare( ls1, ls2 );
+  if ( ( isKHC && noKHCld ) || follow ){
+    // we need the real distance
+    ld = ldCompare( ls1(), ls2() );
+  }
+  else {
+    // stop calculating as soon as we know that we will reject
+    ld = ldCompare( ls1(), ls2(), wanted );
+  }
   if ( ld != wanted ){
     if ( !( isKHC && noKHCld ) ){
       if ( follow ){
@@ -454,20 +525,27 @@ bool ld_record::ld_is( int wanted ) {
   if ( follow ){
 #pragma omp critical (debugout)
     {
-      cout << "LD(" << ls1 << "," << ls2 << ")=" << ld << " OK!" << endl;
+      cout << "LD(" << ls1() << "," << ls2() << ")=" << ld << " OK!" << endl;
     }
   }
   return true;
 }
 
 bool ld_record::ld_check( int ldvalue ) {
-  ld = ldCompare( ls1, ls2 );
+  if ( ( isKHC && noKHCld ) || follow ){
+    // we need the real distance
+    ld = ldCompare( ls1(), ls2() );
+  }
+  else {
+    // stop calculating as soon as we know that we will reject
+    ld = ldCompare( ls1(), ls2(), ldvalue );
+  }
   if ( ld <= ldvalue ){
     // LD is ok
     if ( follow ){
 #pragma omp critical (debugout)
       {
-	cout << "LD(" << ls1 << "," << ls2 << ") =" << ld
+	cout << "LD(" << ls1() << "," << ls2() << ") =" << ld
 	     << " OK,  <= " << ldvalue << endl;
       }
     }
@@ -498,7 +576,7 @@ bool ld_record::ld_check( int ldvalue ) {
   if ( follow ){
 #pragma omp critical (debugout)
     {
-      cout << "LD(" << ls1 << "," << ls2 << ") =" << ld
+      cout << "LD(" << ls1() << "," << ls2() << ") =" << ld
 	   << " rejected > " << ldvalue << endl;
     }
   }
@@ -506,12 +584,12 @@ bool ld_record::ld_check( int ldvalue ) {
 }
 
 bool ld_record::acceptable( size_t threshold, const set<UChar>& alfabet ) {
-  if ( low_freq1 >= threshold && !is_diac ){
+  if ( low_freq1() >= threshold && !is_diac ){
     // reject correction of lexical words, except for diachrone translations
     if ( follow ){
 #pragma omp critical (debugout)
       {
-	cout << str1 << "~" << str2 << " rejected: Lexical, and not diachrone"
+	cout << str1() << "~" << str2() << " rejected: Lexical, and not diachrone"
 	     << endl;
       }
     }
@@ -519,13 +597,13 @@ bool ld_record::acceptable( size_t threshold, const set<UChar>& alfabet ) {
   }
   if ( !alfabet.empty() ){
     // reject non lexically clean Corection Candidates
-    for ( int i=0; i < ls2.length(); ++i ){
-      if ( alfabet.find( ls2[i] ) == alfabet.end() ){
+    for ( int i=0; i < ls2().length(); ++i ){
+      if ( alfabet.find( ls2()[i] ) == alfabet.end() ){
 	if ( follow ){
 #pragma omp critical (debugout)
 	  {
-	    cout << str1 << "~" << str2 << " rejected: "
-		 << UnicodeString( ls2[i] ) << " not in alphabet" << endl;
+	    cout << str1() << "~" << str2() << " rejected: "
+		 << UnicodeString( ls2()[i] ) << " not in alphabet" << endl;
 	  }
 	}
 	return false;
@@ -537,12 +615,12 @@ bool ld_record::acceptable( size_t threshold, const set<UChar>& alfabet ) {
 
 bool ld_record::test_frequency( size_t threshold ){
   // avoid non lexical Correction Candidates
-  if ( low_freq2 < threshold ){
+  if ( low_freq2() < threshold ){
     if ( follow ){
 #pragma omp critical (debugout)
       {
-	cout << str1 << "~" << str2 << " rejected: " << str2
-	     << " is low frequent: " << low_freq2 << endl;
+	cout << str1() << "~" << str2() << " rejected: " << str2()
+	     << " is low frequent: " << low_freq2() << endl;
       }
     }
     return false;
@@ -552,11 +630,11 @@ bool ld_record::test_frequency( size_t threshold ){
 
 void ld_record::sort_high_second(){
   // order the record with the highest (most probable) freqency as CC
-  if ( low_freq1 > low_freq2 ){
+  if ( low_freq1() > low_freq2() ){
     if ( follow ){
 #pragma omp critical (debugout)
       {
-	cout << "flip " << str1 << "~" << str2 << endl;
+	cout << "flip " << str1() << "~" << str2() << endl;
       }
     }
     flip();
@@ -564,19 +642,19 @@ void ld_record::sort_high_second(){
 }
 
 void ld_record::fill_fields( size_t freqThreshold ) {
-  cls = max(ls1.length(),ls2.length()) - ld;
+  cls = max(ls1().length(),ls2().length()) - ld;
   LLoverlap = false;
-  if ( ls1.length() > 1 && ls2.length() > 1
-       && ls1[ls1.length()-1] == ls2[ls2.length()-1]
-       && ls1[ls1.length()-2] == ls2[ls2.length()-2] ){
+  if ( ls1().length() > 1 && ls2().length() > 1
+       && ls1()[ls1().length()-1] == ls2()[ls2().length()-1]
+       && ls1()[ls1().length()-2] == ls2()[ls2().length()-2] ){
     LLoverlap = true;
   }
   FLoverlap = false;
-  if ( ls1[0] == ls2[0] ){
+  if ( ls1()[0] == ls2()[0] ){
     FLoverlap = true;
   }
   canon = false;
-  if ( low_freq2 >= freqThreshold ){
+  if ( low_freq2() >= freqThreshold ){
     canon = true;
   }
 }
@@ -587,8 +665,8 @@ string ld_record::toString() const {
   string LLoverlap_s = (LLoverlap?"1":"0");;
   string KHC = (isKHC?"1":"0");
   stringstream ss;
-  ss << str1 << "~" << freq1 << "~" << low_freq1 << "~"
-     << str2 << "~" << freq2 << "~" << low_freq2 << "~"
+  ss << str1() << "~" << freq1() << "~" << low_freq1() << "~"
+     << str2() << "~" << freq2() << "~" << low_freq2() << "~"
      << KWC << "~" << ld << "~"
      << cls << "~" << canon_s << "~"
      << FLoverlap_s << "~" << LLoverlap_s << "~"
@@ -598,9 +676,7 @@ string ld_record::toString() const {
 
 bool transpose_pair( ld_record& record,
 		     const map<UnicodeString,size_t>& low_freqMap,
-		     map<UnicodeString,set<UnicodeString>>& dis_map,
-		     map<UnicodeString, size_t>& dis_count,
-		     map<UnicodeString, size_t>& ngram_count,
+		     ld_results& results,
 		     size_t freqThreshold,
 		     size_t low_limit,
 		     const set<UChar>& alfabet,
@@ -608,8 +684,8 @@ bool transpose_pair( ld_record& record,
   if ( following ){
 #pragma omp critical (debugout)
     {
-      cout << "TRANSPOSE: string 1 " << record.str1
-	   << " string 2 " << record.str2 << endl;
+      cout << "TRANSPOSE: string 1 " << record.str1()
+	   << " string 2 " << record.str2() << endl;
     }
   }
   record.sort_high_second();
@@ -620,14 +696,14 @@ bool transpose_pair( ld_record& record,
     return false;
   }
   if ( record.analyze_ngrams( low_freqMap, freqThreshold, low_limit,
-			      dis_map, dis_count, ngram_count ) ){
+			      results ) ){
     return false;
   }
   if ( !record.ld_is( 2 ) ){
     if ( following ){
 #pragma omp critical (debugout)
       {
-	cout << " LD != 2 " << record.str1 << "," << record.str2 << endl;
+	cout << " LD != 2 " << record.str1() << "," << record.str2() << endl;
       }
     }
     return false;
@@ -639,44 +715,30 @@ bool transpose_pair( ld_record& record,
   return true;
 }
 
-void handleTranspositions( const set<string>& s,
-			   const map<string,size_t>& freqMap,
+void handleTranspositions( const vector<word_id>& s,
 			   const map<UnicodeString,size_t>& low_freqMap,
 			   const set<UChar>& alfabet,
-			   map<UnicodeString,set<UnicodeString>>& dis_map,
-			   map<UnicodeString, size_t>& dis_count,
-			   map<UnicodeString, size_t>& ngram_count,
 			   size_t freqThreshold,
 			   size_t low_limit,
 			   bool isKHC,
 			   bool noKHCld,
 			   bool isDIAC,
-			   map<UnicodeString,ld_record>& record_store ){
+			   ld_results& results ){
   auto it1 = s.begin();
   while ( it1 != s.end() ) {
-    bool following = false;
-    string str1 = *it1;
-    if ( follow_words.find( str1 ) != follow_words.end() ){
-      following = true;
-    }
+    bool following = lexicon[*it1].follow;
     auto it2 = it1;
     ++it2;
     while ( it2 != s.end() ) {
-      string str2 = *it2;
-      if ( follow_words.find( str2 ) != follow_words.end() ){
+      if ( lexicon[*it2].follow ){
 	following = true;
       }
-      ld_record record( str1, str2,
-			freqMap, low_freqMap,
+      ld_record record( *it1, *it2,
 			isKHC, noKHCld, isDIAC, following );
-      if ( transpose_pair( record, low_freqMap,
-			   dis_map, dis_count, ngram_count,
+      if ( transpose_pair( record, low_freqMap, results,
 			   freqThreshold, low_limit, alfabet, following ) ){
-	UnicodeString key = record.get_key();
-#pragma omp critical (output)
-	{
-	  record_store.emplace(key,record);
-	}
+	results.record_store.emplace( record_key( record.w1, record.w2 ),
+				      record );
       }
       ++it2;
     }
@@ -688,9 +750,7 @@ void handleTranspositions( const set<string>& s,
 bool compare_pair( ld_record& record,
 		   const map<UnicodeString,size_t>& low_freqMap,
 		   int ldValue, size_t KWC,
-		   map<UnicodeString,set<UnicodeString>>& dis_map,
-		   map<UnicodeString, size_t>& dis_count,
-		   map<UnicodeString, size_t>& ngram_count,
+		   ld_results& results,
 		   size_t freqThreshold,
 		   size_t low_limit,
 		   const set<UChar>& alfabet,
@@ -703,7 +763,7 @@ bool compare_pair( ld_record& record,
     return false;
   }
   if ( record.analyze_ngrams( low_freqMap, freqThreshold, low_limit,
-			      dis_map, dis_count, ngram_count ) ){
+			      results ) ){
     return false;
   }
   record.fill_fields( freqThreshold );
@@ -716,58 +776,41 @@ bool compare_pair( ld_record& record,
 
 void compareSets( int ldValue,
 		  bitType KWC,
-		  const set<string>& s1, const set<string>& s2,
-		  const map<string,size_t>& freqMap,
+		  const vector<word_id>& s1, const vector<word_id>& s2,
 		  const map<UnicodeString,size_t>& low_freqMap,
 		  const set<UChar>& alfabet,
-		  map<UnicodeString,set<UnicodeString>>& dis_map,
-		  map<UnicodeString, size_t>& dis_count,
-		  map<UnicodeString, size_t>& ngram_count,
 		  size_t freqThreshold,
 		  size_t low_limit,
 		  bool isKHC,
 		  bool noKHCld,
 		  bool isDIAC,
-		  map<UnicodeString,ld_record>& record_store ){
-  // using TiCC::operator<<;
-  // cerr << "set 1 " << s1 << endl;
-  // cerr << "set 2 " << s2 << endl;
+		  ld_results& results ){
   auto it1 = s1.begin();
   while ( it1 != s1.end() ) {
-    bool following = false;
-    string str1 = *it1;
-    if ( follow_words.find( str1 ) != follow_words.end() ){
-      following = true;
-    }
+    bool following = lexicon[*it1].follow;
     if ( following ){
 #pragma omp critical (debugout)
       {
-	cout << "SET: string 1 " << str1 << endl;
+	cout << "SET: string 1 " << lexicon[*it1].word << endl;
       }
     }
     auto it2 = s2.begin();
     while ( it2 != s2.end() ) {
-      string str2 = *it2;
-      if ( follow_words.find( str2 ) != follow_words.end() ){
+      if ( lexicon[*it2].follow ){
 	following = true;
       }
       if ( following ){
 #pragma omp critical (debugout)
 	{
-	  cout << "SET: string 2 " << str2 << endl;
+	  cout << "SET: string 2 " << lexicon[*it2].word << endl;
 	}
       }
-      ld_record record( str1, str2,
-			freqMap, low_freqMap,
+      ld_record record( *it1, *it2,
 			isKHC, noKHCld, isDIAC, following );
-      if ( compare_pair( record, low_freqMap, ldValue, KWC,
-			 dis_map, dis_count, ngram_count,
+      if ( compare_pair( record, low_freqMap, ldValue, KWC, results,
 			 freqThreshold, low_limit, alfabet, following ) ){
-	UnicodeString key = record.get_key();
-#pragma omp critical (output)
-	{
-	  record_store.emplace(key,record);
-	}
+	results.record_store.emplace( record_key( record.w1, record.w2 ),
+				      record );
       }
       ++it2;
     }
@@ -775,15 +818,251 @@ void compareSets( int ldValue,
   }
 }
 
+struct work_item {
+  bitType mainKey;
+  bitType key;
+  bool isKHC;
+  bool isDIAC;
+  bool do_trans; // first occurrence of 'key', so handle the transpositions
+};
+
+class work_queue {
+  // a bounded queue between the thread reading the index file and the
+  // threads that do the actual work
+public:
+  explicit work_queue( size_t cap ): capacity(cap), closed(false) {};
+  bool try_push( const work_item& );
+  bool pop( work_item&, bool );
+  void close();
+private:
+  mutex mtx;
+  condition_variable available;
+  deque<work_item> items;
+  size_t capacity;
+  bool closed;
+};
+
+bool work_queue::try_push( const work_item& item ){
+  {
+    lock_guard<mutex> lock( mtx );
+    if ( items.size() >= capacity ){
+      return false;
+    }
+    items.push_back( item );
+  }
+  available.notify_one();
+  return true;
+}
+
+bool work_queue::pop( work_item& item, bool wait ){
+  // get the next item. When 'wait' is true, block until one is available
+  // returns false when there are no items left.
+  unique_lock<mutex> lock( mtx );
+  while ( wait && !closed && items.empty() ){
+    available.wait( lock );
+  }
+  if ( items.empty() ){
+    return false;
+  }
+  item = items.front();
+  items.pop_front();
+  return true;
+}
+
+void work_queue::close(){
+  {
+    lock_guard<mutex> lock( mtx );
+    closed = true;
+  }
+  available.notify_all();
+}
+
+class hash_words {
+  // the lexicon words of every anagram value.
+  // For a text .anahash file these are kept in a map. For an .anabin file
+  // the keys are looked up in the mmap()-ed file itself, and we only keep
+  // the lexicon id of every word in it.
+public:
+  hash_words(): binary(false), binary_keys(0){};
+  bool read_anabin( const string& );
+  bool read_text( istream& );
+  const vector<word_id> *find( bitType, vector<word_id>& ) const;
+  size_t size() const;
+private:
+  bool binary;
+  size_t binary_keys; // the keys of the .anabin with lexicon words
+  map<bitType,vector<word_id>> text_map;
+  anabin_reader store;
+  vector<word_id> store_ids;
+};
+
+bool hash_words::read_anabin( const string& file_name ){
+  if ( !store.open( file_name ) ){
+    return false;
+  }
+  binary = true;
+  store_ids.resize( store.word_total() );
+  for ( size_t i=0; i < store.size(); ++i ){
+    bool found = false;
+    for ( size_t j=0; j < store.word_count( i ); ++j ){
+      string word = store.word( i, j );
+      word_id id = lexicon.lookup( word );
+      if ( id != NO_WORD ){
+	found = true;
+      }
+      else if ( verbose > 1 ){
+	cerr << "skip hash for " << word << " (not in lexicon)" << endl;
+      }
+      store_ids[store.word_index( i, j )] = id;
+    }
+    if ( found ){
+      ++binary_keys;
+    }
+  }
+  return true;
+}
+
+bool hash_words::read_text( istream& is ){
+  string line;
+  while ( getline( is, line ) ){
+    vector<string> v1;
+    if ( TiCC::split_at( line, v1, "~" ) != 2 )
+      continue;
+    else {
+      vector<string> v2;
+      if ( TiCC::split_at( v1[1], v2, "#" ) < 1 ){
+	cerr << progname << ": strange line: " << line << endl
+	     << " in anagram hashes file" << endl;
+	return false;
+      }
+      else {
+	bitType key = TiCC::stringTo<bitType>( v1[0] );
+	for ( size_t i=0; i < v2.size(); ++i ){
+	  word_id id = lexicon.lookup( v2[i] );
+	  if ( id != NO_WORD ){
+	    // only store words from the .clean lexicon
+	    text_map[key].push_back( id );
+	  }
+	  else {
+	    if ( verbose > 1 ){
+	      cerr << "skip hash for " << v2[i] << " (not in lexicon)" << endl;
+	    }
+	  }
+	}
+      }
+    }
+  }
+  for ( auto& it : text_map ){
+    // sorted id's means sorted words
+    sort( it.second.begin(), it.second.end() );
+    it.second.erase( unique( it.second.begin(), it.second.end() ),
+		     it.second.end() );
+  }
+  return true;
+}
+
+const vector<word_id> *hash_words::find( bitType key,
+					 vector<word_id>& buffer ) const {
+  // returns the sorted lexicon words of 'key', or 0 when it has none.
+  // For an .anabin file, these are gathered in 'buffer'
+  if ( !binary ){
+    auto const it = text_map.find( key );
+    if ( it == text_map.end() ){
+      return 0;
+    }
+    return &it->second;
+  }
+  size_t i = store.find( key );
+  if ( i == store.size() ){
+    return 0;
+  }
+  buffer.clear();
+  for ( size_t j=0; j < store.word_count( i ); ++j ){
+    word_id id = store_ids[store.word_index( i, j )];
+    if ( id != NO_WORD ){
+      buffer.push_back( id );
+    }
+  }
+  if ( buffer.empty() ){
+    return 0;
+  }
+  sort( buffer.begin(), buffer.end() );
+  buffer.erase( unique( buffer.begin(), buffer.end() ), buffer.end() );
+  return &buffer;
+}
+
+size_t hash_words::size() const {
+  if ( !binary ){
+    return text_map.size();
+  }
+  return binary_keys;
+}
+
+void handle_item( const work_item& item,
+		  int LDvalue,
+		  const hash_words& hashMap,
+		  const map<UnicodeString,size_t>& low_freqMap,
+		  const set<UChar>& alfabet,
+		  size_t freqThreshold,
+		  size_t low_limit,
+		  bool noKHCld,
+		  ld_results& results ){
+  const bitType key = item.key;
+  const bitType mainKey = item.mainKey;
+  if ( verbose > 1 ){
+#pragma omp critical (debugout)
+    cout << "bekijk key1 " << key << endl;
+  }
+  vector<word_id> buf1;
+  const vector<word_id> *words1 = hashMap.find( key, buf1 );
+  if ( !words1 ){
+    if ( verbose > 1 ){
+#pragma omp critical (debugout)
+      cerr << progname << ": WARNING: found a key '" << key
+	   << "' in the input that isn't present in the hashes." << endl;
+    }
+    return;
+  }
+  if ( item.do_trans
+       && LDvalue >= 2 ){
+    handleTranspositions( *words1,
+			  low_freqMap, alfabet,
+			  freqThreshold, low_limit,
+			  item.isKHC, noKHCld, item.isDIAC,
+			  results );
+  }
+  if ( verbose > 1 ){
+#pragma omp critical (debugout)
+    cout << "bekijk key2 " << mainKey + key << endl;
+  }
+  vector<word_id> buf2;
+  const vector<word_id> *words2 = hashMap.find( mainKey+key, buf2 );
+  if ( !words2 ){
+    if ( verbose > 4 ){
+#pragma omp critical (debugout)
+      cerr << progname << ": WARNING: found a key '" << key
+	   << "' in the input that, when added to '" << mainKey
+	   << "' isn't present in the hashes." << endl;
+    }
+    return;
+  }
+  compareSets( LDvalue, mainKey,
+	       *words1, *words2,
+	       low_freqMap, alfabet,
+	       freqThreshold, low_limit, item.isKHC, noKHCld, item.isDIAC,
+	       results );
+}
+
 void add_short( ostream& os,
 		const map<UnicodeString,size_t>& dis_count,
-		const map<string,size_t>& freqMap,
 		const map<UnicodeString,size_t>& low_freqMap,
 		int max_ld, size_t threshold ){
   for ( const auto& entry : dis_count ){
     vector<UnicodeString> parts = TiCC::split_at( entry.first, "~" );
-    ld_record rec( TiCC::UnicodeToUTF8(parts[0]), TiCC::UnicodeToUTF8(parts[1]),
-		   freqMap, low_freqMap,
+    // these short words might not be in the lexicon yet
+    word_id w1 = lexicon.add( TiCC::UnicodeToUTF8(parts[0]), low_freqMap );
+    word_id w2 = lexicon.add( TiCC::UnicodeToUTF8(parts[1]), low_freqMap );
+    ld_record rec( w1, w2,
 		   false, false, false, false );
     if ( !rec.ld_check( max_ld ) ){
       continue;
@@ -1018,6 +1297,9 @@ int main( int argc, char **argv ){
   }
   cout << progname << ": read " << freqMap.size()
        << " clean words with frequencies." << endl;
+  // from now on, we use the lexicon
+  lexicon.fill( freqMap, low_freqMap );
+  freqMap.clear();
   if ( skipped > 0 ){
     cout << progname << ": skipped " << skipped << " out-of-band words."
 	 << endl;
@@ -1090,166 +1372,146 @@ int main( int argc, char **argv ){
     cerr << progname << ": problem opening anagram hashes file: " << anahashFile << endl;
     exit(EXIT_FAILURE);
   }
-  map<bitType,set<string> > hashMap;
-  while ( getline( anaf, line ) ){
-    vector<string> v1;
-    if ( TiCC::split_at( line, v1, "~" ) != 2 )
-      continue;
-    else {
-      vector<string> v2;
-      if ( TiCC::split_at( v1[1], v2, "#" ) < 1 ){
-	cerr << progname << ": strange line: " << line << endl
-	     << " in anagram hashes file" << endl;
-	exit(EXIT_FAILURE);
-      }
-      else {
-	bitType key = TiCC::stringTo<bitType>( v1[0] );
-	for ( size_t i=0; i < v2.size(); ++i ){
-	  auto it = freqMap.find( v2[i] );
-	  if ( it != freqMap.end() ){
-	    // only store words from the .clean lexicon
-	    hashMap[key].insert( v2[i] );
-	  }
-	  else {
-	    if ( verbose > 1 ){
-	      cerr << "skip hash for " << v2[i] << " (not in lexicon)" << endl;
-	    }
-	  }
-	}
-      }
+  hash_words hashMap;
+  if ( anabin_reader::is_anabin( anahashFile ) ){
+    if ( !hashMap.read_anabin( anahashFile ) ){
+      cerr << progname << ": problem reading anagram hashes file: "
+	   << anahashFile << endl;
+      exit(EXIT_FAILURE);
     }
   }
+  else if ( !hashMap.read_text( anaf ) ){
+    exit(EXIT_FAILURE);
+  }
   cout << progname << ": read " << hashMap.size() << " hash values" << endl;
 
   size_t count=0;
-  set<bitType> handledTrans;
+  unordered_set<bitType> handledTrans;
   map<UnicodeString,set<UnicodeString>> dis_map;
   map<UnicodeString,size_t> dis_count;
   map<UnicodeString,size_t> ngram_count;
-  map<UnicodeString,ld_record> record_store;
+  unordered_map<uint64_t,ld_record> record_store;
   size_t line_nr = 0;
   int err_cnt = 0;
 
-  size_t file_lines = 0;
-  while ( getline( indexf, line ) ){
-    ++file_lines;
-  }
-  cout << progname << ": " << file_lines << " character confusion values to be read.\n\t\tWe indicate progress by printing a dot for every 1000 confusion values processed" << endl;
-  indexf.clear();
-  indexf.seekg( 0 );
-  while ( getline( indexf, line ) ){
-    if ( err_cnt > 9 ){
-      cerr << progname << ": FATAL ERROR: too many problems in indexfile: " << indexFile
-	   << " terminated" << endl;
-      exit( EXIT_FAILURE);
-    }
-    ++line_nr;
-    if ( verbose > 1 ){
-      cerr << "examine " << line << endl;
-    }
-    line = TiCC::trim(line);
-    if ( line.empty() ){
-      continue;
-    }
-    vector<string> parts;
-    if ( TiCC::split_at( line, parts, "#" ) != 2 ){
-      cerr << progname << ": ERROR in line " << line_nr
-	   << " of indexfile: unable to split in 2 parts at #"
-	   << endl << "line was" << endl << line << endl;
-      ++err_cnt;
-    }
-    else {
-      string key_s = parts[0];
-      if ( ++count % 1000 == 0 ){
-	cout << ".";
-	cout.flush();
-	if ( count % 50000 == 0 ){
-	  cout << endl << count << endl;;
+  cout << progname << ": reading character confusion values from "
+       << indexFile << "\n\t\tWe indicate progress by printing a dot for every 1000 confusion values processed" << endl;
+  // one thread reads the index file and feeds (mainKey,key) items to
+  // a queue, while all the other threads process them
+  work_queue queue( 10000 );
+#ifdef HAVE_OPENMP
+  vector<ld_results> thread_results( omp_get_max_threads() );
+#else
+  vector<ld_results> thread_results( 1 );
+#endif
+#pragma omp parallel shared( queue, thread_results )
+  {
+#ifdef HAVE_OPENMP
+    ld_results& results = thread_results[omp_get_thread_num()];
+#else
+    ld_results& results = thread_results[0];
+#endif
+#pragma omp single nowait
+    {
+      while ( getline( indexf, line ) ){
+	if ( err_cnt > 9 ){
+	  cerr << progname << ": FATAL ERROR: too many problems in indexfile: " << indexFile
+	       << " terminated" << endl;
+	  exit( EXIT_FAILURE);
 	}
-      }
-      string rest = parts[1];
-      if ( verbose > 1 ){
-	cerr << "extract parts from " << rest << endl;
-      }
-      if ( TiCC::split_at( rest, parts, "," ) < 1 ){
-	cerr << progname << ": ERROR in line " << line_nr
-	     << " of indexfile: unable to split in parts separated by ','"
-	     << endl << "line was" << endl << line << endl;
-	++err_cnt;
-      }
-      else {
-	bitType mainKey = TiCC::stringTo<bitType>(key_s);
-	bool isKHC = false;
-	if ( histMap.find( mainKey ) != histMap.end() ){
-	  isKHC = true;
+	++line_nr;
+	if ( verbose > 1 ){
+#pragma omp critical (debugout)
+	  cerr << "examine " << line << endl;
 	}
-	bool isDIAC = false;
-	if ( diaMap.find( mainKey ) != diaMap.end() ){
-	  isDIAC = true;
+	line = TiCC::trim(line);
+	if ( line.empty() ){
+	  continue;
 	}
-#pragma omp parallel for schedule(dynamic,1)
-	for ( size_t i=0; i < parts.size(); ++i ){
-	  string keyS = parts[i];
-	  bitType key = TiCC::stringTo<bitType>(keyS);
-	  if ( verbose > 1 ){
-#pragma omp critical (debugout)
-	    cout << "bekijk key1 " << key << endl;
-	  }
-	  map<bitType,set<string> >::const_iterator sit1 = hashMap.find(key);
-	  if ( sit1 == hashMap.end() ){
-	    if ( verbose > 1 ){
-#pragma omp critical (debugout)
-	      cerr << progname << ": WARNING: found a key '" << key
-		   << "' in the input that isn't present in the hashes." << endl;
-	    }
-	    continue;
-	  }
-	  if ( sit1->second.size() > 0
-	       && LDvalue >= 2 ){
-	    bool do_trans = false;
+	vector<string> parts;
+	if ( TiCC::split_at( line, parts, "#" ) != 2 ){
+	  cerr << progname << ": ERROR in line " << line_nr
+	       << " of indexfile: unable to split in 2 parts at #"
+	       << endl << "line was" << endl << line << endl;
+	  ++err_cnt;
+	}
+	else {
+	  string key_s = parts[0];
+	  if ( ++count % 1000 == 0 ){
 #pragma omp critical (debugout)
 	    {
-	      set<bitType>::const_iterator it = handledTrans.find( key );
-	      if ( it == handledTrans.end() ){
-		handledTrans.insert( key );
-		do_trans = true;
+	      cout << ".";
+	      cout.flush();
+	      if ( count % 50000 == 0 ){
+		cout << endl << count << endl;;
 	      }
 	    }
-	    if ( do_trans ){
-	      handleTranspositions( sit1->second,
-				    freqMap, low_freqMap, alfabet,
-				    dis_map, dis_count, ngram_count,
-				    artifreq, low_limit, isKHC, noKHCld, isDIAC,
-				    record_store );
-	    }
 	  }
+	  string rest = parts[1];
 	  if ( verbose > 1 ){
 #pragma omp critical (debugout)
-	    cout << "bekijk key2 " << mainKey + key << endl;
+	    cerr << "extract parts from " << rest << endl;
 	  }
-	  map<bitType, set<string> >::const_iterator sit2 = hashMap.find(mainKey+key);
-	  if ( sit2 == hashMap.end() ){
-	    if ( verbose > 4 ){
-#pragma omp critical (debugout)
-	      cerr << progname << ": WARNING: found a key '" << key
-		   << "' in the input that, when added to '" << mainKey
-		   << "' isn't present in the hashes." << endl;
+	  if ( TiCC::split_at( rest, parts, "," ) < 1 ){
+	    cerr << progname << ": ERROR in line " << line_nr
+		 << " of indexfile: unable to split in parts separated by ','"
+		 << endl << "line was" << endl << line << endl;
+	    ++err_cnt;
+	  }
+	  else {
+	    work_item item;
+	    item.mainKey = TiCC::stringTo<bitType>(key_s);
+	    item.isKHC = ( histMap.find( item.mainKey ) != histMap.end() );
+	    item.isDIAC = ( diaMap.find( item.mainKey ) != diaMap.end() );
+	    for ( const auto& keyS : parts ){
+	      item.key = TiCC::stringTo<bitType>(keyS);
+	      // only the reader touches handledTrans, so no locking
+	      item.do_trans = handledTrans.insert( item.key ).second;
+	      while ( !queue.try_push( item ) ){
+		// the queue is full, so help the workers a bit.
+		// (when running on 1 thread, we are the only worker)
+		work_item todo;
+		if ( queue.pop( todo, false ) ){
+		  handle_item( todo, LDvalue, hashMap,
+			       low_freqMap, alfabet,
+			       artifreq, low_limit, noKHCld,
+			       results );
+		}
+	      }
 	    }
-	    continue;
 	  }
-	  compareSets( LDvalue, mainKey,
-		       sit1->second, sit2->second,
-		       freqMap, low_freqMap, alfabet,
-		       dis_map, dis_count, ngram_count,
-		       artifreq, low_limit, isKHC, noKHCld, isDIAC,
-		       record_store );
 	}
       }
+      queue.close();
+    }
+    work_item todo;
+    while ( queue.pop( todo, true ) ){
+      handle_item( todo, LDvalue, hashMap,
+		   low_freqMap, alfabet,
+		   artifreq, low_limit, noKHCld,
+		   results );
+    }
+  }
+  // merge the results of all threads. The order doesn't matter, as
+  // everything ends up in sorted maps
+  for ( auto& tr : thread_results ){
+    for ( const auto& it : tr.dis_map ){
+      dis_map[it.first].insert( it.second.begin(), it.second.end() );
+    }
+    for ( const auto& it : tr.dis_count ){
+      dis_count[it.first] += it.second;
     }
+    for ( const auto& it : tr.ngram_count ){
+      ngram_count[it.first] += it.second;
+    }
+    for ( const auto& it : tr.record_store ){
+      record_store.emplace( it.first, it.second );
+    }
+    tr = ld_results();
   }
   cout << endl << "creating .short file: " << shortFile << endl;
   ofstream shortf( shortFile );
-  add_short( shortf, dis_count, freqMap, low_freqMap, LDvalue, artifreq );
+  add_short( shortf, dis_count, low_freqMap, LDvalue, artifreq );
   cout << endl << "creating .ambi file: " << ambiFile << endl;
   ofstream amb( ambiFile );
   for ( const auto& ambi : dis_map ){
@@ -1266,11 +1528,20 @@ int main( int argc, char **argv ){
     low_ngramcount[lv] += ng.second;
   }
   for ( const auto& it : ngram_count ){
-    if ( record_store.find( it.first ) != record_store.end() ){
+    auto rec = record_store.end();
+    vector<UnicodeString> parts = TiCC::split_at( it.first, "~" );
+    if ( parts.size() == 2 ){
+      word_id w1 = lexicon.lookup( TiCC::UnicodeToUTF8( parts[0] ) );
+      word_id w2 = lexicon.lookup( TiCC::UnicodeToUTF8( parts[1] ) );
+      if ( w1 != NO_WORD && w2 != NO_WORD ){
+	rec = record_store.find( record_key( w1, w2 ) );
+      }
+    }
+    if ( rec != record_store.end() ){
       UnicodeString lv = it.first;
       lv.toLower();
       assert( low_ngramcount.find( lv ) != low_ngramcount.end() );
-      record_store.find(it.first)->second.ngram_point += low_ngramcount[lv];
+      rec->second.ngram_point += low_ngramcount[lv];
     }
     else {
       // Ok, our data seems to be incomplete
@@ -1280,9 +1551,16 @@ int main( int argc, char **argv ){
       }
     }
   }
-  ofstream os( outFile );
+  // output the records sorted on their 'word1~word2' key
+  vector<pair<UnicodeString,const ld_record*>> sorted_records;
+  sorted_records.reserve( record_store.size() );
   for ( const auto& r : record_store ){
-    os << r.second.toString() << endl;
+    sorted_records.push_back( make_pair( r.second.get_key(), &r.second ) );
+  }
+  sort( sorted_records.begin(), sorted_records.end() );
+  ofstream os( outFile );
+  for ( const auto& r : sorted_records ){
+    os << r.second->toString() << endl;
   }
   cout << progname << ": Done" << endl;
 }
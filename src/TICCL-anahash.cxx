@@ -29,6 +29,8 @@
 #include <string>
 #include <set>
 #include <map>
+#include <unordered_map>
+#include <vector>
 #include <iostream>
 #include <fstream>
 
@@ -37,8 +39,13 @@
 #include "ticcutils/CommandLine.h"
 #include "ticcutils/Unicode.h"
 #include "ticcl/unicode.h"
+#include "ticcl/anabin.h"
+#include "ticcl/charclass.h"
 
 #include "config.h"
+#ifdef HAVE_OPENMP
+#include "omp.h"
+#endif
 
 using namespace	std;
 using namespace icu;
@@ -47,17 +54,8 @@ const UnicodeString SEPARATOR = "_";
 
 typedef unsigned long int bitType;
 
-bitType high_five( int val ){
-  bitType result = val;
-  result *= val;
-  result *= val;
-  result *= val;
-  result *= val;
-  return result;
-}
-
 bool fillAlpha( istream& is,
-		map<UChar,bitType>& alphabet,
+		char_table& alphabet,
 		int clip ){
   cout << "start reading alphabet." << endl;
   string line;
@@ -76,61 +74,17 @@ bool fillAlpha( istream& is,
       // freq = 0 is special, for separator
       UnicodeString v0 = TiCC::UnicodeFromUTF8( v[0] );
       bitType hash = TiCC::stringTo<bitType>( v[2] );
-      alphabet[v0[0]] = hash;
+      alphabet.add( v0[0], hash );
     }
   }
-  cout << "finished reading alphabet. (" << alphabet.size() << " characters)"
-       << endl;
+  cout << "finished reading alphabet. (" << alphabet.alphabet_size()
+       << " characters)" << endl;
   return true;
 }
 
 bitType hash( const UnicodeString& s,
-	      map<UChar,bitType>& alphabet ){
-  static bitType HonderdEenHash = 0;
-  static bitType HonderdHash = 0;
-  if ( HonderdEenHash == 0 ){
-    HonderdHash = high_five( 100 );
-    HonderdEenHash = high_five( 101 );
-  }
-  UnicodeString us = s;
-  us.toLower();
-  bitType result = 0;
-  bool multPunct = false;
-  bool klets = false; // ( s == "Engeĳclíe" );
-  for( int i=0; i < us.length(); ++i ){
-    map<UChar,bitType>::const_iterator it = alphabet.find( us[i] );
-    if ( it != alphabet.end() ){
-      result += it->second;
-      if ( klets ){
-	cerr << "  CHAR, add " << UnicodeString( us[i] ) << " "
-	     << it->second << " ==> " << result << endl;
-      }
-    }
-    else {
-      int8_t charT = u_charType( us[i] );
-      if ( u_isspace( us[i] ) ){
-	continue;
-      }
-      else if ( ticc_ispunct( charT ) ){
-	if ( !multPunct ){
-	  result += HonderdHash;
-	  if ( klets ){
-	    cerr << "PUNCT, add " << UnicodeString( us[i] ) << " "
-		 << HonderdHash	 << " ==> " << result << endl;
-	  }
-	  multPunct = true;
-	}
-      }
-      else {
-	result += HonderdEenHash;
-	if ( klets ){
-	  cerr << "   UNK, add " << UnicodeString( us[i] ) << " "
-	       << HonderdHash << " ==> " << result << endl;
-	}
-      }
-    }
-  }
-  return result;
+	      const char_table& alphabet ){
+  return anagram_hash( s, alphabet );
 }
 
 void create_output( ostream& os,
@@ -162,6 +116,165 @@ UnicodeString filter_tilde_hashtag( const UnicodeString& w ){
   return result;
 }
 
+// the input is read in chunks of CHUNK_SIZE lines. The lines of a chunk are
+// parsed and hashed in parallel, and then stored in per thread shards.
+const size_t CHUNK_SIZE = 100000;
+
+struct us_hash {
+  size_t operator()( const UnicodeString& us ) const {
+    return us.hashCode();
+  }
+};
+
+struct hashed_line {
+  UnicodeString v0;
+  UnicodeString word;
+  bitType hash;
+  bitType freq;
+  size_t shard;
+  bool ok;
+};
+
+// every shard stores the words with the frequency and the anagram hash
+typedef unordered_map<UnicodeString,pair<bitType,bitType>,us_hash> freq_shard;
+typedef unordered_map<bitType,set<UnicodeString>> anagram_shard;
+
+bool read_chunk( istream& is, vector<string>& lines ){
+  lines.clear();
+  string line;
+  while ( lines.size() < CHUNK_SIZE && getline( is, line ) ){
+    lines.push_back( line );
+  }
+  return !lines.empty();
+}
+
+size_t hash_chunk( const vector<string>& lines,
+		   const char_table& alphabet,
+		   size_t shards,
+		   bool do_freq,
+		   vector<hashed_line>& result ){
+  // returns the index of the first line in the wrong format, or
+  // lines.size() when all is well
+  result.resize( lines.size() );
+#pragma omp parallel for schedule(static)
+  for ( size_t i=0; i < lines.size(); ++i ){
+    hashed_line& hl = result[i];
+    vector<string> v;
+    int n = TiCC::split_at( lines[i], v, "\t" );
+    hl.ok = ( n == 2 );
+    if ( hl.ok ){
+      hl.v0 = TiCC::UnicodeFromUTF8( v[0] );
+      hl.word = filter_tilde_hashtag( hl.v0 );
+      hl.hash = ::hash( hl.word, alphabet );
+      hl.shard = hl.word.hashCode() % shards;
+      if ( do_freq ){
+	hl.freq = TiCC::stringTo<bitType>( v[1] );
+      }
+    }
+  }
+  for ( size_t i=0; i < result.size(); ++i ){
+    if ( !result[i].ok ){
+      return i;
+    }
+  }
+  return result.size();
+}
+
+void store_chunk( const vector<hashed_line>& lines,
+		  vector<anagram_shard>& anagrams,
+		  vector<freq_shard>& freq_list,
+		  map<UnicodeString,bitType>& merged,
+		  bool background,
+		  bool do_merge ){
+  // every shard is only touched by one thread, and sees the lines in the
+  // input order. So the last frequency of a word wins, like before.
+  const size_t shards = anagrams.size();
+#pragma omp parallel for schedule(static,1)
+  for ( size_t s=0; s < shards; ++s ){
+    for ( const auto& hl : lines ){
+      if ( hl.hash % shards == s ){
+	anagrams[s][hl.hash].insert( hl.word );
+      }
+      if ( !background && hl.shard == s ){
+	freq_list[s][hl.word] = make_pair( hl.freq, hl.hash );
+      }
+    }
+    if ( s == 0 && do_merge ){
+      for ( const auto& hl : lines ){
+	if ( background ){
+	  merged[hl.v0] += hl.freq;
+	}
+	else {
+	  merged[hl.v0] = hl.freq;
+	}
+      }
+    }
+  }
+}
+
+const pair<bitType,bitType> *find_freq( const vector<freq_shard>& freq_list,
+					const UnicodeString& word ){
+  const freq_shard& shard = freq_list[word.hashCode() % freq_list.size()];
+  const auto it = shard.find( word );
+  if ( it == shard.end() ){
+    return 0;
+  }
+  return &it->second;
+}
+
+void add_foci( const freq_shard& shard,
+	       const vector<freq_shard>& freq_list,
+	       size_t artifreq,
+	       bool do_ngrams,
+	       const UnicodeString& separator,
+	       vector<pair<bitType,UnicodeString>>& foci ){
+  for ( const auto& it : shard ){
+    UnicodeString word = it.first;
+    bitType h = it.second.second; // the hash from the first pass
+    if ( do_ngrams ){
+      vector<UnicodeString> parts = TiCC::split_at( word, separator );
+      if ( parts.size() > 0 ){
+	// we have an -n-gram
+	bool accept = false;
+	// we split the ngram to see if it is worth adding it to
+	// the foci list.
+	//    - NOT if no part is in the input
+	//    - NOT if all parts are know words.
+	for ( auto const& part: parts ){
+	  const auto u_it = find_freq( freq_list, part );
+	  if ( u_it != 0
+	       && u_it->first < artifreq ){
+	    // so this part IS present in the input, but not in the background
+	    UnicodeString l_part = part;
+	    l_part.toLower();
+	    const auto l_it = find_freq( freq_list, l_part );
+	    if ( l_it == 0
+		 || l_it->first < artifreq ){
+	      // the lowercase part is NOT present OR NOT the background
+	      accept = true;
+	    }
+	  }
+	}
+	if ( accept ){
+	  word.toLower();
+	  foci.push_back( make_pair( h, word ) );
+	}
+      }
+    }
+    else {
+      bitType freq = it.second.first;
+      if ( freq < artifreq ){
+	word.toLower();
+	const auto l_it = find_freq( freq_list, word );
+	if ( l_it == 0
+	     || l_it->first < artifreq ){
+	  foci.push_back( make_pair( h, word ) );
+	}
+      }
+    }
+  }
+}
+
 void usage( const string& name ){
   cerr << "usage:" << name << " [options] <clean frequencyfile>" << endl;
   cerr << "\t" << name << " will read a wordfrequency list (in FoLiA-stats format) " << endl;
@@ -178,12 +291,17 @@ void usage( const string& name ){
   cerr << "\t--clip=<clip> : cut off frequency of the alphabet. (freq 0 is NEVER clipped)" << endl;
   cerr << "\t-h or --help\t this message " << endl;
   cerr << "\t-o 'output_name' write output to file 'output_name'" << endl;
+  cerr << "\t--binary also write the anagram hashes in a binary format, which" << endl;
+  cerr << "\t\t can be used by the other TICCL tools without parsing. (.anabin)" << endl;
   cerr << "\t--artifrq='value': if value > 0, create a separate list of anagram" << endl;
   cerr << "\t\t values that have a lexical frequency < 'artifrq' " << endl;
   cerr << "\t\t for n-grams, only those n-grams are written where at least one" << endl;
   cerr << "\t\t of the composing parts does not have the lexical frequency artifrq. " << endl;
   cerr << "\t--ngrams When the frequency file contains n-grams. (not necessary of equal arity)" << endl;
   cerr << "\t\t we split them into 1-grams and do a frequency lookup per part for the artifreq value." << endl;
+  cerr << "\t-t <threads>\n\t--threads <threads> Number of threads to run on." << endl;
+  cerr << "\t\t\t If 'threads' has the value \"max\", the number of threads is set to a" << endl;
+  cerr << "\t\t\t reasonable value. (OMP_NUM_TREADS - 2)" << endl;
   cerr << "\t-V or --version\t show version " << endl;
   cerr << "\t-v\t verbose (not used yet) " << endl;
 }
@@ -191,8 +309,8 @@ void usage( const string& name ){
 int main( int argc, char *argv[] ){
   TiCC::CL_Options opts;
   try {
-    opts.set_short_options( "vVho:" );
-    opts.set_long_options( "alph:,background:,artifrq:,clip:,help,version,ngrams,list,separator:" );
+    opts.set_short_options( "vVho:t:" );
+    opts.set_long_options( "alph:,background:,artifrq:,clip:,help,version,ngrams,list,separator:,binary,threads:" );
     opts.init( argc, argv );
   }
   catch( TiCC::OptionError& e ){
@@ -226,6 +344,7 @@ int main( int argc, char *argv[] ){
     separator = SEPARATOR;
   }
   bool list = opts.extract( "list" );
+  bool binary = opts.extract( "binary" );
   string value;
   if ( opts.extract( "clip", value ) ){
     if ( !TiCC::stringTo(value,clip) ) {
@@ -240,6 +359,31 @@ int main( int argc, char *argv[] ){
     }
   }
   bool do_ngrams = opts.extract( "ngrams" );
+  int numThreads=1;
+  value = "1";
+  if ( !opts.extract( 't', value ) ){
+    opts.extract( "threads", value );
+  }
+#ifdef HAVE_OPENMP
+  if ( TiCC::lowercase(value) == "max" ){
+    numThreads = omp_get_max_threads() - 2;
+  }
+  else {
+    if ( !TiCC::stringTo(value,numThreads) ) {
+      cerr << "illegal value for -t (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+  if ( numThreads < 1 ){
+    numThreads = 1;
+  }
+#else
+  if ( value != "1" ){
+    cerr << "unable to set number of threads!.\nNo OpenMP support available!"
+	 <<endl;
+    exit(EXIT_FAILURE);
+  }
+#endif
   string out_file_name;
   opts.extract( "o", out_file_name );
   if ( !opts.empty() ){
@@ -300,7 +444,7 @@ int main( int argc, char *argv[] ){
     }
   }
 
-  map<UChar,bitType> alphabet;
+  char_table alphabet;
   if ( !fillAlpha( as, alphabet, clip ) ){
     cerr << "serious problems reading alphabet file: " << alphafile << endl;
     exit(EXIT_FAILURE);
@@ -316,6 +460,10 @@ int main( int argc, char *argv[] ){
       cerr << "option --background not supported for --list" << endl;
       exit( EXIT_FAILURE);
     }
+    if ( binary ){
+      cerr << "option --binary not supported for --list" << endl;
+      exit( EXIT_FAILURE);
+    }
     if ( !TiCC::createPath( out_file_name ) ){
       cerr << "unable to open output file: " << out_file_name << endl;
       exit(EXIT_FAILURE);
@@ -342,33 +490,31 @@ int main( int argc, char *argv[] ){
     }
   }
   ofstream out_stream( out_file_name );
+#ifdef HAVE_OPENMP
+  omp_set_num_threads( numThreads );
+  cout << "running on " << numThreads << " threads." << endl;
+#endif
   map<UnicodeString,bitType> merged;
-  map<UnicodeString,bitType> freq_list;
-  map<bitType, set<UnicodeString> > anagrams;
+  vector<freq_shard> freq_list( numThreads );
+  vector<anagram_shard> ana_shards( numThreads );
   cout << "start hashing from the corpus frequency file." << endl;
-  string line;
-  while ( getline( is, line ) ){
-    // we build a frequency list
-    vector<string> v;
-    int n = TiCC::split_at( line, v, "\t" );
-    if ( n != 2 ){
+  vector<string> lines;
+  vector<hashed_line> hashed;
+  while ( read_chunk( is, lines ) ){
+    size_t bad = hash_chunk( lines, alphabet, numThreads, !list, hashed );
+    if ( list ){
+      for ( size_t i=0; i < bad; ++i ){
+	out_stream << hashed[i].v0 << "\t" << hashed[i].hash << endl;
+      }
+    }
+    if ( bad < lines.size() ){
       cerr << "frequency file in wrong format!" << endl;
-      cerr << "offending line: " << line << endl;
+      cerr << "offending line: " << lines[bad] << endl;
       exit(EXIT_FAILURE);
     }
-    UnicodeString v0 = TiCC::UnicodeFromUTF8( v[0] );
-    UnicodeString word = filter_tilde_hashtag( v0 );
-    bitType h = ::hash( word, alphabet );
-    if ( list ){
-      out_stream << v0 << "\t" << h << endl;
-    }
-    else {
-      anagrams[h].insert( word );
-      bitType freq = TiCC::stringTo<bitType>( v[1] );
-      freq_list[word] = freq;
-      if ( doMerge && artifreq > 0  ){
-	merged[v0] = freq;
-      }
+    if ( !list ){
+      store_chunk( hashed, ana_shards, freq_list, merged,
+		   false, doMerge && artifreq > 0 );
     }
   }
 
@@ -376,79 +522,34 @@ int main( int argc, char *argv[] ){
     cout << "created a list file: " << out_file_name << endl;
     exit( EXIT_SUCCESS );
   }
-  map<bitType, set<UnicodeString> > foci;
   if ( artifreq > 0 ){ // so NOT when creating a simple list!
-    for ( const auto& it : freq_list ){
-      UnicodeString word = it.first;
-      bitType h = ::hash( word, alphabet );
-      if ( do_ngrams ){
-	vector<UnicodeString> parts = TiCC::split_at( word, separator );
-	if ( parts.size() > 0 ){
-	  // we have an -n-gram
-	  bool accept = false;
-	  // we split the ngram to see if it is worth adding it to
-	  // the foci list.
-	  //    - NOT if no part is in the input
-	  //    - NOT if all parts are know words.
-	  for ( auto const& part: parts ){
-	    const auto u_it = freq_list.find( part );
-	    if ( u_it != freq_list.end()
-		 && u_it->second < artifreq ){
-	      // so this part IS present in the input, but not in the background
-	      UnicodeString l_part = part;
-	      l_part.toLower();
-	      const auto l_it = freq_list.find(l_part);
-	      if ( l_it == freq_list.end()
-		   || l_it->second < artifreq ){
-		// the lowercase part is NOT present OR NOT the background
-		accept = true;
-	      }
-	    }
-	  }
-	  if ( accept ){
-	    word.toLower();
-	    foci[h].insert( word );
-	  }
-	}
-      }
-      else {
-	bitType freq = it.second;
-	if ( freq < artifreq ){
-	  word.toLower();
-	  const auto l_it = freq_list.find(word);
-	  if ( l_it == freq_list.end()
-	       || l_it->second < artifreq ){
-	    foci[h].insert(word);
-	  }
-	}
+    vector<vector<pair<bitType,UnicodeString>>> shard_foci( numThreads );
+#pragma omp parallel for schedule(static,1)
+    for ( int s=0; s < numThreads; ++s ){
+      add_foci( freq_list[s], freq_list, artifreq, do_ngrams, separator,
+		shard_foci[s] );
+    }
+    map<bitType, set<UnicodeString> > foci;
+    for ( const auto& sf : shard_foci ){
+      for ( const auto& it : sf ){
+	foci[it.first].insert( it.second );
       }
     }
-  }
-  if ( artifreq > 0 ){
     cout << "generating foci file: " << foci_file_name << " with " << foci.size() << " entries" << endl;
     ofstream fos( foci_file_name );
     create_output( fos, foci );
-    // for ( const auto& f : foci ){
-    //   fos << f.first << endl;
-    // }
   }
   if ( doMerge ){
     cerr << "merge background corpus: " << backfile << endl;
     ifstream bs( backfile );
-    while ( getline( bs, line ) ){
-      vector<string> v;
-      int n = TiCC::split_at( line, v, "\t" );
-      if ( n != 2 ){
+    while ( read_chunk( bs, lines ) ){
+      size_t bad = hash_chunk( lines, alphabet, numThreads, true, hashed );
+      if ( bad < lines.size() ){
 	cerr << "background file in wrong format!" << endl;
-	cerr << "offending line: " << line << endl;
+	cerr << "offending line: " << lines[bad] << endl;
 	exit(EXIT_FAILURE);
       }
-      UnicodeString v0 = TiCC::UnicodeFromUTF8( v[0] );
-      UnicodeString word = filter_tilde_hashtag( v0 );
-      bitType h = ::hash( word, alphabet );
-      anagrams[h].insert( word );
-      bitType freq = TiCC::stringTo<bitType>( v[1] );
-      merged[v0] += freq;
+      store_chunk( hashed, ana_shards, freq_list, merged, true, true );
     }
     string merge_file_name = file_name + ".merged";
     ofstream ms( merge_file_name );
@@ -459,7 +560,24 @@ int main( int argc, char *argv[] ){
 
   }
 
+  // the shards have disjunct keys, so we just move them into one sorted map
+  map<bitType, set<UnicodeString> > anagrams;
+  for ( auto& shard : ana_shards ){
+    for ( auto& it : shard ){
+      anagrams[it.first].swap( it.second );
+    }
+    shard.clear();
+  }
   cout << "generating output file: " << out_file_name << endl;
   create_output( out_stream, anagrams );
+  if ( binary ){
+    string bin_file_name = out_file_name;
+    bin_file_name.replace( bin_file_name.length() - 8, 8, ANABIN_EXT );
+    cout << "generating binary output file: " << bin_file_name << endl;
+    if ( !write_anabin( bin_file_name, anagrams ) ){
+      cerr << "problem writing binary output file: " << bin_file_name << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
   cout << "done!" << endl;
 }
@@ -27,6 +27,8 @@
 #include <unistd.h>
 #include <set>
 #include <map>
+#include <unordered_map>
+#include <algorithm>
 #include <functional>
 #include <vector>
 #include <cstdlib>
@@ -46,6 +48,7 @@
 #include "ticcutils/PrettyPrint.h"
 #include "ticcutils/Unicode.h"
 #include "ticcl/unicode.h"
+#include "ticcl/levenshtein.h"
 #include "ticcl/word2vec.h"
 
 using namespace std;
@@ -54,23 +57,6 @@ using namespace icu;
 typedef signed long int bitType;
 using TiCC::operator<<;
 
-unsigned int ldCompare( const UnicodeString& s1, const UnicodeString& s2 ){
-  const size_t len1 = s1.length(), len2 = s2.length();
-  vector<unsigned int> col(len2+1), prevCol(len2+1);
-  for ( unsigned int i = 0; i < prevCol.size(); ++i ){
-    prevCol[i] = i;
-  }
-  for ( unsigned int i = 0; i < len1; ++i ) {
-    col[0] = i+1;
-    for ( unsigned int j = 0; j < len2; ++j )
-      col[j+1] = min( min( 1 + col[j], 1 + prevCol[1 + j]),
-		      prevCol[j] + (s1[i]==s2[j] ? 0 : 1) );
-    col.swap(prevCol);
-  }
-  unsigned int result = prevCol[len2];
-  return result;
-}
-
 unsigned int ld( const string& in1, const string& in2, bool caseless ){
   UnicodeString s1 = TiCC::UnicodeFromUTF8(in1);
   UnicodeString s2 = TiCC::UnicodeFromUTF8(in2);
@@ -81,7 +67,19 @@ unsigned int ld( const string& in1, const string& in2, bool caseless ){
   return ldCompare( s1, s2 );
 }
 
+const unsigned int no_head = static_cast<unsigned int>(-1);
+
 class chain_class {
+  // every word gets a number (an id). All the administration is done on
+  // those ids, in plain arrays. So every word is stored only once, and the
+  // ranked file is handled in one pass, using memory proportional to the
+  // number of different words.
+  //
+  // The chains form a forest: every word gets a head when it is seen for
+  // the first time as a variant. That head is the head of its correction
+  // candidate, or else the candidate itself. Heads are never moved
+  // afterwards, so when a head gets a head of its own later, the words
+  // already chained to it stay there.
 public:
   chain_class(): chain_class( 0,false ){};
   chain_class( int v, bool c ): verbosity(v), caseless(c){};
@@ -89,113 +87,142 @@ public:
   void debug_info( const string& );
   void output( const string& );
 private:
-  map<string,string> heads;
-  map<string, set<string>> table;
-  map< string, size_t > var_freq;
+  unsigned int intern( const string&, size_t );
+  vector<unsigned int> sorted_heads() const;
+  unordered_map<string,unsigned int> ids;
+  vector<string> words;
+  vector<size_t> var_freq;
+  vector<unsigned int> head;
   int verbosity;
   bool caseless;
-
 };
 
+unsigned int chain_class::intern( const string& word, size_t freq ){
+  // lookup or add 'word', and (re)set its frequency
+  auto it = ids.find( word );
+  if ( it != ids.end() ){
+    var_freq[it->second] = freq;
+    return it->second;
+  }
+  unsigned int id = words.size();
+  ids.insert( make_pair( word, id ) );
+  words.push_back( word );
+  var_freq.push_back( freq );
+  head.push_back( no_head );
+  return id;
+}
+
 bool chain_class::fill( const string& line ){
   vector<string> parts = TiCC::split_at( line, "#" );
   if ( parts.size() != 6 ){
     return false;
   }
   else {
-    string a_word = parts[0]; // a possibly correctable word
-    size_t freq1 = TiCC::stringTo<size_t>(parts[1]);
-    var_freq[a_word] = freq1;
-    string candidate = parts[2]; // a Correction Candidate
-    size_t freq2 = TiCC::stringTo<size_t>(parts[3]);
-    var_freq[candidate] = freq2;
+    // a possibly correctable word
+    unsigned int a_word = intern( parts[0],
+				  TiCC::stringTo<size_t>(parts[1]) );
+    // a Correction Candidate
+    unsigned int candidate = intern( parts[2],
+				     TiCC::stringTo<size_t>(parts[3]) );
     if ( verbosity > 3 ){
-      cerr << "word=" << a_word << " CC=" << candidate << endl;
+      cerr << "word=" << words[a_word] << " CC=" << words[candidate] << endl;
     }
-    string head = heads[a_word];
-    if ( head.empty() ){
-      // this word does not have a 'head' yet
+    if ( head[a_word] != no_head ){
+      // the word has a head already
       if ( verbosity > 3 ){
-	cerr << "word: " << a_word << " NOT in heads " << endl;
-      }
-      string head2 = heads[candidate];
-      if ( head2.empty() ){
-	// the correction candidate also has no head
-	// we add it as a new head for a_word, with a table
-	heads[a_word] = candidate;
-	table[candidate].insert( a_word );
-	if ( verbosity > 3 ){
-	  cerr << "candidate : " << candidate << " not in heads too." << endl;
-	  cerr << "add (" << a_word << "," << candidate << ") to heads " << endl;
-	  cerr << "add " << a_word << " to table of " << candidate
-	       << " ==> " << table[candidate] << endl;
-	}
-      }
-      else {
-	// the candidate knows its head already
-	// add the word to the table of that head, and also register
-	// the head as an (intermediate) head of a_word
-	if ( verbosity > 3 ){
-	  cerr << "BUT: Candidate " << candidate << " has head: "
-	       << head2 << endl;
-	  cerr << "add " << a_word << " to table[" << head2 << "]" << endl;
-	  cerr << "AND add " << head2 << " as a head of " << a_word << endl;
-	}
-	heads[a_word] = head2;
-	table[head2].insert( a_word );
+	cerr << "word: " << words[a_word] << " IN heads "
+	     << words[head[a_word]] << endl;
       }
+      return true;
     }
-    else {
-      // the word has a head
+    unsigned int new_head = head[candidate];
+    if ( new_head == no_head ){
+      // the correction candidate also has no head. it becomes the head
+      new_head = candidate;
       if ( verbosity > 3 ){
-	cerr << "word: " << a_word << " IN heads " << head << endl;
-      }
-      auto const tit = table.find( head );
-      if ( tit != table.end() ){
-	// there MUST be some candidates registered for the head
-	if ( verbosity > 3 ){
-	  cerr << "lookup " << a_word << " in " << tit->second << endl;
-	}
-	if ( tit->second.find( a_word ) == tit->second.end() ){
-	  string msg = "Error: " + a_word
-	    + " has a heads entry, but no table entry!";
-	  throw logic_error( msg );
-	}
-      }
-      else {
-	string msg = "Error: " + a_word
-	  + " has no head entry!";
-	throw logic_error( msg );
+	cerr << "candidate : " << words[candidate] << " not in heads." << endl;
       }
     }
+    else if ( verbosity > 3 ){
+      cerr << "BUT: Candidate " << words[candidate] << " has head: "
+	   << words[new_head] << endl;
+    }
+    if ( verbosity > 3 ){
+      cerr << "add " << words[a_word] << " to table of "
+	   << words[new_head] << endl;
+    }
+    head[a_word] = new_head;
     return true;
   }
 }
 
+vector<unsigned int> chain_class::sorted_heads() const {
+  // all heads that have words chained to them, sorted on their string
+  vector<bool> is_head( words.size(), false );
+  for ( const auto& h : head ){
+    if ( h != no_head ){
+      is_head[h] = true;
+    }
+  }
+  vector<unsigned int> result;
+  for ( unsigned int id=0; id < words.size(); ++id ){
+    if ( is_head[id] ){
+      result.push_back( id );
+    }
+  }
+  sort( result.begin(), result.end(),
+	[&]( unsigned int a, unsigned int b ){ return words[a] < words[b]; } );
+  return result;
+}
+
 void chain_class::debug_info( const string& name ){
   string out_file = name + ".debug";
   ofstream db( out_file );
-  for ( const auto& it : table ){
-    db << var_freq[it.first] << " " << it.first
-       << " " << it.second << endl;
+  map<unsigned int,set<string>> table;
+  for ( unsigned int id=0; id < words.size(); ++id ){
+    if ( head[id] != no_head ){
+      table[head[id]].insert( words[id] );
+    }
+  }
+  for ( const auto& h : sorted_heads() ){
+    db << var_freq[h] << " " << words[h]
+       << " " << table[h] << endl;
   }
   cout << "debug info stored in " << out_file << endl;
 }
 
 void chain_class::output( const string& out_file ){
   ofstream os( out_file );
-  multimap<size_t, string,std::greater<size_t>> out_map;
-  for ( const auto& t_it : table ){
-    for ( const auto& s : t_it.second ){
-      stringstream oss;
-      oss << s << "#" << var_freq[s] << "#" << t_it.first
-	  << "#" << var_freq[t_it.first]
-	  << "#" << ld( t_it.first, s, caseless ) << "#C";
-      out_map.insert( make_pair( var_freq[t_it.first], oss.str() ) );
+  // sorted on the frequency of the head (descending), then on the head,
+  // then on the word.
+  vector<unsigned int> rank( words.size(), 0 );
+  vector<unsigned int> heads = sorted_heads();
+  for ( unsigned int i=0; i < heads.size(); ++i ){
+    rank[heads[i]] = i;
+  }
+  vector<unsigned int> chained;
+  for ( unsigned int id=0; id < words.size(); ++id ){
+    if ( head[id] != no_head ){
+      chained.push_back( id );
     }
   }
-  for ( const auto& t_it : out_map ){
-    os << t_it.second << endl;
+  sort( chained.begin(), chained.end(),
+	[&]( unsigned int a, unsigned int b ){
+	  unsigned int ha = head[a];
+	  unsigned int hb = head[b];
+	  if ( ha != hb ){
+	    if ( var_freq[ha] != var_freq[hb] ){
+	      return var_freq[ha] > var_freq[hb];
+	    }
+	    return rank[ha] < rank[hb];
+	  }
+	  return words[a] < words[b];
+	} );
+  for ( const auto& id : chained ){
+    unsigned int h = head[id];
+    os << words[id] << "#" << var_freq[id] << "#" << words[h]
+       << "#" << var_freq[h]
+       << "#" << ld( words[h], words[id], caseless ) << "#C" << endl;
   }
 }
 
@@ -27,6 +27,8 @@
 #include <unistd.h>
 #include <set>
 #include <map>
+#include <unordered_map>
+#include <algorithm>
 #include <functional>
 #include <vector>
 #include <cstdlib>
@@ -63,6 +65,9 @@ void usage( const string& name ){
        << endl;
   cerr << "\t\t characters. (default = 5)" << endl;
   cerr << "\t-o <outputfile> name of the outputfile." << endl;
+  cerr << "\t-t <threads>\n\t--threads <threads> Number of threads to run on." << endl;
+  cerr << "\t\t\t If 'threads' has the value \"max\", the number of threads is set to a" << endl;
+  cerr << "\t\t\t reasonable value. (OMP_NUM_TREADS - 2)" << endl;
   cerr << "\t-h or --help this message." << endl;
   cerr << "\t-v be verbose, repeat to be more verbose. " << endl;
   cerr << "\t-V or --version show version. " << endl;
@@ -75,12 +80,16 @@ class record {
 public:
   record():deleted(false){};
   string variant;
+  string lc_variant;
   vector<string> v_parts;
-  vector<string> v_dh_parts;
+  vector<string> v_lc_parts;
+  vector<string> v_lc_dh_parts;
   string v_freq;
   string cc;
+  string lc_cc;
   vector<string> cc_parts;
-  vector<string> cc_dh_parts;
+  vector<string> cc_lc_parts;
+  vector<string> cc_lc_dh_parts;
   string cc_freq;
   string ld;
   bool deleted;
@@ -109,11 +118,102 @@ vector<string> sort( vector<string>& in, map<int,string>& cc_order){
   return uit;
 }
 
+string lower( const string& s, bool do_low ){
+  if ( do_low ){
+    return TiCC::utf8_lowercase( s );
+  }
+  else {
+    return s;
+  }
+}
+
+vector<string> lower( const vector<string>& v, bool do_low ){
+  vector<string> result;
+  result.reserve( v.size() );
+  for ( const auto& s : v ){
+    result.push_back( lower( s, do_low ) );
+  }
+  return result;
+}
+
+void add_to_index( unordered_map<string,vector<size_t>>& index,
+		   const string& key,
+		   size_t rec_nr ){
+  // the records are added in order, so every list is sorted, and holds
+  // every record only once
+  vector<size_t>& recs = index[key];
+  if ( recs.empty() || recs.back() != rec_nr ){
+    recs.push_back( rec_nr );
+  }
+}
+
+typedef map<int,vector<string>,std::greater<int>> cc_map;
+
+cc_map find_ccs( const string& unk_part,
+		 const vector<size_t>& hits,
+		 const vector<record>& records,
+		 bool show ){
+  // collect the (lowercased) parts of the CC's of all records in 'hits'.
+  // These are the records that have 'unk_part' in their variant.
+  // The result is sorted on frequency, highest first, and for equal
+  // frequencies in order of the first encounter.
+  map<string,int> cc_freqs;
+  map<int,string> cc_order;
+  int oc = 0;
+  for ( const auto& r : hits ){
+    const record& rec = records[r];
+    if ( show ){
+      cerr << "found: " << unk_part << " in: " << rec << endl;
+    }
+    for ( const auto& c_part : rec.cc_lc_dh_parts ){
+      if ( cc_freqs.find(c_part) == cc_freqs.end() ){
+	// first encounter
+	cc_order[oc++] = c_part;
+      }
+      ++cc_freqs[c_part];
+      if ( show ){
+	cerr << "for: " << unk_part << " increment " << c_part << endl;
+      }
+    }
+  }
+  multimap<int,string,std::greater<int>> desc_cc;
+  set<int> keys;
+  // sort on highest frequency first.
+  // DOES IT REALLY MATTER???
+  for ( const auto& cc : cc_freqs ){
+    keys.insert(cc.second);
+    desc_cc.insert( make_pair(cc.second,cc.first) );
+  }
+  if ( show ){
+    cerr << "found " << desc_cc.size() << " CC's for: " << unk_part << endl;
+    for ( const auto& it : desc_cc ){
+      cerr << it.first << "\t" << it.second << endl;
+    }
+  }
+  cc_map desc_cc_vec_map;
+  for ( const auto& key : keys ){
+    auto const& pr = desc_cc.equal_range( key );
+    vector<string> in;
+    for ( auto it = pr.first; it != pr.second; ++it ){
+      in.push_back( it->second );
+    }
+    vector<string> uit = sort(in,cc_order);
+    desc_cc_vec_map[key] = uit;
+  }
+  if ( show ){
+    cerr << "found " << cc_order.size() << " CC's for: " << unk_part << endl;
+    for ( const auto& it : desc_cc_vec_map ){
+      cerr << it.first << "\t" << it.second << endl;
+    }
+  }
+  return desc_cc_vec_map;
+}
+
 int main( int argc, char **argv ){
   TiCC::CL_Options opts;
   try {
-    opts.set_short_options( "vVho:" );
-    opts.set_long_options( "lexicon:,artifrq:,follow:,low:" );
+    opts.set_short_options( "vVho:t:" );
+    opts.set_long_options( "lexicon:,artifrq:,follow:,low:,threads:" );
     opts.init( argc, argv );
   }
   catch( TiCC::OptionError& e ){
@@ -153,6 +253,32 @@ int main( int argc, char **argv ){
       exit( EXIT_FAILURE );
     }
   }
+  int numThreads=1;
+  value = "1";
+  if ( !opts.extract( 't', value ) ){
+    opts.extract( "threads", value );
+  }
+#ifdef HAVE_OPENMP
+  if ( TiCC::lowercase(value) == "max" ){
+    numThreads = omp_get_max_threads() - 2;
+  }
+  else {
+    if ( !TiCC::stringTo(value,numThreads) ) {
+      cerr << "illegal value for -t (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+  if ( numThreads < 1 ){
+    numThreads = 1;
+  }
+  omp_set_num_threads( numThreads );
+#else
+  if ( value != "1" ){
+    cerr << "unable to set number of threads!.\nNo OpenMP support available!"
+	 <<endl;
+    exit(EXIT_FAILURE);
+  }
+#endif
   string lex_name;
   opts.extract( "lexicon", lex_name );
   if ( lex_name.empty() ){
@@ -229,7 +355,7 @@ int main( int argc, char **argv ){
   cout << "read " << valid_words.size() << " validated words from "
        << lex_name << endl;
   cout << "start reading chained results" << endl;
-  list<record> records;
+  vector<record> records;
   while ( getline( input, line ) ){
     vector<string> vec = TiCC::split_at( line, "#" );
     if ( vec.size() != 6 ){
@@ -246,23 +372,28 @@ int main( int argc, char **argv ){
     records.push_back( rec );
   }
   cout << "start processing " << records.size() << " chained results" << endl;
-  map<string,int> parts_freq;
-  for ( auto& rec : records ){
+  bool do_low2 = true;
+  // split and lowercase everything only once
+#pragma omp parallel for schedule(static)
+  for ( size_t r=0; r < records.size(); ++r ){
+    record& rec = records[r];
     rec.v_parts = TiCC::split_at( rec.variant, SEPARATOR );
-    rec.v_dh_parts = TiCC::split_at_first_of( rec.variant, SEPARATOR+"-" );
     rec.cc_parts = TiCC::split_at( rec.cc, SEPARATOR );
-    rec.cc_dh_parts = TiCC::split_at_first_of( rec.cc, SEPARATOR+"-" );
+    rec.lc_variant = lower( rec.variant, do_low2 );
+    rec.lc_cc = lower( rec.cc, do_low2 );
+    rec.v_lc_parts = lower( rec.v_parts, do_low1 );
+    rec.cc_lc_parts = lower( rec.cc_parts, do_low2 );
+    rec.v_lc_dh_parts
+      = lower( TiCC::split_at_first_of( rec.variant, SEPARATOR+"-" ), do_low1 );
+    rec.cc_lc_dh_parts
+      = lower( TiCC::split_at_first_of( rec.cc, SEPARATOR+"-" ), do_low2 );
+  }
+  map<string,int> parts_freq;
+  for ( const auto& rec : records ){
     if ( rec.v_parts.size() == 1 ){
       continue;
     }
-    for ( const auto& p : rec.v_parts ){
-      string key;
-      if ( do_low1 ){
-	key = TiCC::utf8_lowercase( p );
-      }
-      else {
-	key = p;
-      }
+    for ( const auto& key : rec.v_lc_parts ){
       if ( valid_words.find( key ) == valid_words.end() ){
 	++parts_freq[key];
       }
@@ -285,8 +416,27 @@ int main( int argc, char **argv ){
     }
   }
 
-  list<record*> copy_records;
-  for ( auto& rec : records ){
+  // two inverted indices, from a (lowercased) part to the records it
+  // occurs in:
+  // dh_index: the parts of the variants, split at SEPARATOR and '-'.
+  // part_index: the records that can be affected when resolving a part:
+  //   unigram records on their variant, and ngram records on their
+  //   parts, both as is and lowercased.
+  unordered_map<string,vector<size_t>> dh_index;
+  unordered_map<string,vector<size_t>> part_index;
+  for ( size_t r=0; r < records.size(); ++r ){
+    record& rec = records[r];
+    for ( const auto& p : rec.v_lc_dh_parts ){
+      add_to_index( dh_index, p, r );
+    }
+    if ( rec.v_parts.size() == 1 ){
+      add_to_index( part_index, rec.lc_variant, r );
+      continue;
+    }
+    for ( size_t i=0; i < rec.v_parts.size(); ++i ){
+      add_to_index( part_index, rec.v_parts[i], r );
+      add_to_index( part_index, rec.v_lc_parts[i], r );
+    }
     if ( rec.v_parts.size() > 1 ){
       string tmp;
       for ( const auto& p : rec.v_parts ){
@@ -296,140 +446,70 @@ int main( int argc, char **argv ){
 	rec.deleted = true;
       }
     }
-    copy_records.push_back( &rec );
   }
+  vector<string> unk_parts;
+  for ( const auto& part : desc_parts_freq ) {
+    unk_parts.push_back( lower( part.second, do_low2 ) );
+  }
+  // finding the CC's for every part is independent of the others, so that
+  // is done in parallel.
+  const vector<size_t> no_hits;
+  vector<cc_map> parts_ccs( unk_parts.size() );
+#pragma omp parallel for schedule(dynamic,16)
+  for ( size_t i=0; i < unk_parts.size(); ++i ){
+    auto const hit = dh_index.find( unk_parts[i] );
+    parts_ccs[i] = find_ccs( unk_parts[i],
+			     hit == dh_index.end() ? no_hits : hit->second,
+			     records,
+			     false );
+  }
+  // resolving them is not: it depends on the records that are done or
+  // deleted by the parts before.
   bool show = false;
-  bool do_low2 = true;
-  set<record*> done_records;
+  vector<bool> done_records( records.size(), false );
   map<string,string> done;
+  size_t part_nr = 0;
   for ( const auto& part : desc_parts_freq ) {
-    string unk_part;
-    if ( do_low2 ){
-      unk_part = TiCC::utf8_lowercase(part.second);
-    }
-    else {
-      unk_part = part.second;
-    }
+    const string& unk_part = unk_parts[part_nr];
+    const cc_map& desc_cc_vec_map = parts_ccs[part_nr];
+    ++part_nr;
     show = (verbosity>0 )
       || follow_words.find( unk_part ) != follow_words.end();
     if ( show ){
       cerr << "\n  Loop for part: " << part.second << "/" << unk_part << endl;
+      auto const hit = dh_index.find( unk_part );
+      find_ccs( unk_part,
+		hit == dh_index.end() ? no_hits : hit->second,
+		records,
+		true );
     }
-    map<string,int> cc_freqs;
-    map<int,string> cc_order;
-    int oc = 0;
-    for ( const auto& it : records ){
-      bool match = false;
-      for ( const auto& p : it.v_dh_parts ){
-	string v_part;
-	if ( do_low1 ){
-	  v_part = TiCC::utf8_lowercase(p);
-	}
-	else {
-	  v_part = p;
-	}
-	if ( verbosity>1 ){
-	  cerr << "ZOEK: " << v_part << endl;
-	}
-	if ( v_part == unk_part ){
-	  if ( show ){
-	    cerr << "found: " << unk_part << " in: " << it << endl;
-	  }
-	  match = true;
-	  break;
-	}
-      }
-      if ( match ){
-	for ( const auto& cp : it.cc_dh_parts ){
-	  string c_part;
-	  if ( do_low2 ){
-	    c_part = TiCC::utf8_lowercase(cp);
-	  }
-	  else {
-	    c_part = cp;
-	  }
-	  if ( cc_freqs.find(c_part) == cc_freqs.end() ){
-	    // first encounter
-	    cc_order[oc++] = c_part;
-	  }
-	  ++cc_freqs[c_part];
-	  if ( show ){
-	    cerr << "for: " << unk_part << " increment " << c_part << endl;
-	  }
-	}
-      }
-    }
-    multimap<int,string,std::greater<int>> desc_cc;
-    set<int> keys;
-    // sort on highest frequency first.
-    // DOES IT REALLY MATTER???
-    for ( const auto& cc : cc_freqs ){
-      keys.insert(cc.second);
-      desc_cc.insert( make_pair(cc.second,cc.first) );
-    }
-    if ( show ){
-      cerr << "found " << desc_cc.size() << " CC's for: " << unk_part << endl;
-      for ( const auto& it : desc_cc ){
-	cerr << it.first << "\t" << it.second << endl;
-      }
-    }
-    map<int,vector<string>,std::greater<int>> desc_cc_vec_map;
-    for ( const auto& key : keys ){
-      auto const& pr = desc_cc.equal_range( key );
-      vector<string> in;
-      for ( auto it = pr.first; it != pr.second; ++it ){
-	in.push_back( it->second );
-      }
-      vector<string> uit = sort(in,cc_order);
-      desc_cc_vec_map[key] = uit;
-    }
-    if ( show ){
-      cerr << "found " << cc_order.size() << " CC's for: " << unk_part << endl;
-      for ( const auto& it : desc_cc_vec_map ){
-	cerr << it.first << "\t" << it.second << endl;
-      }
-    }
+    auto const hit = part_index.find( unk_part );
+    const vector<size_t>& affected
+      = ( hit == part_index.end() ) ? no_hits : hit->second;
     for ( const auto& dvm_it : desc_cc_vec_map ){
       if ( show ){
 	cerr << "With frequency = " << dvm_it.first << endl;
       }
       for ( const auto& dcc : dvm_it.second ){
-	string cand_cor;
-	if ( do_low2 ){
-	  cand_cor = TiCC::utf8_lowercase( dcc );
-	}
-	else {
-	  cand_cor = dcc;
-	}
+	string cand_cor = lower( dcc, do_low2 );
 	if ( show ){
 	  cerr << "BEKIJK: " << cand_cor << "[" << dvm_it.first << "]" << endl;
 	}
 	map<string,int> uniq;
-	auto it = copy_records.begin();
-	while ( it != copy_records.end() ){
-	  record* rec = *it;
+	for ( const auto& r : affected ){
+	  record* rec = &records[r];
 	  if ( rec->deleted ){
-	    ++it;
 	    continue;
 	  }
-	  if ( done_records.find( rec ) != done_records.end() ){
+	  if ( done_records[r] ){
 	    if ( show && rec->variant.find( unk_part) != string::npos ) {
 	      cerr << "skip already done " << rec << endl;
 	    }
-	    ++it;
 	    continue;
 	  }
 	  if ( rec->v_parts.size() == 1 ){
-	    string vari;
-	    string corr;
-	    if ( do_low2 ){
-	      vari = TiCC::utf8_lowercase( rec->variant );
-	      corr = TiCC::utf8_lowercase( rec->cc );
-	    }
-	    else {
-	      vari = rec->variant;
-	      corr = rec->cc;
-	    }
+	    const string& vari = rec->lc_variant;
+	    const string& corr = rec->lc_cc;
 	    if ( vari == unk_part
 		 && corr.find(cand_cor) != string::npos ){
 	      // this is (might be) THE desired CC
@@ -439,7 +519,7 @@ int main( int argc, char **argv ){
 		cerr << "KEEP: " << rec << endl;
 	      }
 	      done[corr] = vari;
-	      done_records.insert(rec);
+	      done_records[r] = true;
 	      if ( rec->cc_parts.size() == 1 ){
 		// so this is a unigram CC
 		++uniq[vari];
@@ -466,28 +546,13 @@ int main( int argc, char **argv ){
 	      if ( local_show ){
 		cerr << "REMOVE uni: " << rec << endl;
 	      }
-	      ++it;
 	      continue;
 	    }
 	    bool match = false;
-	    for( const auto& cp : rec->cc_parts ){
-	      string cor_part;
-	      if ( do_low2 ){
-		cor_part = TiCC::utf8_lowercase( cp );
-	      }
-	      else {
-		cor_part = cp;
-	      }
+	    for( const auto& cor_part : rec->cc_lc_parts ){
 	      if ( cand_cor == cor_part ){
 		// CC match
-		for ( const auto& p : rec->v_parts ){
-		  string p_part;
-		  if ( do_low2 ){
-		    p_part = TiCC::utf8_lowercase( p );
-		  }
-		  else {
-		    p_part = p;
-		  }
+		for ( const auto& p_part : rec->v_lc_parts ){
 		  if ( p_part == unk_part ){
 		    // variant match too
 		    match = true;
@@ -499,33 +564,27 @@ int main( int argc, char **argv ){
 		    cerr << "both " << cor_part << " and " << unk_part
 			 << " matched in: " << rec << endl;
 		  }
-		  string lvar;
-		  if ( do_low2 ){
-		    lvar = TiCC::utf8_lowercase(rec->variant);
-		  }
-		  else {
-		    lvar = rec->variant;
-		  }
+		  const string& lvar = rec->lc_variant;
 		  if ( done.find( cor_part ) != done.end() ){
 		    string v = done[cor_part];
 		    if ( uniq.find( unk_part ) != uniq.end() ){
 		      if ( local_show ){
 			cerr << "REMOVE uni: " << rec << endl;
 		      }
-		      (*it)->deleted = true;
+		      rec->deleted = true;
 		    }
 		    else if ( lvar.find( v ) != string::npos ){
 		      if ( local_show ){
 			cerr << "REMOVE match: " << rec << endl;
 		      }
-		      (*it)->deleted = true;
+		      rec->deleted = true;
 		    }
 		    else {
 		      if ( local_show ){
 			cerr << "KEEP 1: " << rec << endl;
 		      }
 		      done[cor_part] = lvar;
-		      done_records.insert(rec);
+		      done_records[r] = true;
 		    }
 		  }
 		  else {
@@ -533,37 +592,32 @@ int main( int argc, char **argv ){
 		      cerr << "KEEP 2: " << rec << endl;
 		    }
 		    done[cor_part] = lvar;
-		    done_records.insert(rec);
+		    done_records[r] = true;
 		  }
 		  break;
 		}
 	      }
 	    }
 	  }
-	  ++it;
 	}
       }
     }
   }
   ofstream os( out_name );
   int count = 0;
-  for ( const auto it : copy_records ){
-    if ( it != 0 ){
-      if ( !it->deleted ){
-	++count;
-	os << it << endl;
-      }
+  for ( const auto& rec : records ){
+    if ( !rec.deleted ){
+      ++count;
+      os << rec << endl;
     }
   }
   cerr << "wrote " << count << " records to " << out_name << endl;
   ofstream osd( out_name + ".deleted" );
   count = 0;
-  for ( const auto it : copy_records ){
-    if ( it != 0 ){
-      if ( it->deleted ){
-	++count;
-	osd << it << endl;
-      }
+  for ( const auto& rec : records ){
+    if ( rec.deleted ){
+      ++count;
+      osd << rec << endl;
     }
   }
   cerr << "wrote " << count << " DELETED records to " << out_name
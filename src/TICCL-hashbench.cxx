@@ -0,0 +1,239 @@
+/*
+  Copyright (c) 2006 - 2018
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of ticcltools
+
+  ticcltools is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  ticcltools is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcltools/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+// micro benchmark: compare the anagram hashing of TICCL-anahash using the
+// character table from charclass.cxx with the std::map based version that
+// was used before.
+// Not installed, build with 'make TICCL-hashbench'
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include "ticcutils/CommandLine.h"
+#include "ticcutils/StringOps.h"
+#include "ticcutils/Unicode.h"
+#include "ticcl/unicode.h"
+#include "ticcl/charclass.h"
+
+using namespace std;
+using namespace icu;
+using namespace TiCC;
+
+typedef unsigned long int bitType;
+
+void usage( const string& name ){
+  cerr << "usage: " << name << " [options] --alph=<alphabet> lexiconfile"
+       << endl;
+  cerr << "\t--alph=<file>\t an alphabet file, as created by TICCL-lexstat"
+       << endl;
+  cerr << "\t--clip=<n>\t cut off frequency of the alphabet. (default 0)"
+       << endl;
+  cerr << "\t--repeat=<n>\t hash the lexicon 'n' times. (default 10)" << endl;
+  cerr << "\t-h or --help\t this message " << endl;
+}
+
+bitType high_five( int val ){
+  bitType result = val;
+  result *= val;
+  result *= val;
+  result *= val;
+  result *= val;
+  return result;
+}
+
+bitType old_hash( const UnicodeString& s,
+		  const map<UChar,bitType>& alphabet ){
+  static bitType HonderdEenHash = high_five( 101 );
+  static bitType HonderdHash = high_five( 100 );
+  UnicodeString us = s;
+  us.toLower();
+  bitType result = 0;
+  bool multPunct = false;
+  for( int i=0; i < us.length(); ++i ){
+    map<UChar,bitType>::const_iterator it = alphabet.find( us[i] );
+    if ( it != alphabet.end() ){
+      result += it->second;
+    }
+    else {
+      int8_t charT = u_charType( us[i] );
+      if ( u_isspace( us[i] ) ){
+	continue;
+      }
+      else if ( ticc_ispunct( charT ) ){
+	if ( !multPunct ){
+	  result += HonderdHash;
+	  multPunct = true;
+	}
+      }
+      else {
+	result += HonderdEenHash;
+      }
+    }
+  }
+  return result;
+}
+
+typedef chrono::steady_clock bench_clock;
+
+double elapsed( const bench_clock::time_point& start ){
+  return chrono::duration<double>( bench_clock::now() - start ).count();
+}
+
+void report( const string& label, size_t words, double secs ){
+  cout << label << "\t" << secs << " s\t"
+       << ( secs > 0 ? words / secs / 1.0e6 : 0 ) << " Mwords/s" << endl;
+}
+
+int main( int argc, char **argv ){
+  CL_Options opts( "h", "help,alph:,clip:,repeat:" );
+  try {
+    opts.init(argc,argv);
+  }
+  catch( OptionError& e ){
+    cerr << e.what() << endl;
+    usage( opts.prog_name() );
+    exit( EXIT_FAILURE );
+  }
+  if ( opts.extract('h') || opts.extract("help") ){
+    usage( opts.prog_name() );
+    exit( EXIT_SUCCESS );
+  }
+  string alphafile;
+  if ( !opts.extract( "alph", alphafile ) ){
+    cerr << "missing --alph option" << endl;
+    usage( opts.prog_name() );
+    exit( EXIT_FAILURE );
+  }
+  string value;
+  int clip = 0;
+  if ( opts.extract( "clip", value ) ){
+    if ( !stringTo( value, clip ) ){
+      cerr << "illegal value for --clip (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+  size_t repeat = 10;
+  if ( opts.extract( "repeat", value ) ){
+    if ( !stringTo( value, repeat ) ){
+      cerr << "illegal value for --repeat (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+  vector<string> names = opts.getMassOpts();
+  if ( names.size() != 1 ){
+    cerr << "expected exactly one lexicon file" << endl;
+    usage( opts.prog_name() );
+    exit( EXIT_FAILURE );
+  }
+  if ( !opts.empty() ){
+    cerr << "unsupported options : " << opts.toString() << endl;
+    usage( opts.prog_name() );
+    exit( EXIT_FAILURE );
+  }
+  ifstream as( alphafile );
+  if ( !as ){
+    cerr << "problem opening alphabet file: " << alphafile << endl;
+    exit( EXIT_FAILURE );
+  }
+  auto start = bench_clock::now();
+  char_table table;
+  cout << "building the character table took " << elapsed( start )
+       << " s" << endl;
+  map<UChar,bitType> alphabet;
+  string line;
+  while ( getline( as, line ) ){
+    if ( line.size() == 0 || line[0] == '#' ){
+      continue;
+    }
+    vector<string> v = split_at( line, "\t" );
+    if ( v.size() != 3 ){
+      cerr << "unsupported format for alphabet file" << endl;
+      exit( EXIT_FAILURE );
+    }
+    int freq = stringTo<int>( v[1] );
+    if ( freq > clip || freq == 0 ){
+      UChar uc = UnicodeFromUTF8( v[0] )[0];
+      bitType hash = stringTo<bitType>( v[2] );
+      alphabet[uc] = hash;
+      table.add( uc, hash );
+    }
+  }
+  ifstream is( names[0] );
+  if ( !is ){
+    cerr << "problem opening lexicon file: " << names[0] << endl;
+    exit( EXIT_FAILURE );
+  }
+  vector<UnicodeString> words;
+  while ( getline( is, line ) ){
+    vector<string> parts = split_at( line, "\t" );
+    if ( parts.empty() ){
+      continue;
+    }
+    words.push_back( UnicodeFromUTF8( parts[0] ) );
+  }
+  cout << "read " << words.size() << " words, hashing them " << repeat
+       << " times" << endl;
+  size_t total = words.size() * repeat;
+
+  vector<bitType> old_res( words.size() );
+  start = bench_clock::now();
+  for ( size_t r=0; r < repeat; ++r ){
+    for ( size_t i=0; i < words.size(); ++i ){
+      old_res[i] = old_hash( words[i], alphabet );
+    }
+  }
+  report( "old map", total, elapsed( start ) );
+
+  vector<bitType> new_res( words.size() );
+  start = bench_clock::now();
+  for ( size_t r=0; r < repeat; ++r ){
+    for ( size_t i=0; i < words.size(); ++i ){
+      new_res[i] = anagram_hash( words[i], table );
+    }
+  }
+  report( "new table", total, elapsed( start ) );
+
+  size_t errors = 0;
+  for ( size_t i=0; i < words.size(); ++i ){
+    if ( new_res[i] != old_res[i] ){
+      if ( ++errors < 10 ){
+	cerr << "MISMATCH: " << words[i] << " old=" << old_res[i]
+	     << " new=" << new_res[i] << endl;
+      }
+    }
+  }
+  if ( errors > 0 ){
+    cerr << errors << " mismatches found" << endl;
+    exit( EXIT_FAILURE );
+  }
+  cout << "all results are equal" << endl;
+  exit( EXIT_SUCCESS );
+}
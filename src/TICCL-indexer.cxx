@@ -26,10 +26,11 @@
 */
 #include <unistd.h>
 #include <set>
-#include <map>
 #include <limits>
 #include <algorithm>
 #include <vector>
+#include <atomic>
+#include <chrono>
 #include <climits>
 #include <cstdlib>
 #include <string>
@@ -40,11 +41,16 @@
 #include "ticcutils/StringOps.h"
 #include "ticcutils/CommandLine.h"
 #include "ticcutils/Unicode.h"
+#include "ticcl/anabin.h"
+#include "ticcl/threadstats.h"
 
 #include "config.h"
 #ifdef HAVE_OPENMP
 #include "omp.h"
 #endif
+#if HAVE_ROARING
+#include "ticcl/hitmap.h"
+#endif
 
 using namespace std;
 using namespace icu;
@@ -55,6 +61,7 @@ void usage( const string& name ){
   cerr << name << endl;
   cerr << "options: " << endl;
   cerr << "\t--hash=<anahash>\tname of the anagram hashfile. (produced by TICCL-anahash)" << endl;
+  cerr << "\t\t\tthis may also be a binary .anabin file" << endl;
   cerr << "\t--charconf=<charconf>\tname of the character confusion file. (produced by TICCL-lexstat)" << endl;
   cerr << "\t-o <outputfile>\tname for the outputfile. " << endl;
   cerr << "\t--low=<low>\t skip entries from the anagram file shorter than "
@@ -65,6 +72,12 @@ void usage( const string& name ){
   cerr << "\t\t'high' characters. (default=35)" << endl;
   cerr << "\t--foci=<focifile>\tname of the file produced by the --artifrq parameter of TICCL-anahash." << endl;
   cerr << "\t\tThis file is used to limit the searchspace" << endl;
+#if HAVE_ROARING
+  cerr << "\t--roaring\t keep the results in compressed (roaring) bitmaps, and" << endl;
+  cerr << "\t\t write them in the binary format of TICCL-indexerNT-roaring," << endl;
+  cerr << "\t\t with extension .index.R" << endl;
+  cerr << "\t--text\t with --roaring: write the normal .index text output." << endl;
+#endif
   cerr << "\t-t <threads>\n\t--threads <threads> Number of threads to run on." << endl;
   cerr << "\t\t\t If 'threads' has the value \"max\", the number of threads is set to a" << endl;
   cerr << "\t\t\t reasonable value. (OMP_NUM_TREADS - 2)" << endl;
@@ -76,27 +89,19 @@ void usage( const string& name ){
 struct experiment {
   set<bitType>::const_iterator start;
   set<bitType>::const_iterator finish;
+  // every experiment handles its own confusions, so it can keep its
+  // own results, without locking. They are already sorted.
+  vector<pair<bitType,bitType>> result;
 };
 
-
-void handle_confs( const experiment& exp,
-		   size_t& count,
-		   const set<bitType>& anaSet, const set<bitType>& focSet,
-		   map<bitType,set<bitType>>& result ){
+void handle_confs( experiment& exp,
+		   atomic<size_t>& count,
+		   const set<bitType>& anaSet, const set<bitType>& focSet ){
   bitType vorige = 0;
   bitType totalShift = 0;
   auto sit = exp.start;
   while ( sit != exp.finish ){
-#pragma omp critical(count)
-    {
-      if ( ++count % 100 == 0 ){
-	cout << ".";
-	cout.flush();
-	if ( count % 5000 == 0 ){
-	  cout << endl << count << endl;
-	}
-      }
-    }
+    show_progress( count );
     bitType confusie = *sit;
     bitType diff = confusie - vorige;
     totalShift += diff;
@@ -116,10 +121,7 @@ void handle_confs( const experiment& exp,
 	  // both values out of focus
 	}
 	if ( foc ){
-#pragma omp critical(update)
-	  {
-	    result[confusie].insert(v1);
-	  }
+	  exp.result.push_back( make_pair( confusie, v1 ) );
 	}
 	++it1;
 	++it2;
@@ -136,11 +138,19 @@ void handle_confs( const experiment& exp,
   }
 }
 
+const size_t CHUNKS_PER_THREAD = 64;
+
 size_t init( vector<experiment>& exps,
 	     const set<bitType>& hashes,
-	     size_t threads ){
+	     size_t parts ){
+  // cut the range in a lot of small parts, which are handed out
+  // dynamically to the threads. This keeps all threads busy, even when
+  // some regions are much more expensive than others
   exps.clear();
-  size_t partsize = hashes.size() / threads;
+  if ( parts > hashes.size() ){
+    parts = hashes.size();
+  }
+  size_t partsize = ( parts > 0 ) ? hashes.size() / parts : 0;
   if ( partsize < 1 ){
     experiment e;
     e.start = hashes.begin();
@@ -149,7 +159,7 @@ size_t init( vector<experiment>& exps,
     return 1;
   }
   set<bitType>::const_iterator s = hashes.begin();
-  for ( size_t i=0; i < threads; ++i ){
+  for ( size_t i=0; i < parts; ++i ){
     experiment e;
     e.start = s;
     for ( size_t j=0; j < partsize && s != hashes.end(); ++j ){
@@ -161,14 +171,14 @@ size_t init( vector<experiment>& exps,
   if ( s != hashes.end() ){
     exps[exps.size()-1].finish = hashes.end();
   }
-  return threads;
+  return parts;
 }
 
 int main( int argc, char **argv ){
   TiCC::CL_Options opts;
   try {
     opts.set_short_options( "vVho:t:" );
-    opts.set_long_options( "charconf:,hash:,low:,high:,help,version,foci:,threads:" );
+    opts.set_long_options( "charconf:,hash:,low:,high:,help,version,foci:,threads:,roaring,text" );
     opts.init( argc, argv );
   }
   catch( TiCC::OptionError& e ){
@@ -200,6 +210,15 @@ int main( int argc, char **argv ){
   opts.extract( "charconf", confFile );
   opts.extract( "foci", fociFile );
   opts.extract( 'o', outFile );
+  bool roaring = opts.extract( "roaring" );
+  bool text_output = opts.extract( "text" );
+#if !HAVE_ROARING
+  if ( roaring ){
+    cerr << "unable to use roaring bitmaps!.\nNo CRoaring support available!"
+	 << endl;
+    exit(EXIT_FAILURE);
+  }
+#endif
   string value;
   if ( opts.extract("low", value ) ){
     if ( !TiCC::stringTo(value,lowValue) ) {
@@ -228,6 +247,9 @@ int main( int argc, char **argv ){
       exit( EXIT_FAILURE );
     }
   }
+  if ( numThreads < 1 ){
+    numThreads = 1;
+  }
 #else
   if ( value != "1" ){
     cerr << "unable to set number of threads!.\nNo OpenMP support available!"
@@ -267,16 +289,20 @@ int main( int argc, char **argv ){
     cout << "read " << focSet.size() << " foci values" << endl;
   }
 
+  string extension = ".index";
+  if ( roaring && !text_output ){
+    extension += ".R";
+  }
   if ( outFile.empty() ){
     outFile = anahashFile;
     string::size_type pos = outFile.rfind(".");
     if ( pos != string::npos ){
       outFile = outFile.substr(0,pos);
     }
-    outFile += ".index";
+    outFile += extension;
   }
-  else if ( !TiCC::match_back( outFile, ".index" ) ){
-    outFile += ".index";
+  else if ( !TiCC::match_back( outFile, extension ) ){
+    outFile += extension;
   }
 
   ofstream of( outFile );
@@ -288,22 +314,47 @@ int main( int argc, char **argv ){
   size_t skipped = 0;
   set<bitType> anaSet;
   string line;
-  while ( getline( ana, line ) ){
-    vector<string> parts;
-    if ( TiCC::split_at( line, parts, "~" ) > 1 ){
-      bitType bit = TiCC::stringTo<bitType>( parts[0] );
-      vector<string> parts2;
-      if ( TiCC::split_at( parts[1], parts2, "#" ) > 0 ){
-	UnicodeString firstItem = TiCC::UnicodeFromUTF8( parts2[0] );
-	if ( firstItem.length() >= lowValue &&
-	     firstItem.length() <= highValue ){
-	  anaSet.insert( bit );
+  if ( anabin_reader::is_anabin( anahashFile ) ){
+    anabin_reader store;
+    if ( !store.open( anahashFile ) ){
+      exit(1);
+    }
+    for ( size_t i=0; i < store.size(); ++i ){
+      if ( store.word_count( i ) == 0 ){
+	continue;
+      }
+      string first = store.word( i, 0 );
+      UnicodeString firstItem = TiCC::UnicodeFromUTF8( first );
+      if ( firstItem.length() >= lowValue &&
+	   firstItem.length() <= highValue ){
+	anaSet.insert( store.key( i ) );
+      }
+      else {
+	if ( verbose ){
+	  cerr << "skip " << first << endl;
 	}
-	else {
-	  if ( verbose ){
-	    cerr << "skip " << parts2[0] << endl;
+	++skipped;
+      }
+    }
+  }
+  else {
+    while ( getline( ana, line ) ){
+      vector<string> parts;
+      if ( TiCC::split_at( line, parts, "~" ) > 1 ){
+	bitType bit = TiCC::stringTo<bitType>( parts[0] );
+	vector<string> parts2;
+	if ( TiCC::split_at( parts[1], parts2, "#" ) > 0 ){
+	  UnicodeString firstItem = TiCC::UnicodeFromUTF8( parts2[0] );
+	  if ( firstItem.length() >= lowValue &&
+	       firstItem.length() <= highValue ){
+	    anaSet.insert( bit );
+	  }
+	  else {
+	    if ( verbose ){
+	      cerr << "skip " << parts2[0] << endl;
+	    }
+	    ++skipped;
 	  }
-	  ++skipped;
 	}
       }
     }
@@ -337,32 +388,64 @@ int main( int argc, char **argv ){
        << " character confusion anagram values" << endl;
 
   vector<experiment> experiments;
-  size_t expsize = init( experiments, confSet, numThreads );
+  size_t expsize = init( experiments, confSet,
+			 numThreads * CHUNKS_PER_THREAD );
+  cout << "created " << expsize << " separate experiments" << endl;
 #ifdef HAVE_OPENMP
-  omp_set_num_threads( expsize );
-  cout << "running on " << expsize << " threads." << endl;
+  omp_set_num_threads( numThreads );
+  cout << "running on " << numThreads << " threads." << endl;
 #endif
 
-
   cout << "processing all character confusion values" << endl;
-  map<bitType,set<bitType> > result;
-  count = 0;
-#pragma omp parallel for shared( experiments )
+  atomic<size_t> progress( 0 );
+  vector<double> busy( numThreads, 0.0 );
+#if HAVE_ROARING
+  hit_bitmaps bitmaps( roaring ? numThreads : 1 );
+#endif
+  auto wall_start = chrono::steady_clock::now();
+#pragma omp parallel for schedule(dynamic,1) shared( experiments, progress, busy )
   for ( size_t i=0; i < expsize; ++i ){
-    handle_confs( experiments[i], count, anaSet, focSet, result );
+    auto start = chrono::steady_clock::now();
+    handle_confs( experiments[i], progress, anaSet, focSet );
+#if HAVE_ROARING
+    if ( roaring ){
+      // move the results of this experiment into the bitmaps of the thread
+      bitmaps.add( thread_num(), experiments[i].result );
+    }
+#endif
+    busy[thread_num()] += seconds_since( start );
   }
+  show_thread_stats( busy, seconds_since( wall_start ) );
+
+#if HAVE_ROARING
+  if ( roaring ){
+    bitmaps.merge();
+    cout << "the result bitmaps take " << bitmaps.size_in_bytes()
+	 << " bytes" << endl;
+    if ( text_output ){
+      bitmaps.write_text( of );
+    }
+    else {
+      bitmaps.write_roaring( of );
+    }
+    return EXIT_SUCCESS;
+  }
+#endif
 
-  for ( auto const& rit : result ){
-    of << rit.first << "#";
-    set<bitType>::const_iterator it = rit.second.begin();
-    while ( it != rit.second.end() ){
-      of << *it;
+  // the experiments are consecutive ranges of confusions, so just
+  // concatenating their results keeps everything sorted
+  for ( auto const& exp : experiments ){
+    auto it = exp.result.begin();
+    while ( it != exp.result.end() ){
+      bitType key = it->first;
+      of << key << "#" << it->second;
       ++it;
-      if ( it != rit.second.end() ){
-	of << ",";
+      while ( it != exp.result.end() && it->first == key ){
+	of << "," << it->second;
+	++it;
       }
+      of << endl;
     }
-    of << endl;
   }
 
 }
@@ -30,6 +30,7 @@
 #include <algorithm>
 #include <vector>
 #include <map>
+#include <atomic>
 #include <climits>
 #include <cstdlib>
 #include <string>
@@ -45,7 +46,9 @@
 #include "ticcutils/StringOps.h"
 #include "ticcutils/CommandLine.h"
 #include "ticcutils/Unicode.h"
-#include "roaring/roaring64map.hh"
+#include "ticcl/anabin.h"
+#include "ticcl/threadstats.h"
+#include "ticcl/hitmap.h"
 #include "config.h"
 
 using namespace std;
@@ -59,6 +62,7 @@ void usage( const string& name ){
   cerr << name << endl;
   cerr << "options: " << endl;
   cerr << "\t--hash=<anahash>\tname of the anagram hashfile. (produced by TICCL-anahash)" << endl;
+  cerr << "\t\t\tthis may also be a binary .anabin file" << endl;
   cerr << "\t--charconf=<charconf>\tname of the character confusion file. (produced by TICCL-lexstat)" << endl;
   cerr << "\t--foci=<focifile>\tname of the file produced by the --artifrq parameter of TICCL-anahash" << endl;
   cerr << "\t-o <outputfile>\tname for the outputfile. " << endl;
@@ -108,23 +112,15 @@ size_t init( vector<experiment>& exps,
 }
 
 void handle_exp( const experiment& exp,
-		 size_t& count,
+		 atomic<size_t>& count,
 		 const set<bitType>& hashSet,
 		 const set<bitType>& confSet,
-		 map<bitType,Roaring64Map>& r_result ){
+		 hit_bitmaps& r_result ){
+  size_t thread = thread_num();
   bitType max = *confSet.rbegin();
   auto it1 = exp.start;
   while ( it1 != exp.finish ){
-#pragma omp critical
-    {
-      if ( ++count % 100 == 0 ){
-	cout << ".";
-	cout.flush();
-	if ( count % 5000 == 0 ){
-	  cout << endl << count << endl;;
-	}
-      }
-    }
+    show_progress( count );
     set<bitType>::const_iterator it3 = hashSet.find( *it1 );
     if ( it3 != hashSet.end() ){
       set<bitType>::const_reverse_iterator it2( it3 );
@@ -134,14 +130,11 @@ void handle_exp( const experiment& exp,
 	  break;
 	set<bitType>::const_iterator sit = confSet.find( diff );
 	if ( sit != confSet.end() ){
-#pragma omp critical
-	  {
 #ifdef TRANSPOSE_TEST
-	    r_result[*it2].add( diff );
+	  r_result.add( thread, *it2, diff );
 #else
-	    r_result[diff].add( *it2 );
+	  r_result.add( thread, diff, *it2 );
 #endif
-	  }
 	}
 	++it2;
       }
@@ -153,14 +146,11 @@ void handle_exp( const experiment& exp,
 	  break;
 	set<bitType>::const_iterator sit = confSet.find( diff );
 	if ( sit != confSet.end() ){
-#pragma omp critical
-	  {
 #ifdef TRANSPOSE_TEST
-	    r_result[*it1].add( diff );
+	  r_result.add( thread, *it1, diff );
 #else
-	    r_result[diff].add( *it1 );
+	  r_result.add( thread, diff, *it1 );
 #endif
-	  }
 	}
 	++it3;
       }
@@ -298,22 +288,47 @@ int main( int argc, char **argv ){
   size_t skipped = 0;
   set<bitType> hashSet;
   string line;
-  while ( getline( cwav, line ) ){
-    vector<string> parts;
-    if ( TiCC::split_at( line, parts, "~" ) > 1 ){
-      bitType bit = TiCC::stringTo<bitType>( parts[0] );
-      vector<string> parts2;
-      if ( TiCC::split_at( parts[1], parts2, "#" ) > 0 ){
-	UnicodeString firstItem = TiCC::UnicodeFromUTF8( parts2[0] );
-	if ( firstItem.length() >= lowValue &&
-	     firstItem.length() <= highValue ){
-	  hashSet.insert( bit );
+  if ( anabin_reader::is_anabin( anahashFile ) ){
+    anabin_reader store;
+    if ( !store.open( anahashFile ) ){
+      exit(1);
+    }
+    for ( size_t i=0; i < store.size(); ++i ){
+      if ( store.word_count( i ) == 0 ){
+	continue;
+      }
+      string first = store.word( i, 0 );
+      UnicodeString firstItem = TiCC::UnicodeFromUTF8( first );
+      if ( firstItem.length() >= lowValue &&
+	   firstItem.length() <= highValue ){
+	hashSet.insert( store.key( i ) );
+      }
+      else {
+	if ( verbose ){
+	  cerr << "skip " << first << endl;
 	}
-	else {
-	  if ( verbose ){
-	    cerr << "skip " << parts2[0] << endl;
+	++skipped;
+      }
+    }
+  }
+  else {
+    while ( getline( cwav, line ) ){
+      vector<string> parts;
+      if ( TiCC::split_at( line, parts, "~" ) > 1 ){
+	bitType bit = TiCC::stringTo<bitType>( parts[0] );
+	vector<string> parts2;
+	if ( TiCC::split_at( parts[1], parts2, "#" ) > 0 ){
+	  UnicodeString firstItem = TiCC::UnicodeFromUTF8( parts2[0] );
+	  if ( firstItem.length() >= lowValue &&
+	       firstItem.length() <= highValue ){
+	    hashSet.insert( bit );
+	  }
+	  else {
+	    if ( verbose ){
+	      cerr << "skip " << parts2[0] << endl;
+	    }
+	    ++skipped;
 	  }
-	  ++skipped;
 	}
       }
     }
@@ -355,20 +370,14 @@ int main( int argc, char **argv ){
   omp_set_num_threads( expsize );
 #endif
 
-  size_t count = 0;
-  map<bitType,Roaring64Map> r_result;
+  atomic<size_t> count( 0 );
+  // every thread fills its own bitmaps, these are OR-ed together afterwards
+  hit_bitmaps r_result( expsize );
 #pragma omp parallel for shared(experiments, count , r_result )
   for ( size_t i=0; i < expsize; ++i ){
     handle_exp( experiments[i], count, hashSet, confSet, r_result );
   }
 
-  for ( auto const& rit : r_result ){
-    of << rit.first;
-    of << "#";
-    uint64_t expectedsize = rit.second.getSizeInBytes();
-    char *serializedbytes = new char [expectedsize];
-    uint64_t uit = rit.second.write(serializedbytes);
-    of << uit << " " << string(serializedbytes,uit) << endl;
-    delete [] serializedbytes;
-  }
+  r_result.merge();
+  r_result.write_roaring( of );
 }
@@ -25,11 +25,11 @@
 
 */
 #include <unistd.h>
-#include <set>
 #include <limits>
 #include <algorithm>
 #include <vector>
-#include <map>
+#include <atomic>
+#include <chrono>
 #include <climits>
 #include <cstdlib>
 #include <string>
@@ -44,6 +44,11 @@
 #include "ticcutils/StringOps.h"
 #include "ticcutils/CommandLine.h"
 #include "ticcutils/Unicode.h"
+#include "ticcl/anabin.h"
+#include "ticcl/threadstats.h"
+#if HAVE_ROARING
+#include "ticcl/hitmap.h"
+#endif
 
 #include "config.h"
 
@@ -58,6 +63,7 @@ void usage( const string& name ){
   cerr << name << endl;
   cerr << "options: " << endl;
   cerr << "\t--hash=<anahash>\tname of the anagram hashfile. (produced by TICCL-anahash)" << endl;
+  cerr << "\t\t\tthis may also be a binary .anabin file" << endl;
   cerr << "\t--charconf=<charconf>\tname of the character confusion file. (produced by TICCL-lexstat)" << endl;
   cerr << "\t--foci=<focifile>\tname of the file produced by the --artifrq parameter of TICCL-anahash" << endl;
   cerr << "\t-o <outputfile>\tname for the outputfile. " << endl;
@@ -67,6 +73,12 @@ void usage( const string& name ){
   cerr << "\t--high=<high>\t skip entries from the anagram file longer than "
        << endl;
   cerr << "\t\t'high' characters. (default=35)" << endl;
+#if HAVE_ROARING
+  cerr << "\t--roaring\t keep the results in compressed (roaring) bitmaps, and" << endl;
+  cerr << "\t\t write them in the binary format of TICCL-indexerNT-roaring," << endl;
+  cerr << "\t\t with extension .indexNT.R" << endl;
+  cerr << "\t--text\t with --roaring: write the normal .indexNT text output." << endl;
+#endif
   cerr << "\t-t <threads>\n\t--threads <threads> Number of threads to run on." << endl;
   cerr << "\t\t\t If 'threads' has the value \"max\", the number of threads is set to a" << endl;
   cerr << "\t\t\t reasonable value. (OMP_NUM_TREADS - 2)" << endl;
@@ -74,97 +86,146 @@ void usage( const string& name ){
   cerr << "\t-h this message " << endl;
 }
 
+class conf_table {
+  // a flat open addressing hash set, holding the (positive) character
+  // confusion values. Much cheaper to query than a set<bitType>
+public:
+  explicit conf_table( const vector<bitType>& );
+  bool contains( bitType v ) const {
+    size_t pos = slot( v );
+    while ( table[pos] != 0 ){
+      if ( table[pos] == v ){
+	return true;
+      }
+      pos = (pos+1) & mask;
+    }
+    return false;
+  }
+private:
+  size_t slot( bitType v ) const {
+    unsigned long long h = (unsigned long long)v * 0x9E3779B97F4A7C15ULL;
+    return (h ^ (h >> 32)) & mask;
+  }
+  vector<bitType> table; // 0 marks an empty slot
+  size_t mask;
+};
+
+conf_table::conf_table( const vector<bitType>& values ){
+  size_t size = 16;
+  while ( size < 2*values.size() ){
+    size *= 2;
+  }
+  table.resize( size, 0 );
+  mask = size-1;
+  for ( const auto& v : values ){
+    if ( v <= 0 ){
+      // we only look for positive differences
+      continue;
+    }
+    size_t pos = slot( v );
+    while ( table[pos] != 0 && table[pos] != v ){
+      pos = (pos+1) & mask;
+    }
+    table[pos] = v;
+  }
+}
+
 struct experiment {
-  set<bitType>::const_iterator start;
-  set<bitType>::const_iterator finish;
+  size_t start;
+  size_t finish;
+  // every experiment keeps its own results, so no locking is needed.
+  // they are merged afterwards
+  vector<pair<bitType,bitType>> result;
 };
 
+const size_t CHUNKS_PER_THREAD = 64;
+
 size_t init( vector<experiment>& exps,
-	     const set<bitType>& hashes,
-	     size_t threads ){
+	     const vector<bitType>& hashes,
+	     size_t parts ){
+  // cut the range in a lot of small parts, which are handed out
+  // dynamically to the threads. This keeps all threads busy, even when
+  // some regions are much more expensive than others
   exps.clear();
-  size_t partsize = hashes.size() / threads;
+  if ( parts > hashes.size() ){
+    parts = hashes.size();
+  }
+  size_t partsize = ( parts > 0 ) ? hashes.size() / parts : 0;
   if ( partsize < 1 ){
     experiment e;
-    e.start = hashes.begin();
-    e.finish = hashes.end();
+    e.start = 0;
+    e.finish = hashes.size();
     exps.push_back( e );
     return 1;
   }
-  set<bitType>::const_iterator s = hashes.begin();
-  for ( size_t i=0; i < threads; ++i ){
+  size_t s = 0;
+  for ( size_t i=0; i < parts; ++i ){
     experiment e;
     e.start = s;
-    for ( size_t j=0; j < partsize; ++j )
-      ++s;
+    s += partsize;
     e.finish = s;
     exps.push_back( e );
   }
-  if ( s != hashes.end() ){
-    exps[exps.size()-1].finish = hashes.end();
-  }
-  return threads;
+  exps[exps.size()-1].finish = hashes.size();
+  return parts;
 }
 
-void handle_exp( const experiment& exp,
-		 size_t& count,
-		 const set<bitType>& hashSet,
-		 const set<bitType>& confSet,
-		 map<bitType,set<bitType>>& result ){
-  bitType max = *confSet.rbegin();
-  auto it1 = exp.start;
-  while ( it1 != exp.finish ){
-#pragma omp critical
-    {
-      if ( ++count % 100 == 0 ){
-	cout << ".";
-	cout.flush();
-	if ( count % 5000 == 0 ){
-	  cout << endl << count << endl;;
-	}
-      }
-    }
-    set<bitType>::const_iterator it3 = hashSet.find( *it1 );
-    if ( it3 != hashSet.end() ){
-      set<bitType>::const_reverse_iterator it2( it3 );
-      while ( it2 != hashSet.rend() ){
-	bitType diff = *it1 - *it2;
-	if ( diff > max )
-	  break;
-	set<bitType>::const_iterator sit = confSet.find( diff );
-	if ( sit != confSet.end() ){
-#pragma omp critical
-	  {
+inline void add_result( vector<pair<bitType,bitType>>& result,
+			bitType diff, bitType hash ){
 #ifdef TRANSPOSE_TEST
-	    result[*it2].insert(diff);
+  result.push_back( make_pair( hash, diff ) );
 #else
-	    result[diff].insert(*it2);
+  result.push_back( make_pair( diff, hash ) );
 #endif
-	  }
-	}
-	++it2;
+}
+
+void handle_exp( experiment& exp,
+		 atomic<size_t>& count,
+		 const vector<bitType>& foci,
+		 const vector<bitType>& hashes,
+		 const conf_table& confs,
+		 bitType max ){
+  if ( exp.start >= exp.finish ){
+    return;
+  }
+  // both foci and hashes are sorted, so we can slide a window
+  // [low,high) over the hashes, while walking the foci
+  size_t pos = lower_bound( hashes.begin(), hashes.end(),
+			    foci[exp.start] ) - hashes.begin();
+  // the window must start 'max' below the first focus, not at it
+  size_t low = lower_bound( hashes.begin(), hashes.begin() + pos,
+			    foci[exp.start] - max ) - hashes.begin();
+  size_t high = pos;
+  for ( size_t i = exp.start; i < exp.finish; ++i ){
+    show_progress( count );
+    const bitType focus = foci[i];
+    while ( pos < hashes.size() && hashes[pos] < focus ){
+      ++pos;
+    }
+    if ( pos == hashes.size() || hashes[pos] != focus ){
+      continue;
+    }
+    while ( low < pos && focus - hashes[low] > max ){
+      ++low;
+    }
+    if ( high <= pos ){
+      high = pos+1;
+    }
+    while ( high < hashes.size() && hashes[high] - focus <= max ){
+      ++high;
+    }
+    for ( size_t j = low; j < pos; ++j ){
+      bitType diff = focus - hashes[j];
+      if ( confs.contains( diff ) ){
+	add_result( exp.result, diff, hashes[j] );
       }
-      // it3 is already set at hashSet.find( *it1 );
-      ++it3;
-      while ( it3 != hashSet.end() ){
-	bitType diff = *it3 - *it1;
-	if ( diff > max )
-	  break;
-	set<bitType>::const_iterator sit = confSet.find( diff );
-	if ( sit != confSet.end() ){
-#pragma omp critical
-	  {
-#ifdef TRANSPOSE_TEST
-	    result[*it1].insert(diff);
-#else
-	    result[diff].insert(*it1);
-#endif
-	  }
-	}
-	++it3;
+    }
+    for ( size_t j = pos+1; j < high; ++j ){
+      bitType diff = hashes[j] - focus;
+      if ( confs.contains( diff ) ){
+	add_result( exp.result, diff, focus );
       }
     }
-    ++it1;
   }
 }
 
@@ -172,7 +233,7 @@ int main( int argc, char **argv ){
   TiCC::CL_Options opts;
   try {
     opts.set_short_options( "vVho:t:" );
-    opts.set_long_options( "charconf:,hash:,low:,high:,foci:,help,version,threads:" );
+    opts.set_long_options( "charconf:,hash:,low:,high:,foci:,help,version,threads:,roaring,text" );
     opts.init( argc, argv );
   }
   catch( TiCC::OptionError& e ){
@@ -213,6 +274,15 @@ int main( int argc, char **argv ){
     exit( EXIT_FAILURE );
   }
   opts.extract( 'o', outFile );
+  bool roaring = opts.extract( "roaring" );
+  bool text_output = opts.extract( "text" );
+#if !HAVE_ROARING
+  if ( roaring ){
+    cerr << "unable to use roaring bitmaps!.\nNo CRoaring support available!"
+	 << endl;
+    exit(EXIT_FAILURE);
+  }
+#endif
   int numThreads=1;
   string value = "1";
   if ( !opts.extract( 't', value ) ){
@@ -228,6 +298,9 @@ int main( int argc, char **argv ){
       exit( EXIT_FAILURE );
     }
   }
+  if ( numThreads < 1 ){
+    numThreads = 1;
+  }
 #else
   if ( value != "1" ){
     cerr << "unable to set number of threads!.\nNo OpenMP support available!"
@@ -259,16 +332,20 @@ int main( int argc, char **argv ){
 	 << anahashFile << endl;
     exit(1);
   }
+  string extension = ".indexNT";
+  if ( roaring && !text_output ){
+    extension += ".R";
+  }
   if ( outFile.empty() ){
     outFile = anahashFile;
     string::size_type pos = outFile.rfind(".");
     if ( pos != string::npos ){
       outFile = outFile.substr(0,pos);
     }
-    outFile += ".indexNT";
+    outFile += extension;
   }
-  else if ( !TiCC::match_back( outFile, ".indexNT" ) ){
-    outFile += ".indexNT";
+  else if ( !TiCC::match_back( outFile, extension ) ){
+    outFile += extension;
   }
 #ifdef TRANSPOSE_TEST
   outFile += ".T";
@@ -295,46 +372,75 @@ int main( int argc, char **argv ){
 
   cout << "reading corpus word anagram hash values" << endl;
   size_t skipped = 0;
-  set<bitType> hashSet;
+  vector<bitType> hashes;
   string line;
-  while ( getline( cwav, line ) ){
-    vector<string> parts;
-    if ( TiCC::split_at( line, parts, "~" ) > 1 ){
-      bitType bit = TiCC::stringTo<bitType>( parts[0] );
-      vector<string> parts2;
-      if ( TiCC::split_at( parts[1], parts2, "#" ) > 0 ){
-	UnicodeString firstItem = TiCC::UnicodeFromUTF8( parts2[0] );
-	if ( firstItem.length() >= lowValue &&
-	     firstItem.length() <= highValue ){
-	  hashSet.insert( bit );
+  if ( anabin_reader::is_anabin( anahashFile ) ){
+    anabin_reader store;
+    if ( !store.open( anahashFile ) ){
+      exit(1);
+    }
+    for ( size_t i=0; i < store.size(); ++i ){
+      if ( store.word_count( i ) == 0 ){
+	continue;
+      }
+      string first = store.word( i, 0 );
+      UnicodeString firstItem = TiCC::UnicodeFromUTF8( first );
+      if ( firstItem.length() >= lowValue &&
+	   firstItem.length() <= highValue ){
+	hashes.push_back( store.key( i ) );
+      }
+      else {
+	if ( verbose ){
+	  cerr << "skip " << first << endl;
 	}
-	else {
-	  if ( verbose ){
-	    cerr << "skip " << parts2[0] << endl;
+	++skipped;
+      }
+    }
+  }
+  else {
+    while ( getline( cwav, line ) ){
+      vector<string> parts;
+      if ( TiCC::split_at( line, parts, "~" ) > 1 ){
+	bitType bit = TiCC::stringTo<bitType>( parts[0] );
+	vector<string> parts2;
+	if ( TiCC::split_at( parts[1], parts2, "#" ) > 0 ){
+	  UnicodeString firstItem = TiCC::UnicodeFromUTF8( parts2[0] );
+	  if ( firstItem.length() >= lowValue &&
+	       firstItem.length() <= highValue ){
+	    hashes.push_back( bit );
+	  }
+	  else {
+	    if ( verbose ){
+	      cerr << "skip " << parts2[0] << endl;
+	    }
+	    ++skipped;
 	  }
-	  ++skipped;
 	}
       }
     }
   }
-  cout << "read " << hashSet.size() << " corpus word anagram values" << endl;
+  sort( hashes.begin(), hashes.end() );
+  hashes.erase( unique( hashes.begin(), hashes.end() ), hashes.end() );
+  cout << "read " << hashes.size() << " corpus word anagram values" << endl;
   cout << "skipped " << skipped << " out-of-band corpus word values" << endl;
 
-  set<bitType> focSet;
+  vector<bitType> foci;
   while ( foc ){
     bitType bit;
     foc >> bit;
     foc.ignore( INT_MAX, '\n' );
-    focSet.insert( bit );
+    foci.push_back( bit );
   }
-  cout << "read " << focSet.size() << " foci values" << endl;
+  sort( foci.begin(), foci.end() );
+  foci.erase( unique( foci.begin(), foci.end() ), foci.end() );
+  cout << "read " << foci.size() << " foci values" << endl;
 
-  set<bitType> confSet;
+  vector<bitType> confs;
   while ( getline( conf, line ) ){
     vector<string> parts;
     if ( TiCC::split_at( line, parts, "#" ) > 0 ){
       bitType bit = TiCC::stringTo<bitType>( parts[0] );
-      confSet.insert(bit);
+      confs.push_back(bit);
     }
     else {
       cerr << "problems with line " << line << endl;
@@ -342,35 +448,79 @@ int main( int argc, char **argv ){
       exit(1);
     }
   }
-  cout << "read " << confSet.size()
+  sort( confs.begin(), confs.end() );
+  confs.erase( unique( confs.begin(), confs.end() ), confs.end() );
+  cout << "read " << confs.size()
        << " character confusion anagram values" << endl;
+  if ( hashes.empty() || confs.empty() ){
+    exit( EXIT_SUCCESS );
+  }
+  const bitType max = confs.back();
+  const conf_table confTable( confs );
 
   vector<experiment> experiments;
-  size_t expsize = init( experiments, focSet, numThreads );
+  size_t expsize = init( experiments, foci, numThreads * CHUNKS_PER_THREAD );
 
   cout << "created " << expsize << " separate experiments" << endl;
 
 #ifdef HAVE_OPENMP
-  omp_set_num_threads( expsize );
-  cout << "running on " << expsize << " threads." << endl;
+  omp_set_num_threads( numThreads );
+  cout << "running on " << numThreads << " threads." << endl;
 #endif
 
-  size_t count = 0;
-  map<bitType,set<bitType> > result;
-#pragma omp parallel for shared( experiments, count, result )
+  atomic<size_t> progress( 0 );
+  vector<double> busy( numThreads, 0.0 );
+#if HAVE_ROARING
+  hit_bitmaps bitmaps( roaring ? numThreads : 1 );
+#endif
+  auto wall_start = chrono::steady_clock::now();
+#pragma omp parallel for schedule(dynamic,1) shared( experiments, progress, busy )
   for ( size_t i=0; i < expsize; ++i ){
-    handle_exp( experiments[i], count, hashSet, confSet, result );
+    auto start = chrono::steady_clock::now();
+    handle_exp( experiments[i], progress, foci, hashes, confTable, max );
+#if HAVE_ROARING
+    if ( roaring ){
+      // move the results of this experiment into the bitmaps of the thread
+      sort( experiments[i].result.begin(), experiments[i].result.end() );
+      bitmaps.add( thread_num(), experiments[i].result );
+    }
+#endif
+    busy[thread_num()] += seconds_since( start );
+  }
+  show_thread_stats( busy, seconds_since( wall_start ) );
+
+#if HAVE_ROARING
+  if ( roaring ){
+    bitmaps.merge();
+    cout << "the result bitmaps take " << bitmaps.size_in_bytes()
+	 << " bytes" << endl;
+    if ( text_output ){
+      bitmaps.write_text( of );
+    }
+    else {
+      bitmaps.write_roaring( of );
+    }
+    return EXIT_SUCCESS;
   }
+#endif
+
+  vector<pair<bitType,bitType>> result;
+  for ( auto& exp : experiments ){
+    result.insert( result.end(), exp.result.begin(), exp.result.end() );
+    exp.result.clear();
+    exp.result.shrink_to_fit();
+  }
+  sort( result.begin(), result.end() );
+  result.erase( unique( result.begin(), result.end() ), result.end() );
 
-  for ( auto const& rit : result ){
-    of << rit.first << "#";
-    set<bitType>::const_iterator it = rit.second.begin();
-    while ( it != rit.second.end() ){
-      of << *it;
+  auto it = result.begin();
+  while ( it != result.end() ){
+    bitType key = it->first;
+    of << key << "#" << it->second;
+    ++it;
+    while ( it != result.end() && it->first == key ){
+      of << "," << it->second;
       ++it;
-      if ( it != rit.second.end() ){
-	of << ",";
-      }
     }
     of << endl;
   }
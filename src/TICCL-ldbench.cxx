@@ -0,0 +1,205 @@
+/*
+  Copyright (c) 2006 - 2018
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of ticcltools
+
+  ticcltools is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  ticcltools is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcltools/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+// micro benchmark: compare the Levenshtein kernel from levenshtein.cxx
+// with the straightforward dynamic programming version that was used
+// before in TICCL-LDcalc and TICCL-chain.
+// Not installed, build with 'make TICCL-ldbench'
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include "ticcutils/CommandLine.h"
+#include "ticcutils/StringOps.h"
+#include "ticcutils/Unicode.h"
+#include "ticcl/levenshtein.h"
+
+using namespace std;
+using namespace icu;
+using namespace TiCC;
+
+void usage( const string& name ){
+  cerr << "usage: " << name << " [options] lexiconfile" << endl;
+  cerr << "\t--window=<n>\t compare every word with the next 'n' words"
+       << " in the lexicon. (default 20)" << endl;
+  cerr << "\t--LD=<n>\t the limit for the bounded comparisons. (default 2)"
+       << endl;
+  cerr << "\t--max=<n>\t only use the first 'n' words of the lexicon." << endl;
+  cerr << "\t-h or --help\t this message " << endl;
+}
+
+unsigned int old_ldCompare( const UnicodeString& s1, const UnicodeString& s2 ){
+  const size_t len1 = s1.length(), len2 = s2.length();
+  vector<unsigned int> col(len2+1), prevCol(len2+1);
+  for ( unsigned int i = 0; i < prevCol.size(); ++i ){
+    prevCol[i] = i;
+  }
+  for ( unsigned int i = 0; i < len1; ++i ) {
+    col[0] = i+1;
+    for ( unsigned int j = 0; j < len2; ++j )
+      col[j+1] = min( min( 1 + col[j], 1 + prevCol[1 + j]),
+		      prevCol[j] + (s1[i]==s2[j] ? 0 : 1) );
+    col.swap(prevCol);
+  }
+  unsigned int result = prevCol[len2];
+  return result;
+}
+
+typedef chrono::steady_clock bench_clock;
+
+double elapsed( const bench_clock::time_point& start ){
+  return chrono::duration<double>( bench_clock::now() - start ).count();
+}
+
+void report( const string& label, size_t pairs, double secs ){
+  cout << label << "\t" << secs << " s\t"
+       << ( secs > 0 ? pairs / secs / 1.0e6 : 0 ) << " Mpairs/s" << endl;
+}
+
+int main( int argc, char **argv ){
+  CL_Options opts( "h", "help,window:,LD:,max:" );
+  try {
+    opts.init(argc,argv);
+  }
+  catch( OptionError& e ){
+    cerr << e.what() << endl;
+    usage( opts.prog_name() );
+    exit( EXIT_FAILURE );
+  }
+  if ( opts.extract('h') || opts.extract("help") ){
+    usage( opts.prog_name() );
+    exit( EXIT_SUCCESS );
+  }
+  size_t window = 20;
+  string value;
+  if ( opts.extract( "window", value ) ){
+    if ( !stringTo( value, window ) ){
+      cerr << "illegal value for --window (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+  unsigned int limit = 2;
+  if ( opts.extract( "LD", value ) ){
+    if ( !stringTo( value, limit ) ){
+      cerr << "illegal value for --LD (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+  size_t max_words = 0;
+  if ( opts.extract( "max", value ) ){
+    if ( !stringTo( value, max_words ) ){
+      cerr << "illegal value for --max (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+  vector<string> names = opts.getMassOpts();
+  if ( names.size() != 1 ){
+    cerr << "expected exactly one lexicon file" << endl;
+    usage( opts.prog_name() );
+    exit( EXIT_FAILURE );
+  }
+  if ( !opts.empty() ){
+    cerr << "unsupported options : " << opts.toString() << endl;
+    usage( opts.prog_name() );
+    exit( EXIT_FAILURE );
+  }
+  ifstream is( names[0] );
+  if ( !is ){
+    cerr << "problem opening lexicon file: " << names[0] << endl;
+    exit( EXIT_FAILURE );
+  }
+  vector<UnicodeString> words;
+  string line;
+  while ( getline( is, line ) ){
+    vector<string> parts = split_at( line, "\t" );
+    if ( parts.empty() ){
+      continue;
+    }
+    words.push_back( UnicodeFromUTF8( parts[0] ) );
+    if ( max_words > 0 && words.size() == max_words ){
+      break;
+    }
+  }
+  // neighbouring words in a (sorted) lexicon are similar, like the pairs
+  // LDcalc typically sees. Also add some far apart pairs.
+  vector<pair<size_t,size_t>> pairs;
+  for ( size_t i=0; i < words.size(); ++i ){
+    for ( size_t j=i+1; j <= i+window && j < words.size(); ++j ){
+      pairs.push_back( make_pair( i, j ) );
+    }
+    pairs.push_back( make_pair( i, (i*7919) % words.size() ) );
+  }
+  cout << "read " << words.size() << " words, comparing "
+       << pairs.size() << " pairs" << endl;
+
+  vector<unsigned int> old_res( pairs.size() );
+  auto start = bench_clock::now();
+  for ( size_t i=0; i < pairs.size(); ++i ){
+    old_res[i] = old_ldCompare( words[pairs[i].first],
+				words[pairs[i].second] );
+  }
+  report( "old DP", pairs.size(), elapsed( start ) );
+
+  vector<unsigned int> new_res( pairs.size() );
+  start = bench_clock::now();
+  for ( size_t i=0; i < pairs.size(); ++i ){
+    new_res[i] = ldCompare( words[pairs[i].first],
+			    words[pairs[i].second] );
+  }
+  report( "new", pairs.size(), elapsed( start ) );
+
+  vector<unsigned int> bound_res( pairs.size() );
+  start = bench_clock::now();
+  for ( size_t i=0; i < pairs.size(); ++i ){
+    bound_res[i] = ldCompare( words[pairs[i].first],
+			      words[pairs[i].second],
+			      limit );
+  }
+  report( "new LD<=" + TiCC::toString(limit), pairs.size(), elapsed( start ) );
+
+  size_t errors = 0;
+  for ( size_t i=0; i < pairs.size(); ++i ){
+    unsigned int bound = old_res[i] > limit ? limit+1 : old_res[i];
+    if ( new_res[i] != old_res[i]
+	 || bound_res[i] != bound ){
+      if ( ++errors < 10 ){
+	cerr << "MISMATCH: " << words[pairs[i].first] << " "
+	     << words[pairs[i].second] << " old=" << old_res[i]
+	     << " new=" << new_res[i] << " bounded=" << bound_res[i] << endl;
+      }
+    }
+  }
+  if ( errors > 0 ){
+    cerr << errors << " mismatches found" << endl;
+    exit( EXIT_FAILURE );
+  }
+  cout << "all results are equal" << endl;
+  exit( EXIT_SUCCESS );
+}
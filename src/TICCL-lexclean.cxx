@@ -28,7 +28,9 @@
 #include <cstdlib>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <fstream>
@@ -37,13 +39,15 @@
 #include "ticcutils/StringOps.h"
 #include "ticcutils/FileUtils.h"
 #include "ticcutils/Unicode.h"
+#include "ticcl/charclass.h"
+#include "ticcl/wordfreq.h"
 
 #include "config.h"
 
 using namespace	std;
 using namespace	icu;
 
-void create_wf_list( const map<string, unsigned int>& wc,
+void create_wf_list( const unordered_map<string, unsigned int>& wc,
 		     const string& filename, unsigned int totalIn,
 		     bool doperc ){
   unsigned int total = totalIn;
@@ -52,46 +56,36 @@ void create_wf_list( const map<string, unsigned int>& wc,
     cerr << "failed to create outputfile '" << filename << "'" << endl;
     exit(EXIT_FAILURE);
   }
-  map<unsigned int, set<string> > wf;
-  for ( const auto& cit : wc ){
-    wf[cit.second].insert( cit.first );
-  }
   unsigned int sum=0;
-  map<unsigned int, set<string> >::const_reverse_iterator wit = wf.rbegin();
-  while ( wit != wf.rend() ){
-    if ( wit->first == 0 ){
-      for ( const auto& s : wit->second ){
-	os << s << endl;
-	++total;
-      }
+  for ( const auto& it : sorted_on_freq( wc ) ){
+    if ( it.second == 0 ){
+      os << *it.first << endl;
+      ++total;
     }
     else {
-      for ( const auto& s : wit->second ){
-	sum += wit->first;
-	os << s << "\t" << wit->first;
-	if ( doperc ){
-	  os << "\t" << sum << "\t" << std::setprecision(8) << 100 * double(sum)/total;
-	}
-	os << endl;
+      sum += it.second;
+      os << *it.first << "\t" << it.second;
+      if ( doperc ){
+	os << "\t" << sum << "\t" << std::setprecision(8) << 100 * double(sum)/total;
       }
+      os << endl;
     }
-    ++wit;
   }
   cout << "created cleaned list '" << filename << "'" << endl;
   cout << "with " << total << " words." << endl;
 }
 
 void dump_quarantine( const string& filename,
-		      const map<string, unsigned int>& qw ){
+		      const unordered_map<string, unsigned int>& qw ){
   ofstream os( filename );
   if ( !os ){
     cerr << "failed to create outputfile '" << filename << "'" << endl;
     exit(EXIT_FAILURE);
   }
-  for ( const auto& it : qw ){
-    os << it.first;
-    if ( it.second > 0 ){
-      os << "\t" << it.second;
+  for ( const auto& it : sorted_on_word( qw ) ){
+    os << it->first;
+    if ( it->second > 0 ){
+      os << "\t" << it->second;
     }
     os << endl;
   }
@@ -99,12 +93,12 @@ void dump_quarantine( const string& filename,
   cout << "with " << qw.size() << " items. " << endl;
 }
 
-bool isClean( const string& s, const set<UChar>& alp, bool reverse ){
+bool isClean( const string& s, const char_table& alp, bool reverse ){
   UnicodeString us = TiCC::UnicodeFromUTF8( s );
   //  cerr << "check " << us << endl;
   for ( int i=0; i < us.length(); ++i ){
     //    cerr << "check " << us[i] << endl;
-    if ( alp.find( us[i] ) == alp.end() ){
+    if ( !alp.in_alphabet( us[i] ) ){
       if ( reverse ){
 	continue;
       }
@@ -120,7 +114,7 @@ bool isClean( const string& s, const set<UChar>& alp, bool reverse ){
   return true;
 }
 
-bool fillAlpha( const string& file, set<UChar>& alphabet ){
+bool fillAlpha( const string& file, char_table& alphabet ){
   string line;
   ifstream is( file );
   while ( getline( is, line ) ){
@@ -130,9 +124,9 @@ bool fillAlpha( const string& file, set<UChar>& alphabet ){
     vector<string> v = TiCC::split( line );
     UnicodeString us = TiCC::UnicodeFromUTF8( v[0] );
     us.toLower();
-    alphabet.insert( us[0] );
+    alphabet.add( us[0] );
     us.toUpper();
-    alphabet.insert( us[0] );
+    alphabet.add( us[0] );
     // for now, we don't use the other fields
   }
   return true;
@@ -201,15 +195,15 @@ int main( int argc, char *argv[] ){
     exit(EXIT_FAILURE);
   }
 
-  set<UChar> alphabet;
+  char_table alphabet;
   if ( !alpha.empty() ){
     fillAlpha( alpha, alphabet );
-    cerr << "read alphabet file with " << alphabet.size()
+    cerr << "read alphabet file with " << alphabet.alphabet_size()
 	 << " characters" << endl;
   }
   if ( !no_alpha.empty() ){
     fillAlpha( no_alpha, alphabet );
-    cerr << "read EXCLUDE alphabet file with " << alphabet.size()
+    cerr << "read EXCLUDE alphabet file with " << alphabet.alphabet_size()
 	 << " characters" << endl;
   }
 
@@ -223,8 +217,8 @@ int main( int argc, char *argv[] ){
   //  isClean( "aap", alphabet, reverse );
   //  isClean( "nuttig", alphabet, reverse );
   //  return 1;
-  map<string,unsigned int> wc;
-  map<string,unsigned int> qw;
+  unordered_map<string,unsigned int> wc;
+  unordered_map<string,unsigned int> qw;
   for ( const auto& docName : fileNames ){
     ifstream is( docName );
     string line;
@@ -29,6 +29,7 @@
 #include <string>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <iostream>
 #include <fstream>
 
@@ -38,6 +39,9 @@
 #include "ticcutils/Unicode.h"
 
 #include "config.h"
+#ifdef HAVE_OPENMP
+#include "omp.h"
+#endif
 
 typedef signed long int bitType;
 
@@ -156,12 +160,10 @@ void create_dia_file( const string& filename,
   cerr << "created a diacritic confusion file: " << filename << endl;
 }
 
-void meld_botsing( const multimap<bitType,UnicodeString>& mm, bitType h ){
-  multimap<bitType,UnicodeString>::const_iterator it;
+void meld_botsing( const set<UnicodeString>& strings, bitType h ){
   map<set<UChar>,UnicodeString > ref;
-  for ( it = mm.lower_bound(h); it != mm.upper_bound(h); ++it ){
+  for ( const auto& s : strings ){
     set<UChar> st;
-    UnicodeString s = it->second;
     for( int i=0; i < s.length(); ++i ){
       st.insert( s[i] );
     }
@@ -176,16 +178,187 @@ void meld_botsing( const multimap<bitType,UnicodeString>& mm, bitType h ){
   cerr << endl;
 }
 
-void conditionally_insert( multimap<bitType,UnicodeString>& confusions,
-			   bitType key,
-			   const UnicodeString& value,
-			   bool full ){
-  if ( full ){
-    confusions.insert( make_pair( key, value ) );
+// A confusion replaces the characters of 'left' by those of 'right'. Its
+// value is the absolute difference of the sums of their anagram values.
+// These are the types of confusions, in the order in which the original
+// nested loops generated them. (they are still numbered and ordered that
+// way, so the output is the same)
+struct confusion_type {
+  size_t left;
+  size_t right;
+  // the position of the type in the nested loops
+  int phase;
+  int s_j;
+  int s_k;
+  int s_l;
+  int s_m;
+};
+
+const confusion_type conf_types[] = {
+  { 1, 0, 0, 0, 0, 0, 0 },
+  { 1, 1, 1, 0, 0, 0, 0 },
+  { 2, 0, 2, 0, 0, 0, 0 },
+  { 2, 1, 2, 1, 0, 0, 0 },
+  { 1, 2, 2, 1, 1, 0, 0 },
+  { 2, 2, 2, 1, 2, 0, 0 },
+  { 3, 0, 2, 1, 2, 1, 0 },
+  { 3, 1, 2, 1, 2, 2, 0 },
+  { 1, 3, 2, 1, 2, 3, 0 },
+  { 3, 2, 2, 1, 2, 4, 0 },
+  { 2, 3, 2, 1, 2, 4, 1 },
+  { 3, 3, 2, 1, 2, 4, 2 }
+};
+const size_t NUM_CONF_TYPES = sizeof(conf_types) / sizeof(confusion_type);
+
+class confusion_coder {
+  // packs a confusion (its type, and the indices of the characters of
+  // 'left' and 'right' in the alphabet) in one number, such that the
+  // numbers sort like the positions at which the original nested loops
+  // generated them. So for every value, the smallest number is the
+  // confusion that was inserted first.
+  // layout, from high to low bits: i, phase, j, s_j, k, s_k, l, s_l,
+  // m, s_m, o. Where i..o are the indices.
+ public:
+  explicit confusion_coder( size_t alphabet_size ): bits(1) {
+    while ( ( size_t(1) << bits ) < alphabet_size ){
+      ++bits;
+    }
+  };
+  bool fits() const { return 6 * bits + 10 <= 64; };
+  uint64_t encode( size_t type, const size_t *indices ) const {
+    const confusion_type& ct = conf_types[type];
+    const size_t num = ct.left + ct.right;
+    size_t idx[6] = { 0, 0, 0, 0, 0, 0 };
+    for ( size_t i=0; i < num; ++i ){
+      idx[i] = indices[i];
+    }
+    uint64_t result = idx[0];
+    result = ( result << 2 ) | ct.phase;
+    result = ( result << bits ) | idx[1];
+    result = ( result << 1 ) | ct.s_j;
+    result = ( result << bits ) | idx[2];
+    result = ( result << 2 ) | ct.s_k;
+    result = ( result << bits ) | idx[3];
+    result = ( result << 3 ) | ct.s_l;
+    result = ( result << bits ) | idx[4];
+    result = ( result << 2 ) | ct.s_m;
+    result = ( result << bits ) | idx[5];
+    return result;
+  }
+  UnicodeString decode( uint64_t code,
+			const vector<UnicodeString>& alphabet ) const {
+    const uint64_t mask = ( uint64_t(1) << bits ) - 1;
+    size_t idx[6];
+    int slot[5];
+    idx[5] = code & mask; code >>= bits;
+    slot[4] = code & 3; code >>= 2;
+    idx[4] = code & mask; code >>= bits;
+    slot[3] = code & 7; code >>= 3;
+    idx[3] = code & mask; code >>= bits;
+    slot[2] = code & 3; code >>= 2;
+    idx[2] = code & mask; code >>= bits;
+    slot[1] = code & 1; code >>= 1;
+    idx[1] = code & mask; code >>= bits;
+    slot[0] = code & 3; code >>= 2;
+    idx[0] = code;
+    UnicodeString result;
+    for ( const auto& ct : conf_types ){
+      if ( ct.phase == slot[0] && ct.s_j == slot[1] && ct.s_k == slot[2]
+	   && ct.s_l == slot[3] && ct.s_m == slot[4] ){
+	for ( size_t i=0; i < ct.left; ++i ){
+	  result += alphabet[idx[i]];
+	}
+	result += "~";
+	for ( size_t i=0; i < ct.right; ++i ){
+	  result += alphabet[idx[ct.left+i]];
+	}
+	break;
+      }
+    }
+    return result;
   }
-  else if ( confusions.find( key ) == confusions.end() ){
-    confusions.insert( make_pair( key, value ) );
+ private:
+  size_t bits;
+};
+
+bool next_tuple( size_t *tuple, size_t from, size_t size,
+		 size_t limit, bool sorted ){
+  // step to the next tuple of 'size' indices < 'limit', keeping the first
+  // 'from' fixed. When 'sorted', only non decreasing tuples are generated.
+  // returns false when there are no more.
+  for ( size_t p = size; p-- > from; ){
+    if ( ++tuple[p] < limit ){
+      for ( size_t q = p+1; q < size; ++q ){
+	tuple[q] = sorted ? tuple[p] : 0;
+      }
+      return true;
+    }
   }
+  return false;
+}
+
+template <typename F>
+void enumerate_confusions( size_t type,
+			   size_t first,
+			   const vector<bitType>& values,
+			   bool all_orders,
+			   F emit ){
+  // generate all confusions of type 'type' that start with the character
+  // with index 'first', and call emit( value, indices ) for each of them.
+  // The characters of 'right' must differ from those in 'left'.
+  // Unless 'all_orders' is set, the characters of 'left' and 'right' are
+  // only generated in ascending order. The other orders give the same
+  // values, and always come later in the original loops.
+  const confusion_type& ct = conf_types[type];
+  const size_t n = values.size();
+  const bool sorted = !all_orders;
+  size_t indices[6];
+  size_t left[3];
+  size_t right[3];
+  left[0] = first;
+  for ( size_t i=1; i < ct.left; ++i ){
+    left[i] = sorted ? first : 0;
+  }
+  vector<size_t> allowed;
+  allowed.reserve( n );
+  do {
+    bitType left_sum = 0;
+    for ( size_t i=0; i < ct.left; ++i ){
+      left_sum += values[left[i]];
+      indices[i] = left[i];
+    }
+    allowed.clear();
+    for ( size_t c=0; c < n; ++c ){
+      bool used = false;
+      for ( size_t i=0; i < ct.left; ++i ){
+	if ( left[i] == c ){
+	  used = true;
+	}
+      }
+      if ( !used ){
+	allowed.push_back( c );
+      }
+    }
+    if ( ct.right == 0 ){
+      emit( left_sum < 0 ? -left_sum : left_sum, indices );
+      continue;
+    }
+    if ( allowed.empty() ){
+      continue;
+    }
+    for ( size_t i=0; i < ct.right; ++i ){
+      right[i] = 0;
+    }
+    do {
+      bitType value = left_sum;
+      for ( size_t i=0; i < ct.right; ++i ){
+	const size_t c = allowed[right[i]];
+	value -= values[c];
+	indices[ct.left+i] = c;
+      }
+      emit( value < 0 ? -value : value, indices );
+    } while ( next_tuple( right, 0, ct.right, allowed.size(), sorted ) );
+  } while ( next_tuple( left, 1, ct.left, n, sorted ) );
 }
 
 void generate_confusion( const string& name,
@@ -197,172 +370,99 @@ void generate_confusion( const string& name,
     cerr << "unable to open output file: " << name << endl;
     exit(EXIT_FAILURE);
   }
-  multimap<bitType,UnicodeString> confusions;
+  vector<UnicodeString> alphabet;
+  vector<bitType> values;
+  for ( const auto& it : hashes ){
+    alphabet.push_back( it.first );
+    values.push_back( it.second );
+  }
+  const confusion_coder coder( alphabet.size() );
+  if ( !coder.fits() ){
+    cerr << "the alphabet is too large (" << alphabet.size()
+	 << ") to generate confusions. Use a larger --clip value" << endl;
+    exit(EXIT_FAILURE);
+  }
+  size_t num_types = 0;
+  while ( num_types < NUM_CONF_TYPES
+	  && conf_types[num_types].left <= (size_t)depth
+	  && conf_types[num_types].right <= (size_t)depth ){
+    ++num_types;
+  }
   cerr << "start : " << hashes.size() << " iterations " << endl;
-  map<UnicodeString,bitType>::const_iterator it1 = hashes.begin();
-  while ( it1 != hashes.end() ){
-    cerr << "iteration " << it1->first << endl;
-    // deletions/inserts of 1
-    UnicodeString s1 = it1->first + "~";
-    conditionally_insert( confusions, it1->second, s1, full );
-    map<UnicodeString,bitType>::const_iterator it2 = hashes.begin();
-    while ( it2 != hashes.end() ){
-      if ( it2 != it1 ){
-	// 1-1 substitutions
-	bitType div = it2->second - it1->second;
-	if ( div < 0 )
-	  div = -div;
-	UnicodeString s2 = it1->first + "~" + it2->first;
-	conditionally_insert( confusions, div, s2, full );
+  // every thread keeps the confusions it found per value. Normally only
+  // the first one (the smallest code) is needed, with --all every one.
+  size_t num_threads = 1;
+#ifdef HAVE_OPENMP
+  num_threads = omp_get_max_threads();
+#endif
+  vector<unordered_map<bitType,uint64_t>> firsts( num_threads );
+  vector<unordered_map<bitType,vector<uint64_t>>> alls( num_threads );
+#pragma omp parallel for schedule(dynamic,1)
+  for ( size_t first=0; first < alphabet.size(); ++first ){
+    size_t thread = 0;
+#ifdef HAVE_OPENMP
+    thread = omp_get_thread_num();
+#endif
+    unordered_map<bitType,uint64_t>& my_firsts = firsts[thread];
+    unordered_map<bitType,vector<uint64_t>>& my_alls = alls[thread];
+    for ( size_t type=0; type < num_types; ++type ){
+      if ( full ){
+	enumerate_confusions( type, first, values, true,
+			      [&]( bitType value, const size_t *indices ){
+				my_alls[value].push_back( coder.encode( type, indices ) );
+			      } );
       }
-      ++it2;
-    }
-    if ( depth > 1 ){
-      it2 = hashes.begin();
-      while ( it2 != hashes.end() ){
-	// 2-0 substitutions
-	UnicodeString s20 = it1->first + it2->first + "~";
-	bitType div = it2->second + it1->second;
-	if ( div < 0 )
-	  div = -div;
-	conditionally_insert( confusions, div, s20, full );
-	map<UnicodeString,bitType>::const_iterator it3 = hashes.begin();
-	while ( it3 != hashes.end() ){
-	  if ( it3 != it2 && it3 != it1 ){
-	    // 2-1 substitutions
-	    UnicodeString s = it1->first + it2->first + "~" + it3->first;
-	    bitType div =  it1->second + it2->second - it3->second;
-	    if ( div < 0 )
-	      div = -div;
-	    conditionally_insert( confusions, div, s, full );
-	  }
-	  if ( it2 != it1 && it3 != it1 ){
-	    // 1-2 substitutions
-	    UnicodeString s = it1->first + "~" + it2->first + it3->first;
-	    bitType div =  it1->second - it2->second - it3->second;
-	    if ( div < 0 )
-	      div = -div;
-	    conditionally_insert( confusions, div, s, full );
-	  }
-	  map<UnicodeString,bitType>::const_iterator it4 = hashes.begin();
-	  while ( it4 != hashes.end() ){
-	    if ( it3 != it1 && it3 != it2 && it4 != it1 && it4 != it2 ){
-	      // 2-2 substitutions
-	      UnicodeString s = it1->first + it2->first + "~"
-		+ it3->first + it4->first;
-	      bitType div = it1->second + it2->second
-		- it3->second - it4->second;
-	      if ( div < 0 )
-		div = -div;
-	      conditionally_insert( confusions, div, s, full );
-	    }
-	    if ( depth > 2 ){
-	      // 3-0 substitutions
-	      UnicodeString s30 = it1->first + it2->first + it3->first + "~";
-	      bitType div = it1->second + it2->second + it3->second;
-	      if ( div < 0 )
-		div = -div;
-	      conditionally_insert( confusions, div, s30, full );
-	      if ( it4 != it1 && it4 != it2 && it4 != it3 ){
-		// 3-1 substitutions
-		UnicodeString s = it1->first + it2->first + it3->first + "~"
-		  + it4->first;
-		bitType div = it4->second - it3->second
-		  - it2->second - it1->second;
-		if ( div < 0 )
-		  div = -div;
-		conditionally_insert( confusions, div, s, full );
-	      }
-	      if ( it2 != it1 && it3 != it1 && it4 != it1 ){
-		// 1-3 substitutions
-		UnicodeString s = it1->first + "~"
-		  + it2->first + it3->first + it4->first;
-		bitType div = it1->second - it2->second - it3->second - it4->second;
-		if ( div < 0 )
-		  div = -div;
-		conditionally_insert( confusions, div, s, full );
-	      }
-	      map<UnicodeString,bitType>::const_iterator it5 = hashes.begin();
-	      while ( it5 != hashes.end() ){
-		if ( it4 != it1 && it4 != it2 && it4 != it3 &&
-		     it5 != it1 && it5 != it2 && it5 != it3 ){
-		  // 3-2 substitutions
-		  UnicodeString s = it1->first + it2->first + it3->first + "~"
-		    + it4->first + it5->first;
-		  bitType div = it5->second + it4->second - it3->second
-		    - it2->second - it1->second;
-		  if ( div < 0 )
-		    div = -div;
-		  conditionally_insert( confusions, div, s, full );
-		}
-		if ( it3 != it1 && it3 != it2 &&
-		     it4 != it1 && it4 != it2 &&
-		     it5 != it1 && it5 != it2 ){
-		  // 2-3 substitutions
-		  UnicodeString s = it1->first + it2->first + "~" + it3->first
-		    +it4->first + it5->first;
-		  bitType div = it5->second + it4->second + it3->second
-		    - it2->second - it1->second;
-		  if ( div < 0 )
-		    div = -div;
-		  conditionally_insert( confusions, div, s, full );
-		}
-		map<UnicodeString,bitType>::const_iterator it6 = hashes.begin();
-		while ( it6 != hashes.end() ){
-		  if ( it6 != it1 && it6 != it2 && it6 != it3 &&
-		       it5 != it1 && it5 != it2 && it5 != it3 &&
-		       it4 != it1 && it4 != it2 && it4 != it3 ){
-		    // 3-3 substitutions
-		    UnicodeString s = it1->first + it2->first + it3->first + "~"
-		      +it4->first + it5->first + it6->first;
-		    bitType div = it6->second + it5->second + it4->second
-		      - it3->second - it2->second - it1->second;
-		    if ( div < 0 )
-		      div = -div;
-		    conditionally_insert( confusions, div, s, full );
-		  }
-		  ++it6;
-		}
-		++it5;
-	      }
-	    }
-	    ++it4;
-	  }
-	  ++it3;
-	}
-	++it2;
+      else {
+	enumerate_confusions( type, first, values, false,
+			      [&]( bitType value, const size_t *indices ){
+				uint64_t code = coder.encode( type, indices );
+				auto ins = my_firsts.insert( make_pair( value, code ) );
+				if ( !ins.second && code < ins.first->second ){
+				  ins.first->second = code;
+				}
+			      } );
       }
     }
-    ++it1;
   }
-  multimap<bitType,UnicodeString>::const_iterator cit = confusions.begin();
   if ( full ){
-    bitType start=0;
-    set<UnicodeString> unique;
-    while ( cit != confusions.end() ){
-      if ( cit->first != start ){
-	// a new KWC starts
-	if ( !unique.empty() ){
-	  if ( unique.size() > 8 ){
-	    meld_botsing( confusions, start );
-	  }
-	  os << start;
-	  for ( const auto& un : unique ){
-	    os << "#" << un;
-	  }
-	  os << endl;
-	  unique.clear();
+    map<bitType,set<UnicodeString>> confusions;
+    for ( auto& my_alls : alls ){
+      for ( const auto& it : my_alls ){
+	set<UnicodeString>& unique = confusions[it.first];
+	for ( const auto& code : it.second ){
+	  unique.insert( coder.decode( code, alphabet ) );
 	}
-	start = cit->first;
       }
-      unique.insert( cit->second );
-      ++cit;
+      my_alls.clear();
+    }
+    // every value, except the last one. (as it always did)
+    auto last = confusions.end();
+    if ( last != confusions.begin() ){
+      --last;
+    }
+    for ( auto it = confusions.begin(); it != last; ++it ){
+      if ( it->second.size() > 8 ){
+	meld_botsing( it->second, it->first );
+      }
+      os << it->first;
+      for ( const auto& un : it->second ){
+	os << "#" << un;
+      }
+      os << endl;
     }
   }
   else {
-    while ( cit != confusions.end() ){
-      os << cit->first << "#" << cit->second << endl;
-      ++cit;
+    map<bitType,uint64_t> confusions;
+    for ( const auto& my_firsts : firsts ){
+      for ( const auto& it : my_firsts ){
+	auto ins = confusions.insert( it );
+	if ( !ins.second && it.second < ins.first->second ){
+	  ins.first->second = it.second;
+	}
+      }
+    }
+    for ( const auto& it : confusions ){
+      os << it.first << "#" << coder.decode( it.second, alphabet ) << endl;
     }
   }
   cout << "generated confusion file " << name << endl;
@@ -382,14 +482,17 @@ void usage( const string& name ){
   cerr << "\t--separator=<sep> Add the 'sep' symbol to the alphabet." << endl;
   cerr << "\t--all\tfull output. Show ALL variants in the confusions file." << endl;
   cerr << "\t\tNormally only the first is shown." << endl;
+  cerr << "\t-t <threads>\n\t--threads <threads> Number of threads to run on." << endl;
+  cerr << "\t\t\t If 'threads' has the value \"max\", the number of threads is set to a" << endl;
+  cerr << "\t\t\t reasonable value. (OMP_NUM_TREADS - 2)" << endl;
   cerr << "\t-V\tshow version " << endl;
 }
 
 int main( int argc, char *argv[] ){
   TiCC::CL_Options opts;
   try {
-    opts.set_short_options( "vVho:" );
-    opts.set_long_options( "LD:,clip:,diac,all,separator:" );
+    opts.set_short_options( "vVho:t:" );
+    opts.set_long_options( "LD:,clip:,diac,all,separator:,threads:" );
     opts.init( argc, argv );
   }
   catch( TiCC::OptionError& e ){
@@ -439,6 +542,32 @@ int main( int argc, char *argv[] ){
       exit(EXIT_FAILURE);
     }
   }
+  int numThreads=1;
+  value = "1";
+  if ( !opts.extract( 't', value ) ){
+    opts.extract( "threads", value );
+  }
+#ifdef HAVE_OPENMP
+  if ( TiCC::lowercase(value) == "max" ){
+    numThreads = omp_get_max_threads() - 2;
+  }
+  else {
+    if ( !TiCC::stringTo(value,numThreads) ) {
+      cerr << "illegal value for -t (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+  if ( numThreads < 1 ){
+    numThreads = 1;
+  }
+  omp_set_num_threads( numThreads );
+#else
+  if ( value != "1" ){
+    cerr << "unable to set number of threads!.\nNo OpenMP support available!"
+	 <<endl;
+    exit(EXIT_FAILURE);
+  }
+#endif
   UnicodeString separator;
   if ( opts.extract( "separator", separator ) ){
     if ( separator.length() != 1 ){
@@ -28,7 +28,13 @@
 #include <cmath>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
+#include <queue>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <fstream>
 
@@ -37,6 +43,7 @@
 #include "ticcutils/StringOps.h"
 #include "ticcutils/XMLtools.h"
 #include "ticcutils/Unicode.h"
+#include "ticcl/wordfreq.h"
 
 #include "config.h"
 #ifdef HAVE_OPENMP
@@ -48,59 +55,295 @@ using namespace	TiCC;
 
 bool verbose = false;
 
-void create_wf_list( const map<string, unsigned int>& wc,
+typedef pair<string,unsigned int> word_freq;
+typedef bool (*word_order)( const word_freq&, const word_freq& );
+
+bool by_word( const word_freq& a, const word_freq& b ){
+  return a.first < b.first;
+}
+
+bool by_freq( const word_freq& a, const word_freq& b ){
+  return freq_before( a.first, a.second, b.first, b.second );
+}
+
+// a rough estimate of the memory used by a word in a hash or a vector,
+// besides the characters of the word itself
+const size_t ENTRY_OVERHEAD = 64;
+// the maximum number of runs that are merged at once. More runs are first
+// merged in groups
+const size_t MAX_FANIN = 128;
+
+class wf_writer {
+  // writes the (frequency sorted) entries of the output
+public:
+  wf_writer( ostream& os, unsigned int total, bool doperc ):
+    os(os), total_in(total), doperc(doperc), sum(0), types(0) {};
+  void add( const string&, unsigned int );
+  unsigned int type_count() const { return types; };
+private:
+  ostream& os;
+  unsigned int total_in;
+  bool doperc;
+  unsigned int sum;
+  unsigned int types;
+};
+
+void wf_writer::add( const string& word, unsigned int freq ){
+  sum += freq;
+  os << word << "\t" << freq;
+  if ( doperc ){
+    os << "\t" << sum << "\t" << 100 * double(sum)/total_in;
+  }
+  os << endl;
+  ++types;
+}
+
+void report_wf_list( const string& filename,
+		     unsigned int total_in,
+		     unsigned int types ){
+#pragma omp critical
+  {
+    cout << "created WordFreq list '" << filename << "'" << endl
+	 << "with " << total_in << " tokens and " << types
+	 << " types. TTR= " << (double)types/total_in
+	 << ", the angle is " << atan((double)types/total_in)*180/M_PI
+	 << " degrees" << endl;
+  }
+}
+
+void create_wf_list( const unordered_map<string, unsigned int>& wc,
+		     const string& filename, unsigned int total_in, bool doperc ){
+  ofstream os( filename );
+  if ( !os ){
+    cerr << "failed to create outputfile '" << filename << "'" << endl;
+    exit(EXIT_FAILURE);
+  }
+  wf_writer out( os, total_in, doperc );
+  for ( const auto& it : sorted_on_freq( wc ) ){
+    out.add( *it.first, it.second );
+  }
+  report_wf_list( filename, total_in, out.type_count() );
+}
+
+string run_name( const string& prefix ){
+  static size_t runs = 0;
+  string name;
+#pragma omp critical (run_name)
+  {
+    name = prefix + ".run." + toString( runs++ );
+  }
+  return name;
+}
+
+string spill_run( vector<word_freq>& entries,
+		  word_order order,
+		  const string& prefix ){
+  // sort the entries, and write them to a new temporary file
+  sort( entries.begin(), entries.end(), order );
+  string name = run_name( prefix );
+  ofstream os( name );
+  for ( const auto& e : entries ){
+    os << e.first << "\t" << e.second << "\n";
+  }
+  if ( !os ){
+    cerr << "failed to write temporary file '" << name << "'" << endl;
+    exit(EXIT_FAILURE);
+  }
+  entries.clear();
+  return name;
+}
+
+string spill_run( unordered_map<string,unsigned int>& wc,
+		  const string& prefix ){
+  string name = run_name( prefix );
+  ofstream os( name );
+  for ( const auto& e : sorted_on_word( wc ) ){
+    os << e->first << "\t" << e->second << "\n";
+  }
+  if ( !os ){
+    cerr << "failed to write temporary file '" << name << "'" << endl;
+    exit(EXIT_FAILURE);
+  }
+  unordered_map<string,unsigned int>().swap( wc );
+  return name;
+}
+
+class run_reader {
+public:
+  explicit run_reader( const string& name ): is( name ) { next(); };
+  bool next() { return valid = bool( is >> current.first >> current.second ); };
+  word_freq current;
+  bool valid;
+private:
+  ifstream is;
+};
+
+template <typename Sink>
+void merge_runs( const vector<string>& names, word_order order, Sink sink ){
+  // k-way merge of the sorted runs in 'names', calling sink() for every
+  // entry in 'order'. The runs are removed afterwards.
+  vector<unique_ptr<run_reader>> readers;
+  for ( const auto& name : names ){
+    readers.push_back( unique_ptr<run_reader>( new run_reader( name ) ) );
+  }
+  auto after = [&]( size_t a, size_t b ){
+    return order( readers[b]->current, readers[a]->current );
+  };
+  priority_queue<size_t,vector<size_t>,decltype(after)> heap( after );
+  for ( size_t i=0; i < readers.size(); ++i ){
+    if ( readers[i]->valid ){
+      heap.push( i );
+    }
+  }
+  while ( !heap.empty() ){
+    size_t i = heap.top();
+    heap.pop();
+    sink( readers[i]->current );
+    if ( readers[i]->next() ){
+      heap.push( i );
+    }
+  }
+  readers.clear();
+  for ( const auto& name : names ){
+    remove( name.c_str() );
+  }
+}
+
+class summer {
+  // adds the frequencies of consecutive entries with the same word, and
+  // passes the totals on
+public:
+  explicit summer( function<void(const word_freq&)> s ): sink(s), have(false) {};
+  void add( const word_freq& wf ){
+    if ( have && wf.first == last.first ){
+      last.second += wf.second;
+    }
+    else {
+      flush();
+      last = wf;
+      have = true;
+    }
+  };
+  void flush(){
+    if ( have ){
+      sink( last );
+      have = false;
+    }
+  };
+private:
+  function<void(const word_freq&)> sink;
+  word_freq last;
+  bool have;
+};
+
+vector<string> reduce_runs( const vector<string>& names,
+			    word_order order,
+			    const string& prefix ){
+  // merge the runs in groups, in parallel, until at most MAX_FANIN are left
+  vector<string> result = names;
+  while ( result.size() > MAX_FANIN ){
+    size_t groups = ( result.size() + MAX_FANIN - 1 ) / MAX_FANIN;
+    vector<string> merged( groups );
+#pragma omp parallel for schedule(dynamic,1)
+    for ( size_t g=0; g < groups; ++g ){
+      vector<string> group( result.begin() + g * MAX_FANIN,
+			    result.begin() + min( (g+1) * MAX_FANIN,
+						  result.size() ) );
+      merged[g] = run_name( prefix );
+      ofstream os( merged[g] );
+      summer sum( [&]( const word_freq& wf ){
+	  os << wf.first << "\t" << wf.second << "\n";
+	} );
+      merge_runs( group, order,
+		  [&]( const word_freq& wf ){ sum.add( wf ); } );
+      sum.flush();
+      if ( !os ){
+	cerr << "failed to write temporary file '" << merged[g] << "'" << endl;
+	exit(EXIT_FAILURE);
+      }
+    }
+    result = merged;
+  }
+  return result;
+}
+
+void create_wf_list( const vector<string>& word_runs,
+		     const string& prefix, size_t budget,
 		     const string& filename, unsigned int total_in, bool doperc ){
+  // the external memory version: merge the runs (sorted on word) and add
+  // up the frequencies. The totals are collected in new runs, now sorted on
+  // frequency, which are merged into the output.
   ofstream os( filename );
   if ( !os ){
     cerr << "failed to create outputfile '" << filename << "'" << endl;
     exit(EXIT_FAILURE);
   }
-  map<unsigned int, set<string> > wf;
-  for( const auto& cit : wc ){
-    wf[cit.second].insert( cit.first );
-  }
-  unsigned int sum=0;
-  unsigned int types=0;
-  map<unsigned int, set<string> >::const_reverse_iterator wit = wf.rbegin();
-  while ( wit != wf.rend() ){
-    for( const auto& sit : wit->second ){
-      sum += wit->first;
-      os << sit << "\t" << wit->first;
-      if ( doperc ){
-	os << "\t" << sum << "\t" << 100 * double(sum)/total_in;
+  vector<word_freq> buffer;
+  // reserve it all at once, instead of growing (and doubling) it
+  buffer.reserve( budget / ENTRY_OVERHEAD );
+  size_t used = 0;
+  vector<string> freq_runs;
+  summer sum( [&]( const word_freq& wf ){
+      buffer.push_back( wf );
+      used += wf.first.size() + ENTRY_OVERHEAD;
+      if ( used > budget ){
+	freq_runs.push_back( spill_run( buffer, by_freq, prefix ) );
+	used = 0;
       }
-      os << endl;
-      ++types;
+    } );
+  merge_runs( reduce_runs( word_runs, by_word, prefix ), by_word,
+	      [&]( const word_freq& wf ){ sum.add( wf ); } );
+  sum.flush();
+  wf_writer out( os, total_in, doperc );
+  if ( freq_runs.empty() ){
+    sort( buffer.begin(), buffer.end(), by_freq );
+    for ( const auto& wf : buffer ){
+      out.add( wf.first, wf.second );
     }
-    ++wit;
   }
-#pragma omp critical
-  {
-    cout << "created WordFreq list '" << filename << "'" << endl
-	 << "with " << total_in << " tokens and " << types
-	 << " types. TTR= " << (double)types/total_in
-	 << ", the angle is " << atan((double)types/total_in)*180/M_PI
-	 << " degrees" << endl;
+  else {
+    if ( !buffer.empty() ){
+      freq_runs.push_back( spill_run( buffer, by_freq, prefix ) );
+    }
+    cout << "merging " << freq_runs.size() << " frequency sorted runs" << endl;
+    merge_runs( reduce_runs( freq_runs, by_freq, prefix ), by_freq,
+		[&]( const word_freq& wf ){ out.add( wf.first, wf.second ); } );
   }
+  report_wf_list( filename, total_in, out.type_count() );
 }
 
-size_t read_words( const string& doc_name, map<string,unsigned int>& wc ){
+size_t read_words( const string& doc_name,
+		   unordered_map<string,unsigned int>& wc,
+		   size_t budget,
+		   size_t& used,
+		   const string& prefix,
+		   vector<string>& runs ){
+  // add the words in 'doc_name' to 'wc'. When 'wc' gets larger than
+  // 'budget', it is spilled to a run on disk
   size_t word_total = 0;
   ifstream is( doc_name );
   string line;
   while ( getline( is, line ) ){
     vector<string> v;
     if ( TiCC::split( line, v ) < 2 ){
-      cerr << "invalid input: " << line << endl;
+#pragma omp critical
+      {
+	cerr << "invalid input: " << line << endl;
+      }
       continue;
     }
     string wrd = v[0];
     size_t frq = stringTo<int>(v[1]);
-#pragma omp critical
-    {
-      wc[wrd] += frq;
-    }
+    auto ins = wc.insert( make_pair( wrd, 0 ) );
+    ins.first->second += frq;
     word_total += frq;
+    if ( ins.second ){
+      used += wrd.size() + ENTRY_OVERHEAD;
+      if ( used > budget ){
+	runs.push_back( spill_run( wc, prefix ) );
+	used = 0;
+      }
+    }
   }
   return word_total;
 }
@@ -113,6 +356,9 @@ void usage( const string& name ){
   cerr << "The output will be a 2 or 4 columned tab separated file, extension: *tsv " << endl;
   cerr << "\t (4 columns when -p is specified)" << endl;
   cerr << "\t-p\t output percentages too. " << endl;
+  cerr << "\t--mem <MB>\t use at most about 'MB' megabytes for the words. When" << endl;
+  cerr << "\t\t\t more are needed, sorted parts are written to temporary" << endl;
+  cerr << "\t\t\t files next to the output, and merged afterwards." << endl;
   cerr << "\t-t <threads>\n\t--threads <threads> Number of threads to run on." << endl;
   cerr << "\t\t\t If 'threads' has the value \"max\", the number of threads is set to a" << endl;
   cerr << "\t\t\t reasonable value. (OMP_NUM_TREADS - 2)" << endl;
@@ -125,7 +371,7 @@ void usage( const string& name ){
 }
 
 int main( int argc, char *argv[] ){
-  CL_Options opts( "hVve:t:o:Rp", "threads:" );
+  CL_Options opts( "hVve:t:o:Rp", "threads:,mem:" );
   try {
     opts.init(argc,argv);
   }
@@ -163,17 +409,18 @@ int main( int argc, char *argv[] ){
   int numThreads=1;
   if ( TiCC::lowercase(value) == "max" ){
     numThreads = omp_get_max_threads() - 2;
-    omp_set_num_threads( numThreads );
-    cout << "running on " << numThreads << " threads." << endl;
   }
   else {
     if ( !TiCC::stringTo(value,numThreads) ) {
       cerr << "illegal value for -t (" << value << ")" << endl;
       exit( EXIT_FAILURE );
     }
-    omp_set_num_threads( numThreads );
-    cout << "running on " << numThreads << " threads." << endl;
   }
+  if ( numThreads < 1 ){
+    numThreads = 1;
+  }
+  omp_set_num_threads( numThreads );
+  cout << "running on " << numThreads << " threads." << endl;
 #else
   if ( value != "1" ){
     cerr << "unable to set number of threads!.\nNo OpenMP support available!"
@@ -182,6 +429,14 @@ int main( int argc, char *argv[] ){
   }
 #endif
 
+  size_t mem_budget = 0;
+  if ( opts.extract( "mem", value ) ){
+    if ( !TiCC::stringTo(value,mem_budget) || mem_budget == 0 ){
+      cerr << "illegal value for --mem (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+    mem_budget *= 1024 * 1024;
+  }
   opts.extract('e', expression );
   bool dopercentage = opts.extract('p');
   if ( !opts.empty() ){
@@ -231,17 +486,69 @@ int main( int argc, char *argv[] ){
   if ( to_do > 1 ){
     cout << "start processing of " << to_do << " files " << endl;
   }
-  map<string,unsigned int> wc;
+  unordered_map<string,unsigned int> wc;
   unsigned int word_total =0;
-#pragma omp parallel for shared(file_names,word_total,wc)
-  for ( size_t fn=0; fn < file_names.size(); ++fn ){
-    string doc_name = file_names[fn];
-    unsigned int word_count = read_words( doc_name, wc );
-    word_total += word_count;
+  // every thread collects the words in its own hash. With --mem, the
+  // hashes are spilled to disk as sorted runs when they get too large
+  size_t thread_budget = (size_t)-1;
+  if ( mem_budget > 0 ){
+#ifdef HAVE_OPENMP
+    thread_budget = mem_budget / omp_get_max_threads();
+#else
+    thread_budget = mem_budget;
+#endif
+  }
+  string run_prefix = out_prefix + ".wordfreqlist";
+  vector<string> runs;
+  bool spilled = false;
+#pragma omp parallel shared(file_names,word_total,wc,runs,spilled)
+  {
+    unordered_map<string,unsigned int> local_wc;
+    size_t used = 0;
+    vector<string> local_runs;
+    unsigned int local_total = 0;
+#pragma omp for schedule(dynamic,1)
+    for ( size_t fn=0; fn < file_names.size(); ++fn ){
+      string doc_name = file_names[fn];
+      unsigned int word_count = read_words( doc_name, local_wc,
+					    thread_budget, used,
+					    run_prefix, local_runs );
+      local_total += word_count;
+#pragma omp critical
+      {
+	cout << "Processed :" << doc_name << " with " << word_count << " words,"
+	     << " still " << --to_do << " files to go." << endl;
+      }
+    }
 #pragma omp critical
     {
-      cout << "Processed :" << doc_name << " with " << word_count << " words,"
-	   << " still " << --to_do << " files to go." << endl;
+      runs.insert( runs.end(), local_runs.begin(), local_runs.end() );
+      spilled |= !local_runs.empty();
+      word_total += local_total;
+    }
+#pragma omp barrier
+    if ( spilled ){
+      // when any thread has spilled, all the rest is spilled too
+      if ( !local_wc.empty() ){
+	string name = spill_run( local_wc, run_prefix );
+#pragma omp critical
+	{
+	  runs.push_back( name );
+	}
+      }
+    }
+    else {
+#pragma omp critical
+      {
+	if ( wc.empty() ){
+	  wc.swap( local_wc );
+	}
+	else {
+	  for ( const auto& it : local_wc ){
+	    wc[it.first] += it.second;
+	  }
+	}
+      }
     }
   }
   if ( !dir_name.empty() ){
@@ -250,6 +557,13 @@ int main( int argc, char *argv[] ){
   }
   cout << "start outputting the results" << endl;
   string file_name = out_prefix + ".wordfreqlist.tsv";
-  create_wf_list( wc, file_name, word_total, dopercentage );
+  if ( runs.empty() ){
+    create_wf_list( wc, file_name, word_total, dopercentage );
+  }
+  else {
+    cout << "merging " << runs.size() << " sorted runs" << endl;
+    create_wf_list( runs, run_prefix, mem_budget,
+		    file_name, word_total, dopercentage );
+  }
   exit( EXIT_SUCCESS );
 }
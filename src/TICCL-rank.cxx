@@ -57,17 +57,26 @@ typedef signed long int bitType;
 
 const int RANK_COUNT=14;
 const string SEPARATOR = "_";
+// the number of variants looked up in the word vectors at once
+const size_t WV_BATCH = 1024;
 set<string> follow_words;
 
 bool verbose = false;
 
 void usage( const string& name ){
-  cerr << "usage: " << name << " --alph <alphabetfile> --charconf <lexstat file>[--wordvec <wordvectorfile>] [-o <outputfile>] [-t threads] [--clip <clip>] [--debugfile <debugfile>] [--artifrq art] [--skipcols <skip>] infile" << endl;
+  cerr << "usage: " << name << " --alph <alphabetfile> --charconf <lexstat file>[--wordvec <wordvectorfile> [--wordveccache <cachefile>] [--ann <indexfile>]] [-o <outputfile>] [-t threads] [--clip <clip>] [--debugfile <debugfile>] [--artifrq art] [--skipcols <skip>] infile" << endl;
   cerr << "\t'infile'\t is a file in TICCL-LDcalc format" << endl;
   cerr << "\t--alph 'alpha'\t an alphabet file in TICCL-lexstat format." << endl;
   cerr << "\t--charconf 'charconfus'\t a character confusion file in TICCL-lexstat format." << endl;
   cerr << "\t--charconfreq 'name'\t Extract a character confusion frequency file" << endl;
   cerr << "\t--wordvec<wordvecfile> read in a google word2vec file." << endl;
+  cerr << "\t\t\t This may also be a cache file made with --wordveccache" << endl;
+  cerr << "\t--wordveccache<cachefile>\t read the word vectors from the" << endl;
+  cerr << "\t\t\t (mmap-ed) 'cachefile'. It is created from the wordvec" << endl;
+  cerr << "\t\t\t file when not present yet." << endl;
+  cerr << "\t--ann<indexfile>\t search the word vectors using an approximate" << endl;
+  cerr << "\t\t\t nearest neighbour index, stored in 'indexfile'. It is" << endl;
+  cerr << "\t\t\t created when not present yet." << endl;
   cerr << "\t-o 'outfile'\t name of the output file." << endl;
   cerr << "\t-t <threads>\n\t--threads <threads> Number of threads to run on." << endl;
   cerr << "\t\t\t If 'threads' has the value \"max\", the number of threads is set to a" << endl;
@@ -82,6 +91,8 @@ void usage( const string& name ){
   cerr << "\t--artifrq 'arti'\t OBSOLETE. use --subtractartifrqfeature2." << endl;
   cerr << "\t--skipcols=arglist\t skip the named columns in the ranking." << endl;
   cerr << "\t\t\t e.g. if arglist=3,9, then the columns 3 and 9 are not used." << endl;
+  cerr << "\t--lowmem\t don't keep the records in memory, but re-read them from"
+       << " 'infile' when needed." << endl;
   cerr << "\t-v\t\t run (very) verbose" << endl;
   exit( EXIT_FAILURE );
 }
@@ -89,6 +100,8 @@ void usage( const string& name ){
 class record {
 public:
   record( const string &, size_t, size_t, const vector<word_dist>& );
+  record( const vector<string>&, size_t, size_t, const vector<word_dist>& );
+  void set_cosine( const vector<word_dist>& );
   string extractResults() const;
   string extractLong( const vector<bool>& skip ) const;
   string variant;
@@ -145,6 +158,14 @@ record::record( const string& line,
 		size_t sub_artifreq,
 		size_t sub_artifreq_f2,
 		const vector<word_dist>& WV ):
+  record( TiCC::split_at( line, "~" ), sub_artifreq, sub_artifreq_f2, WV )
+{
+}
+
+record::record( const vector<string>& parts,
+		size_t sub_artifreq,
+		size_t sub_artifreq_f2,
+		const vector<word_dist>& WV ):
   variant_count(-1),
   f2len_rank(-1),
   ld(-1),
@@ -156,7 +177,6 @@ record::record( const string& line,
   median_rank(-1),
   rank(-10000)
 {
-  vector<string> parts = TiCC::split_at( line, "~" );
   // file a record with the RANK_COUNT parts of one line from a LDcalc output file
   if ( parts.size() == RANK_COUNT ){
     variant = parts[0];
@@ -211,14 +231,18 @@ record::record( const string& line,
       khc_rank = 1;
     ngram_points = TiCC::stringTo<int>(parts[13]);
     ngram_rank = -6.7;  // bogus value, is set later
-    cosine = lookup( WV, candidate );
-    if ( cosine <= 0.001 )
-      cosine_rank = 1;
-    else
-      cosine_rank = 10;
+    set_cosine( WV );
   }
 }
 
+void record::set_cosine( const vector<word_dist>& WV ){
+  cosine = lookup( WV, candidate );
+  if ( cosine <= 0.001 )
+    cosine_rank = 1;
+  else
+    cosine_rank = 10;
+}
+
 string record::extractLong( const vector<bool>& skip ) const {
   string result = variant + "#";
   result += TiCC::toString(variant_freq) + "#";
@@ -360,29 +384,52 @@ void set_val( TObject& object, TMember member, TValue value )
     ( object ).*member = value;
 }
 
-template< class Tmap, typename TMember >
-void rank_desc_map( const Tmap& desc_map,
-		    vector<record>& recs,
-		    TMember member ){
-  // the map is a (multi-)map, sorted descending on the first value
-  // whichs is an integer value.
-  // the second value of the map is an index in the vector of records.
-  // so the map contains records, sorted descending on specific values
-  // e.g:
-  //  clsmap holds the CommonSubstringLengths of all vectors, longest first
-  if ( desc_map.empty() ){
-    return;
-  }
-  size_t last = desc_map.begin()->first; // start with the longest
-  int ranking = 1;                    // it will be ranked 1
-  for ( const auto& rit : desc_map ){
-    if ( rit.first < last ){
-      // we find a shorter. so ranking is incremented (meaning LOWER ranking)
-      last = rit.first;
-      ++ranking;
-    }
-    // set the currect ranking for the record at hand
-    set_val( recs[rit.second], member, ranking );
+const size_t SMALL_GROUP = 32;
+
+template< typename TValue, typename TMember >
+void dense_rank( const vector<TValue>& values,
+		 bool descending,
+		 vector<record>& recs,
+		 TMember member ){
+  // give every record the 'dense' rank of its value: 1 for the best value,
+  // 2 for the next best, and so on. Equal values get an equal rank.
+  // values[i] belongs to recs[i].
+  // Most groups are small, and are sorted in a buffer on the stack.
+  const size_t n = values.size();
+  TValue buf[SMALL_GROUP];
+  vector<TValue> big;
+  TValue *sorted = buf;
+  if ( n > SMALL_GROUP ){
+    big.resize( n );
+    sorted = &big[0];
+  }
+  copy( values.begin(), values.end(), sorted );
+  if ( descending ){
+    sort( sorted, sorted + n, greater<TValue>() );
+    TValue *end = unique( sorted, sorted + n );
+    for ( size_t i=0; i < n; ++i ){
+      int ranking = lower_bound( sorted, end, values[i],
+				 greater<TValue>() ) - sorted + 1;
+      set_val( recs[i], member, ranking );
+    }
+  }
+  else {
+    sort( sorted, sorted + n );
+    TValue *end = unique( sorted, sorted + n );
+    for ( size_t i=0; i < n; ++i ){
+      int ranking = lower_bound( sorted, end, values[i] ) - sorted + 1;
+      set_val( recs[i], member, ranking );
+    }
+  }
+}
+
+template< typename TValue, typename TMember >
+void fill_column( const vector<record>& recs,
+		  TMember member,
+		  vector<TValue>& column ){
+  column.resize( recs.size() );
+  for ( size_t i=0; i < recs.size(); ++i ){
+    column[i] = recs[i].*member;
   }
 }
 
@@ -405,30 +452,10 @@ void rank( vector<record>& recs,
 	   << " with " << recs.size() << " variants" << endl;
     }
   }
-  multimap<size_t,size_t,std::greater<size_t>> freqmap;  // freqs sorted descending
-  multimap<size_t,size_t,std::greater<size_t>> f2lenmap; // f2 lenghts sorted descending
-  multimap<size_t,size_t> ldmap;
-  multimap<size_t,size_t, std::greater<size_t>> clsmap; // Common substring lengths descending
-  multimap<size_t,size_t,std::greater<size_t>> pairmap1;
-  multimap<size_t,size_t,std::greater<size_t>> pairmap2;
-  multimap<size_t,size_t,std::greater<size_t>> median_map;
-  multimap<size_t,size_t,std::greater<size_t>> ngram_map;
-  map<string,int> lowvarmap;
-  size_t count = 0;
-
+  const size_t n = recs.size();
+  vector<int> lowvar( n ); // frequency of the lowercased candidate
   for ( auto& it : recs ){
-    // for every record, we store information in descending multimaps
-    // So in freqmap, the (index of) the records with highest freq
-    //   are stored in front
-    //same for f2len, ld, cls and ngram points
-    freqmap.insert( make_pair(it.reduced_candidate_freq, count ) ); // freqs descending
-    f2lenmap.insert( make_pair(it.f2len, count ) ); // f2lengths descending
-    ldmap.insert( make_pair(it.ld,count) ); // lds sorted ASCENDING
-    clsmap.insert( make_pair(it.cls,count) ); // cls sorted descending
-    ngram_map.insert( make_pair(it.ngram_points,count) ); // ngrampoints sorted descending
-    size_t var1_cnt = kwc_counts.at(it.kwc);
-    it.pairs1 = var1_cnt;
-    pairmap1.insert( make_pair(var1_cnt,count )); // #variants descending
+    it.pairs1 = kwc_counts.at(it.kwc); // #variants
     size_t var2_cnt = 0;
     try {
       var2_cnt += kwc2_counts.at(it.kwc);
@@ -436,19 +463,57 @@ void rank( vector<record>& recs,
     catch(...){
     }
     it.pairs2 = var2_cnt;
-    pairmap2.insert( make_pair(var2_cnt,count )); // #variants decending
     it.median = kwc_medians.at(it.kwc);
-    median_map.insert( make_pair(it.median,count )); // #medians decending
-    ++lowvarmap[it.lower_candidate]; // count frequency of variants
-    ++count;
   }
-  multimap<int,size_t,std::greater<int>> lower_variantmap; // descending map
-  count = 0;
-  for ( const auto& it : recs ){
-    lower_variantmap.insert( make_pair( lowvarmap[it.lower_candidate], count ) );
-    ++count;
+  if ( n > 1 ){
+    // count the frequency of the lowercased candidates
+    vector<size_t> order( n );
+    for ( size_t i=0; i < n; ++i ){
+      order[i] = i;
+    }
+    sort( order.begin(), order.end(),
+	  [&recs]( size_t lhs, size_t rhs ){
+	    return recs[lhs].lower_candidate < recs[rhs].lower_candidate; } );
+    size_t start = 0;
+    while ( start < n ){
+      size_t end = start + 1;
+      while ( end < n
+	      && recs[order[end]].lower_candidate
+	      == recs[order[start]].lower_candidate ){
+	++end;
+      }
+      for ( size_t i=start; i < end; ++i ){
+	lowvar[order[i]] = end - start;
+      }
+      start = end;
+    }
+  }
+  else {
+    lowvar[0] = 1;
   }
   if ( follow ){
+    // show the features, sorted like they are ranked
+    multimap<size_t,size_t,std::greater<size_t>> freqmap;
+    multimap<size_t,size_t,std::greater<size_t>> f2lenmap;
+    multimap<size_t,size_t> ldmap;
+    multimap<size_t,size_t, std::greater<size_t>> clsmap;
+    multimap<size_t,size_t,std::greater<size_t>> pairmap1;
+    multimap<size_t,size_t,std::greater<size_t>> pairmap2;
+    multimap<size_t,size_t,std::greater<size_t>> median_map;
+    multimap<size_t,size_t,std::greater<size_t>> ngram_map;
+    multimap<int,size_t,std::greater<int>> lower_variantmap;
+    for ( size_t i=0; i < n; ++i ){
+      const record& it = recs[i];
+      freqmap.insert( make_pair(it.reduced_candidate_freq, i ) );
+      f2lenmap.insert( make_pair(it.f2len, i ) );
+      ldmap.insert( make_pair(it.ld,i) );
+      clsmap.insert( make_pair(it.cls,i) );
+      ngram_map.insert( make_pair(it.ngram_points,i) );
+      pairmap1.insert( make_pair(it.pairs1,i ));
+      pairmap2.insert( make_pair(it.pairs2,i ));
+      median_map.insert( make_pair(it.median,i ));
+      lower_variantmap.insert( make_pair( lowvar[i], i ) );
+    }
     cout << "1 f2lenmap = " << f2lenmap << endl;
     cout << "2 freqmap = " << freqmap << endl;
     cout << "3 ldmap = " << ldmap << endl;
@@ -456,11 +521,14 @@ void rank( vector<record>& recs,
     cout << "9 pairmap1 = " << pairmap1 << endl;
     cout << "10 pairmap2 = " << pairmap2 << endl;
     cout << "11 medianmap = " << median_map << endl;
-    //    cout << "12-a lowvarmap = " << lowvarmap << endl;
     cout << "12 lower_variantmap = " << lower_variantmap << endl;
     cout << "14 ngram_map = " << ngram_map << endl;
   }
-  rank_desc_map( f2lenmap, recs, &record::f2len_rank );
+  // all features are ranked descending (higher is better), except for
+  // the Levenshtein distance.
+  vector<size_t> column;
+  fill_column( recs, &record::f2len, column );
+  dense_rank( column, true, recs, &record::f2len_rank );
   if ( follow ){
     cout << "step 1: f2len_rank: " << endl;
     for ( const auto& r : recs ){
@@ -468,7 +536,8 @@ void rank( vector<record>& recs,
     }
   }
 
-  rank_desc_map( freqmap, recs, &record::freq_rank );
+  fill_column( recs, &record::reduced_candidate_freq, column );
+  dense_rank( column, true, recs, &record::freq_rank );
   if ( follow ){
     cout << "step 2: freq_rank: " << endl;
     for ( const auto& r : recs ){
@@ -476,17 +545,8 @@ void rank( vector<record>& recs,
     }
   }
 
-  if ( !ldmap.empty() ){
-    int ranking = 1;
-    size_t last = ldmap.begin()->first;
-    for ( const auto& sit : ldmap ){
-      if ( sit.first > last ){
-   	last = sit.first;
-   	++ranking;
-      }
-      recs[sit.second].ld_rank = ranking;
-    }
-  }
+  fill_column( recs, &record::ld, column );
+  dense_rank( column, false, recs, &record::ld_rank );
   if ( follow ){
     cout << "step 3: ld_rank: " << endl;
     for ( const auto& r : recs ){
@@ -494,7 +554,8 @@ void rank( vector<record>& recs,
     }
   }
 
-  rank_desc_map( clsmap, recs, &record::cls_rank );
+  fill_column( recs, &record::cls, column );
+  dense_rank( column, true, recs, &record::cls_rank );
   if ( follow ){
     cout << "step 4: cls_rank: " << endl;
     for ( const auto& r : recs ){
@@ -530,7 +591,8 @@ void rank( vector<record>& recs,
     }
   }
 
-  rank_desc_map( pairmap1, recs, &record::pairs1_rank );
+  fill_column( recs, &record::pairs1, column );
+  dense_rank( column, true, recs, &record::pairs1_rank );
   if ( follow ){
     cout << "step 9: pairs1_rank: " << endl;
     for ( const auto& r : recs ){
@@ -538,7 +600,8 @@ void rank( vector<record>& recs,
     }
   }
 
-  rank_desc_map( pairmap2, recs, &record::pairs2_rank );
+  fill_column( recs, &record::pairs2, column );
+  dense_rank( column, true, recs, &record::pairs2_rank );
   if ( follow ){
     cout << "step 10: pairs2_rank: " << endl;
     for ( const auto& r : recs ){
@@ -546,7 +609,8 @@ void rank( vector<record>& recs,
     }
   }
 
-  rank_desc_map( median_map, recs, &record::median_rank );
+  fill_column( recs, &record::median, column );
+  dense_rank( column, true, recs, &record::median_rank );
   if ( follow ){
     cout << "step 11: median_rank: for " << recs.begin()->variant << endl;
     for ( const auto& r : recs ){
@@ -554,18 +618,10 @@ void rank( vector<record>& recs,
     }
   }
 
-  if ( !lower_variantmap.empty() ){
-    int ranking = 1;
-    int last = lower_variantmap.begin()->first;
-    for ( const auto& it1 : lower_variantmap ){
-      if ( it1.first < last ){
-	last = it1.first;
-	++ranking;
-      }
-      recs[it1.second].variant_count = it1.first;
-      recs[it1.second].variant_rank = ranking;
-    }
+  for ( size_t i=0; i < n; ++i ){
+    recs[i].variant_count = lowvar[i];
   }
+  dense_rank( lowvar, true, recs, &record::variant_rank );
   if ( follow ){
     cout << "step 12: lower_variant_rank: " << endl;
     for ( const auto& r : recs ){
@@ -580,7 +636,8 @@ void rank( vector<record>& recs,
     }
   }
 
-  rank_desc_map( ngram_map, recs, &record::ngram_rank );
+  fill_column( recs, &record::ngram_points, column );
+  dense_rank( column, true, recs, &record::ngram_rank );
   if ( follow ){
     cout << "step 14: ngram_rank: " << endl;
     for ( const auto& r : recs ){
@@ -637,29 +694,31 @@ void rank( vector<record>& recs,
   }
 
   // sort records on alphabeticaly on variant and descending on rank
-  map<string,multimap<double,record*,std::greater<double>>> output;
-  for ( auto& it : recs ){
-    string variant = it.variant;
-    auto p = output.find(variant);
-    if ( p != output.end()  ){
-      p->second.insert( make_pair( it.rank, &it) );
-      // rank sorted descending per variant.
-    }
-    else {
-      // new variant.
-      multimap<double,record*,std::greater<double>> tmp;
-      tmp.insert( make_pair( it.rank, &it ) );
-      output.insert( make_pair(variant,tmp) );
-    }
-  }
+  // records with the same rank keep their order
+  vector<size_t> order( n );
+  for ( size_t i=0; i < n; ++i ){
+    order[i] = i;
+  }
+  stable_sort( order.begin(), order.end(),
+	       [&recs]( size_t lhs, size_t rhs ){
+		 if ( recs[lhs].variant != recs[rhs].variant ){
+		   return recs[lhs].variant < recs[rhs].variant;
+		 }
+		 return recs[lhs].rank > recs[rhs].rank; } );
 
   // now extract the first 'clip' records for every variant, (best ranked)
-  for ( const auto& it : output ){
-    const auto& mm = it.second;
+  size_t start = 0;
+  while ( start < n ){
+    const string& variant = recs[order[start]].variant;
+    size_t end = start + 1;
+    while ( end < n && recs[order[end]].variant == variant ){
+      ++end;
+    }
     int cnt = 0;
     multimap<double,record,std::greater<double>> tmp;
-    for ( const auto& mit : mm ){
-      tmp.insert( make_pair( mit.first, *mit.second ) );
+    for ( size_t i=start; i < end; ++i ){
+      const record& rec = recs[order[i]];
+      tmp.insert( tmp.end(), make_pair( rec.rank, rec ) );
       if ( ++cnt >= clip ){
 	break;
       }
@@ -667,20 +726,26 @@ void rank( vector<record>& recs,
     // store the result vector
 #pragma omp critical (store)
     {
-      results.insert( make_pair(it.first,tmp) );
+      results.insert( make_pair(variant,tmp) );
     }
+    start = end;
   }
 
   if ( db ){
-    vector<record>::iterator vit = recs.begin();
-    multimap<double,string,greater<double>> outv;
-    while ( vit != recs.end() ){
-      outv.insert( make_pair( (*vit).rank, vit->extractLong(skip) ) );
-      ++vit;
+    // descending on rank only
+    for ( size_t i=0; i < n; ++i ){
+      order[i] = i;
+    }
+    stable_sort( order.begin(), order.end(),
+		 [&recs]( size_t lhs, size_t rhs ){
+		   return recs[lhs].rank > recs[rhs].rank; } );
+    vector<string> outv;
+    for ( const auto& i : order ){
+      outv.push_back( recs[i].extractLong(skip) );
     }
 #pragma omp critical (debugoutput)
-    for ( const auto& oit : outv ){
-      *db << oit.second << endl;
+    for ( const auto& line : outv ){
+      *db << line << endl;
     }
   }
 }
@@ -781,17 +846,57 @@ vector<record> filter_ngrams( const vector<record>& records,
 
 struct wid {
   wid( const string& s, const set<streamsize>& st ): _s(s), _st(st) {};
+  wid( const string& s, vector<record>& recs ): _s(s) { _recs.swap( recs ); };
   string _s;
-  set<streamsize> _st;
+  set<streamsize> _st;   // the file positions of the records (--lowmem)
+  vector<record> _recs;  // the records themselves
 };
 
+void read_records( const string& inFile,
+		   const set<streamsize>& ids,
+		   size_t sub_artifreq,
+		   size_t sub_artifreq_f1,
+		   const vector<word_dist>& vec,
+		   vector<record>& records,
+		   bool show_progress,
+		   size_t& count ){
+  // re-read the records of one variant from the LDcalc file, using the
+  // file positions collected in the first pass
+  ifstream in( inFile );
+  for ( const auto& pos : ids ){
+    in.seekg( pos );
+    string line;
+    getline( in, line );
+    records.push_back( record( line, sub_artifreq, sub_artifreq_f1, vec ) );
+    if ( show_progress ){
+      int tmp = 0;
+#pragma omp critical (count)
+      tmp = ++count;
+      //
+      // omp single isn't allowed here. trick!
+      int numt = 0;
+#ifdef HAVE_OPENMP
+      numt = omp_get_thread_num();
+#endif
+      if ( numt == 0 && tmp % 10000 == 0 ){
+	cout << ".";
+	cout.flush();
+	if ( tmp % 500000 == 0 ){
+	  cout << endl << tmp << endl;
+	}
+      }
+    }
+  }
+}
+
 int main( int argc, char **argv ){
   TiCC::CL_Options opts;
   try {
     opts.set_short_options( "vVho:t:" );
     opts.set_long_options( "alph:,debugfile:,skipcols:,charconf:,charconfreq:,"
 			   "artifrq:,subtractartifrqfeature1:,subtractartifrqfeature2:,"
-			   "wordvec:,clip:,numvec:,threads:,verbose,follow:,ALTERNATIVE" );
+			   "wordvec:,wordveccache:,ann:,clip:,numvec:,threads:,verbose,follow:,ALTERNATIVE,"
+			   "lowmem" );
     opts.init( argc, argv );
   }
   catch( TiCC::OptionError& e ){
@@ -814,10 +919,13 @@ int main( int argc, char **argv ){
   }
   bool verbose = opts.extract( 'v' ) || opts.extract("verbose");
   bool ALTERNATIVE = opts.extract( "ALTERNATIVE" );
+  bool lowmem = opts.extract( "lowmem" );
   string alfabetFile;
   string lexstatFile;
   string freqOutFile;
   string wordvecFile;
+  string wordvecCache;
+  string annFile;
   string outFile;
   string debugFile;
   int clip = 0;
@@ -834,6 +942,16 @@ int main( int argc, char **argv ){
     exit(EXIT_FAILURE);
   }
   opts.extract( "wordvec", wordvecFile );
+  opts.extract( "wordveccache", wordvecCache );
+  if ( !wordvecCache.empty() && wordvecFile.empty() ){
+    cerr << "--wordveccache is only useful with --wordvec" << endl;
+    exit(EXIT_FAILURE);
+  }
+  opts.extract( "ann", annFile );
+  if ( !annFile.empty() && wordvecFile.empty() ){
+    cerr << "--ann is only useful with --wordvec" << endl;
+    exit(EXIT_FAILURE);
+  }
   opts.extract( 'o', outFile );
   opts.extract( "debugfile", debugFile );
   opts.extract( "skipcols", skipC );
@@ -978,12 +1096,25 @@ int main( int argc, char **argv ){
   wordvec_tester WV;
   if ( !wordvecFile.empty() ){
     cerr << "loading word vectors" << endl;
-    bool res = WV.fill( wordvecFile );
+    bool res;
+    if ( wordvecCache.empty() ){
+      res = WV.fill( wordvecFile );
+    }
+    else {
+      res = WV.use_cache( wordvecFile, wordvecCache );
+    }
     if ( !res ){
       cerr << "problem opening wordvec file: " << wordvecFile << endl;
       exit(1);
     }
     cerr << "loaded " << WV.size() << " word vectors" << endl;
+    if ( !annFile.empty() ){
+      if ( !WV.use_index( annFile ) ){
+	cerr << "problem using index file: " << annFile << endl;
+	exit(1);
+      }
+      cerr << "using index " << annFile << endl;
+    }
 #ifdef TESTWV
     vector<word_dist> wv_result;
     if ( !WV.lookup( "dofter", num_vec, wv_result ) ){
@@ -1065,12 +1196,20 @@ int main( int argc, char **argv ){
     alfabet[key[0]] = value;
   }
 
+  // every line is parsed only once, into records grouped per variant.
+  // With --lowmem, we only store the file positions, and re-read them later.
+  map<string,vector<record>> groups;
   map<string,set<streamsize> > fileIds;
+  const vector<word_dist> no_vec;
   map<bitType,size_t> kwc_counts;
   map<bitType,vector<size_t>> cc_freqs;
   cout << "start indexing input and determining KWC counts AND CC freq per KWC" << endl;
   int failures = 0;
-  streamsize pos = input.tellg();
+  streamsize pos = 0;
+  if ( lowmem ){
+    pos = input.tellg();
+  }
+  auto group = groups.end();
   while ( getline( input, line ) ){
     if ( verbose ){
       cerr << "bekijk " << line << endl;
@@ -1086,7 +1225,17 @@ int main( int argc, char **argv ){
     }
     else {
       string variant = parts[0];
-      fileIds[variant].insert( pos );
+      if ( lowmem ){
+	fileIds[variant].insert( pos );
+      }
+      else {
+	if ( group == groups.end() || group->first != variant ){
+	  group = groups.insert( make_pair( variant, vector<record>() ) ).first;
+	}
+	group->second.push_back( record( parts,
+					 sub_artifreq, sub_artifreq_f1,
+					 no_vec ) );
+      }
       bitType kwc = TiCC::stringTo<bitType>(parts[6]);
       ++kwc_counts[kwc];
       size_t ccf = TiCC::stringTo<size_t>(parts[4]);
@@ -1099,7 +1248,9 @@ int main( int argc, char **argv ){
 	}
       }
     }
-    pos = input.tellg();
+    if ( lowmem ){
+      pos = input.tellg();
+    }
   }
   cout << endl << "Done indexing" << endl;
 
@@ -1253,6 +1404,10 @@ int main( int argc, char **argv ){
   for ( const auto& it : fileIds ){
     work.push_back( wid( it.first, it.second ) );
   }
+  for ( auto& it : groups ){
+    work.push_back( wid( it.first, it.second ) );
+  }
+  groups.clear();
   count = 0;
 
   cout << "Start searching for ngram proof, with " << work.size()
@@ -1260,116 +1415,91 @@ int main( int argc, char **argv ){
   set<string> variants_set;
 #pragma omp parallel for schedule(dynamic,1) shared(variants_set,verbose)
   for( size_t i=0; i < work.size(); ++i ){
-    const set<streamsize>& ids = work[i]._st;
-    ifstream in( inFile );
-    vector<record> records;
-    set<streamsize>::const_iterator it = ids.begin();
-    while ( it != ids.end() ){
-      vector<word_dist> vec;
-      in.seekg( *it );
-      ++it;
-      string line;
-      getline( in, line );
-      record rec( line, sub_artifreq, sub_artifreq_f1, vec );
-      records.push_back( rec );
-      if ( verbose ){
-	int tmp = 0;
-#pragma omp critical (count)
-	tmp = ++count;
-	//
-	// omp single isn't allowed here. trick!
-	int numt = 0;
-#ifdef HAVE_OPENMP
-	numt = omp_get_thread_num();
-#endif
-	if ( numt == 0 && tmp % 10000 == 0 ){
-	  cout << ".";
-	  cout.flush();
-	  if ( tmp % 500000 == 0 ){
-	    cout << endl << tmp << endl;
-	  }
-	}
-      }
+    if ( lowmem ){
+      vector<record> records;
+      read_records( inFile, work[i]._st, sub_artifreq, sub_artifreq_f1,
+		    no_vec, records, verbose, count );
+      collect_ngrams( records, variants_set );
+    }
+    else {
+      collect_ngrams( work[i]._recs, variants_set );
     }
-    collect_ngrams( records, variants_set );
   }
 
   map<string,multimap<double,record,std::greater<double>>> results;
   cout << "Start the REAL work, with " << work.size()
        << " iterations on " << numThreads << " thread(s)." << endl;
-#pragma omp parallel for schedule(dynamic,1) shared(verbose,db)
-  for( size_t i=0; i < work.size(); ++i ){
-    const set<streamsize>& ids = work[i]._st;
-    vector<word_dist> vec;
+  // the word vector neighbours of the variants are looked up in batches,
+  // with one sweep over all the vectors per batch
+  const size_t batch_size = WV.size() > 0 ? WV_BATCH : work.size();
+  for ( size_t batch = 0; batch < work.size(); batch += batch_size ){
+    const size_t batch_end = min( batch + batch_size, work.size() );
+    vector<vector<word_dist>> neighbours;
     if ( WV.size() > 0 ){
-      WV.lookup( work[i]._s, 20, vec );
-      if ( verbose ){
-#pragma omp critical (log)
-	{
-	  cerr << "looked up: " << work[i]._s << endl;
-	}
+      vector<string> variants;
+      for ( size_t i=batch; i < batch_end; ++i ){
+	variants.push_back( work[i]._s );
       }
+      WV.lookup( variants, 20, neighbours );
     }
-    ifstream in( inFile );
-    vector<record> records;
-    set<streamsize>::const_iterator it = ids.begin();
-    while ( it != ids.end() ){
-      in.seekg( *it );
-      ++it;
-      string line;
-      getline( in, line );
-      record rec( line, sub_artifreq, sub_artifreq_f1, vec );
-      records.push_back( rec );
-      if ( verbose ){
-	int tmp = 0;
-#pragma omp critical (count)
-	tmp = ++count;
-	//
-	// omp single isn't allowed here. trick!
-	int numt = 0;
-#ifdef HAVE_OPENMP
-	numt = omp_get_thread_num();
-#endif
-	if ( numt == 0 && tmp % 10000 == 0 ){
-	  cout << ".";
-	  cout.flush();
-	  if ( tmp % 500000 == 0 ){
-	    cout << endl << tmp << endl;
+#pragma omp parallel for schedule(dynamic,1) shared(verbose,db)
+    for( size_t i=batch; i < batch_end; ++i ){
+      vector<word_dist> vec;
+      if ( !neighbours.empty() ){
+	vec.swap( neighbours[i-batch] );
+	if ( verbose ){
+#pragma omp critical (log)
+	  {
+	    cerr << "looked up: " << work[i]._s << endl;
 	  }
 	}
       }
-    }
-    records = filter_ngrams( records, variants_set );
-    if ( !records.empty() ){
-      if ( ALTERNATIVE ){
-	map<bitType,vector<size_t>> local_cc_freqs;
-	for ( const auto& it : records ){
-	  local_cc_freqs[it.kwc].push_back( it.candidate_freq );
+      vector<record> records;
+      if ( lowmem ){
+	read_records( inFile, work[i]._st, sub_artifreq, sub_artifreq_f1,
+		      vec, records, verbose, count );
+      }
+      else {
+	// this is the last time we need them
+	records.swap( work[i]._recs );
+	if ( !vec.empty() ){
+	  for ( auto& rec : records ){
+	    rec.set_cosine( vec );
+	  }
 	}
-	map<bitType,size_t> local_kwc_medians;
-	for ( auto& it : local_cc_freqs ){
-	  sort( it.second.begin(), it.second.end() );
-	  //    cerr << "vector: " << it.second << endl;
-	  size_t size = it.second.size();
-	  size_t median =0;
-	  if ( size %2 == 0 ){
-	    // even
-	    median = ( it.second[size/2 -1] + it.second[size/2] ) / 2;
+      }
+      records = filter_ngrams( records, variants_set );
+      if ( !records.empty() ){
+	if ( ALTERNATIVE ){
+	  map<bitType,vector<size_t>> local_cc_freqs;
+	  for ( const auto& it : records ){
+	    local_cc_freqs[it.kwc].push_back( it.candidate_freq );
 	  }
-	  else {
-	    median = it.second[size/2];
+	  map<bitType,size_t> local_kwc_medians;
+	  for ( auto& it : local_cc_freqs ){
+	    sort( it.second.begin(), it.second.end() );
+	    //    cerr << "vector: " << it.second << endl;
+	    size_t size = it.second.size();
+	    size_t median =0;
+	    if ( size %2 == 0 ){
+	      // even
+	      median = ( it.second[size/2 -1] + it.second[size/2] ) / 2;
+	    }
+	    else {
+	      median = it.second[size/2];
+	    }
+	    //    cerr << "median " << it.first << " = " << median << endl;
+	    local_kwc_medians[it.first] = median;
 	  }
-	  //    cerr << "median " << it.first << " = " << median << endl;
-	  local_kwc_medians[it.first] = median;
+	  ::rank( records, results, clip, kwc_counts, kwc2_counts,
+		  local_kwc_medians,
+		  db, skip, skip_factor );
+	}
+	else {
+	  ::rank( records, results, clip, kwc_counts, kwc2_counts,
+		  kwc_medians,
+		  db, skip, skip_factor );
 	}
-	::rank( records, results, clip, kwc_counts, kwc2_counts,
-		local_kwc_medians,
-		db, skip, skip_factor );
-      }
-      else {
-	::rank( records, results, clip, kwc_counts, kwc2_counts,
-		kwc_medians,
-		db, skip, skip_factor );
       }
     }
   }
@@ -28,6 +28,7 @@
 #include <cmath>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <iostream>
 #include <fstream>
@@ -36,6 +37,7 @@
 #include "ticcutils/FileUtils.h"
 #include "ticcutils/StringOps.h"
 #include "ticcutils/XMLtools.h"
+#include "libxml/xmlreader.h"
 #include "ticcutils/Unicode.h"
 
 #include "config.h"
@@ -48,7 +50,7 @@ using namespace	TiCC;
 
 bool verbose = false;
 
-void create_wf_list( const map<string, unsigned int>& wc,
+void create_wf_list( const unordered_map<string, unsigned int>& wc,
 		     const string& filename, unsigned int totalIn,
 		     unsigned int clip,
 		     bool doperc ){
@@ -109,16 +111,123 @@ bool is_emph( const string& data ){
   return (data.size() < 2) && isalnum(data[0]);
 }
 
+class ngram_window {
+  // the last 'n' words seen, in a ring buffer. The words are not shifted
+  // on every step, and the ngram is built in the same string every time.
+public:
+  ngram_window( size_t n, const string& s ):
+    words(n), sep(s), filled(0), first(0) {};
+  bool add( const string& );
+  const string& gram();
+  void clear() { filled = 0; first = 0; };
+private:
+  vector<string> words;
+  string sep;
+  size_t filled;
+  size_t first;
+  string key;
+};
+
+bool ngram_window::add( const string& word ){
+  // add a word. returns true when there are enough words for an ngram
+  const size_t n = words.size();
+  if ( filled < n ){
+    words[(first+filled) % n] = word;
+    ++filled;
+  }
+  else {
+    words[first] = word;
+    first = (first+1) % n;
+  }
+  return filled == n;
+}
+
+const string& ngram_window::gram(){
+  const size_t n = words.size();
+  if ( n == 1 ){
+    return words[0];
+  }
+  key.clear();
+  for ( size_t i=0; i < n; ++i ){
+    if ( i > 0 ){
+      key += sep;
+    }
+    key += words[(first+i) % n];
+  }
+  return key;
+}
+
+class word_counter {
+  // splits text in words, and counts the ngrams and the historical
+  // emphasis sequences in it.
+public:
+  word_counter( size_t ngram, const string& sep ):
+    buffer( ngram, sep ), in_emph(false) {};
+  size_t add_text( const string&,
+		   bool,
+		   unordered_map<string,unsigned int>&,
+		   set<string>& );
+  void new_line() { buffer.clear(); };
+  void reset();
+private:
+  ngram_window buffer;
+  bool in_emph;
+  string emph_start;
+  string emph_word;
+};
+
+void word_counter::reset(){
+  buffer.clear();
+  in_emph = false;
+  emph_start.clear();
+  emph_word.clear();
+}
+
+size_t word_counter::add_text( const string& line,
+			       bool lowercase,
+			       unordered_map<string,unsigned int>& wc,
+			       set<string>& emps ){
+  size_t cnt = 0;
+  vector<string> v;
+  TiCC::split( line, v );
+  for ( const auto& word : v ){
+    string wrd = word;
+    if ( lowercase ){
+      wrd = TiCC::utf8_lowercase( word );
+    }
+    if ( is_emph( wrd ) ){
+      if ( in_emph ){
+	emph_word += "_" + wrd;
+      }
+      else {
+	emph_start = wrd;
+	in_emph = true;
+      }
+    }
+    else {
+      if ( in_emph && !emph_word.empty() ){
+	emps.insert( emph_start + emph_word );
+      }
+      in_emph = false;
+      emph_start.clear();
+      emph_word.clear();
+    }
+    if ( buffer.add( wrd ) ){
+      ++wc[buffer.gram()];
+      ++cnt;
+    }
+  }
+  return cnt;
+}
+
 size_t tel( const xmlNode *node, bool lowercase,
 	    size_t ngram, const string& sep,
-	    map<string, unsigned int>& wc,
+	    unordered_map<string, unsigned int>& wc,
 	    set<string>& emps ){
-  vector<string> buffer(ngram);
+  // the TEXT children of a node are counted together. Text in deeper nodes
+  // is counted separately
+  word_counter counter( ngram, sep );
   size_t cnt = 0;
-  size_t buf_cnt = 0;
-  bool in_emph = false;
-  string emph_start;
-  string emph_word;
   xmlNode *pnt = node->children;
   while ( pnt ){
     //    cerr << "bekijk label: " << (char*)pnt->name << endl;
@@ -126,46 +235,7 @@ size_t tel( const xmlNode *node, bool lowercase,
     if ( pnt->type == XML_TEXT_NODE ){
       string line  = (char*)( pnt->content );
       //      cerr << "text: " << line << endl;
-      vector<string> v;
-      TiCC::split( line, v );
-      for ( const auto& word : v ){
-	string wrd = word;
-	if ( lowercase ){
-	  wrd = TiCC::utf8_lowercase( word );
-	}
-	if ( is_emph( wrd ) ){
-	  if ( in_emph ){
-	    emph_word += "_" + wrd;
-	  }
-	  else {
-	    emph_start = wrd;
-	    in_emph = true;
-	  }
-	}
-	else {
-	  if ( in_emph && !emph_word.empty() ){
-	    emps.insert( emph_start + emph_word );
-	  }
-	  in_emph = false;
-	  emph_start.clear();
-	  emph_word.clear();
-	}
-	buffer[buf_cnt++] = wrd;
-	if ( buf_cnt == ngram ){
-	  buf_cnt = ngram-1;
-	  string gram;
-	  for( size_t i=0; i < ngram -1; ++i ){
-	    gram += buffer[i] + sep;
-	    buffer[i] = buffer[i+1];
-	  }
-	  gram+= buffer[ngram-1];
-#pragma omp critical
-	  {
-	    ++wc[gram];
-	  }
-	  ++cnt;
-	}
-      }
+      cnt += counter.add_text( line, lowercase, wc, emps );
     }
     pnt = pnt->next;
   }
@@ -176,7 +246,7 @@ size_t word_xml_inventory( const string& docName,
 			   bool lowercase,
 			   size_t ngram,
 			   const string& sep,
-			   map<string,unsigned int>& wc,
+			   unordered_map<string,unsigned int>& wc,
 			   set<string>& emps ){
   xmlDoc *d = 0;
   int cnt = 0;
@@ -191,7 +261,84 @@ size_t word_xml_inventory( const string& docName,
   }
   xmlNode *root = xmlDocGetRootElement( d );
   size_t wordTotal = tel( root, lowercase, ngram, sep, wc, emps );
-  xmlFree( d );
+  xmlFreeDoc( d );
+  return wordTotal;
+}
+
+size_t word_xml_stream( const string& docName,
+			bool lowercase,
+			size_t ngram,
+			const string& sep,
+			unordered_map<string,unsigned int>& wc,
+			set<string>& emps ){
+  // counts the same as word_xml_inventory(), but reads the document with
+  // an xmlTextReader, so only a small part of it is in memory at any time.
+  // Like in tel(), every open element has its own counter.
+  // A document with errors is not counted at all, so the counts are kept
+  // apart until the end.
+  int cnt = 0;
+  xmlTextReader *reader = xmlReaderForFile( docName.c_str(), 0,
+					    XML_PARSE_NOBLANKS|XML_PARSE_HUGE );
+  if ( !reader ){
+#pragma omp critical
+    {
+      cerr << "failed to load document '" << docName << "'" << endl;
+    }
+    return 0;
+  }
+  xmlTextReaderSetStructuredErrorHandler( reader,
+					  (xmlStructuredErrorFunc)error_sink,
+					  &cnt );
+  unordered_map<string,unsigned int> doc_wc;
+  set<string> doc_emps;
+  vector<word_counter> levels;
+  size_t depth = 0;
+  size_t wordTotal = 0;
+  int result;
+  while ( ( result = xmlTextReaderRead( reader ) ) == 1 && cnt == 0 ){
+    switch ( xmlTextReaderNodeType( reader ) ){
+    case XML_READER_TYPE_ELEMENT:
+      if ( !xmlTextReaderIsEmptyElement( reader ) ){
+	if ( depth == levels.size() ){
+	  levels.push_back( word_counter( ngram, sep ) );
+	}
+	else {
+	  levels[depth].reset();
+	}
+	++depth;
+      }
+      break;
+    case XML_READER_TYPE_END_ELEMENT:
+      --depth;
+      break;
+    case XML_READER_TYPE_TEXT:
+      if ( depth > 0 ){
+	string line = (const char*)xmlTextReaderConstValue( reader );
+	wordTotal += levels[depth-1].add_text( line, lowercase,
+					       doc_wc, doc_emps );
+      }
+      break;
+    case XML_READER_TYPE_ENTITY_REFERENCE:
+      // the DOM has the text of the entity below the reference node
+      wordTotal += tel( xmlTextReaderCurrentNode( reader ), lowercase,
+			ngram, sep, doc_wc, doc_emps );
+      break;
+    default:
+      break;
+    }
+  }
+  xmlFreeTextReader( reader );
+  if ( result != 0 || cnt > 0 ){
+#pragma omp critical
+    {
+      cerr << "failed to load document '" << docName << "'" << endl;
+    }
+    return 0;
+  }
+  for ( const auto& it : doc_wc ){
+    wc[it.first] += it.second;
+  }
+  emps.insert( doc_emps.begin(), doc_emps.end() );
   return wordTotal;
 }
 
@@ -199,62 +346,18 @@ size_t word_inventory( const string& docName,
 		       bool lowercase,
 		       size_t ngram,
 		       const string& sep,
-		       map<string,unsigned int>& wc,
+		       unordered_map<string,unsigned int>& wc,
 		       set<string>& emps,
 		       bool dolines ){
-  vector<string> buffer(ngram);
-  size_t buf_cnt = 0;
+  word_counter counter( ngram, sep );
   size_t wordTotal = 0;
   ifstream is( docName );
   string line;
-  bool in_emph = false;
-  string emph_start;
-  string emph_word;
   while ( getline( is, line ) ){
     if ( dolines ){
-      buffer.clear();
-      buf_cnt = 0;
-    }
-    vector<string> v;
-    TiCC::split( line, v );
-    for ( const auto& word : v ){
-      string wrd = word;
-      if ( lowercase ){
-	wrd = TiCC::utf8_lowercase( word );
-      }
-      if ( is_emph( wrd ) ){
-	if ( in_emph ){
-	  emph_word += "_" + wrd;
-	}
-	else {
-	  emph_start = wrd;
-	  in_emph = true;
-	}
-      }
-      else {
-	if ( in_emph && !emph_word.empty() ){
-	  emps.insert( emph_start + emph_word );
-	}
-	in_emph = false;
-	emph_start.clear();
-	emph_word.clear();
-      }
-      buffer[buf_cnt++] = wrd;
-      if ( buf_cnt == ngram ){
-	buf_cnt = ngram-1;
-	string gram;
-	for( size_t i=0; i < ngram -1; ++i ){
-	  gram += buffer[i] + sep;
-	  buffer[i] = buffer[i+1];
-	}
-	gram += buffer[ngram-1];
-#pragma omp critical
-	{
-	  ++wc[gram];
-	}
-	++wordTotal;
-      }
+      counter.new_line();
     }
+    wordTotal += counter.add_text( line, lowercase, wc, emps );
   }
   return wordTotal;
 }
@@ -282,11 +385,13 @@ void usage( const string& name ){
   cerr << "\t-e\t expr: specify the expression all input files should match with." << endl;
   cerr << "\t-o\t name of the output file(s) prefix." << endl;
   cerr << "\t-X\t the inputfiles are assumed to be XML. (all TEXT nodes are used)" << endl;
+  cerr << "\t--dom\t read every XML file completely in memory before counting," << endl;
+  cerr << "\t\t\t instead of streaming. (needs a lot more memory)" << endl;
   cerr << "\t-R\t search the dirs recursively (when appropriate)." << endl;
 }
 
 int main( int argc, char *argv[] ){
-  CL_Options opts( "hnVvpe:t:o:RX", "clip:,lower,ngram:,underscore,hemp:,threads:" );
+  CL_Options opts( "hnVvpe:t:o:RX", "clip:,lower,ngram:,underscore,hemp:,threads:,dom" );
   try {
     opts.init(argc,argv);
   }
@@ -314,6 +419,7 @@ int main( int argc, char *argv[] ){
   verbose = opts.extract( 'v' );
   bool dolines = opts.extract( 'n' );
   bool doXML = opts.extract( 'X' );
+  bool doDOM = opts.extract( "dom" );
   if ( doXML && dolines ){
     cerr << "options -X and -n conflict!" << endl;
   }
@@ -402,7 +508,7 @@ int main( int argc, char *argv[] ){
   if ( toDo > 1 ){
     cout << "start processing of " << toDo << " files " << endl;
   }
-  map<string,unsigned int> wc;
+  unordered_map<string,unsigned int> wc;
   unsigned int wordTotal =0;
   string sep = " ";
   if ( do_under ){
@@ -410,21 +516,48 @@ int main( int argc, char *argv[] ){
   }
 
   set<string> hemp;
-#pragma omp parallel for shared(fileNames,wordTotal,wc,hemp)
-  for ( size_t fn=0; fn < fileNames.size(); ++fn ){
-    string docName = fileNames[fn];
-    unsigned int word_count =  0;
-    if ( doXML ){
-      word_count = word_xml_inventory( docName, lowercase, ngram, sep, wc, hemp );
-    }
-    else {
-      word_count = word_inventory( docName, lowercase, ngram, sep, wc, hemp, dolines );
+  // every thread counts in its own hash, without locking. These are added
+  // to the totals when the thread is done.
+#pragma omp parallel shared(fileNames,wordTotal,wc,hemp)
+  {
+    unordered_map<string,unsigned int> local_wc;
+    set<string> local_hemp;
+    unsigned int local_total = 0;
+#pragma omp for schedule(dynamic,1)
+    for ( size_t fn=0; fn < fileNames.size(); ++fn ){
+      string docName = fileNames[fn];
+      unsigned int word_count =  0;
+      if ( doXML && doDOM ){
+	word_count = word_xml_inventory( docName, lowercase, ngram, sep,
+					 local_wc, local_hemp );
+      }
+      else if ( doXML ){
+	word_count = word_xml_stream( docName, lowercase, ngram, sep,
+				      local_wc, local_hemp );
+      }
+      else {
+	word_count = word_inventory( docName, lowercase, ngram, sep,
+				     local_wc, local_hemp, dolines );
+      }
+      local_total += word_count;
+#pragma omp critical
+      {
+	cout << "Processed :" << docName << " with " << word_count << " words,"
+	     << " still " << --toDo << " files to go." << endl;
+      }
     }
-    wordTotal += word_count;
 #pragma omp critical
     {
-      cout << "Processed :" << docName << " with " << word_count << " words,"
-	   << " still " << --toDo << " files to go." << endl;
+      if ( wc.empty() ){
+	wc.swap( local_wc );
+      }
+      else {
+	for ( const auto& it : local_wc ){
+	  wc[it.first] += it.second;
+	}
+      }
+      hemp.insert( local_hemp.begin(), local_hemp.end() );
+      wordTotal += local_total;
     }
   }
   if ( toDo > 1 ){
@@ -30,6 +30,8 @@
 #include <string>
 #include <set>
 #include <map>
+#include <unordered_map>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 
@@ -39,14 +41,28 @@
 #include "ticcutils/FileUtils.h"
 #include "ticcutils/Unicode.h"
 #include "ticcl/unicode.h"
+#include "ticcl/charclass.h"
+#include "ticcl/wordfreq.h"
 
 #include "config.h"
+#ifdef HAVE_OPENMP
+#include "omp.h"
+#endif
 
 using namespace	std;
 using namespace icu;
 
 const UnicodeString SEPARATOR = "_";
 
+struct us_hash {
+  size_t operator()( const UnicodeString& us ) const {
+    return us.hashCode();
+  }
+};
+
+// all lexicons are kept in hashes. Only the output is sorted
+typedef unordered_map<UnicodeString,unsigned int,us_hash> freq_table;
+
 bool verbose = false;
 
 enum S_Class { UNDEF, UNK, PUNCT, IGNORE, CLEAN };
@@ -73,7 +89,7 @@ ostream& operator<<( ostream& os, const S_Class& cl ){
   return os;
 }
 
-bool fillAlpha( istream& is, set<UChar>& alphabet ){
+bool fillAlpha( istream& is, char_table& alphabet ){
   int l_cnt = 0;
   int u_cnt = 0;
   int s_cnt = 0;
@@ -90,13 +106,13 @@ bool fillAlpha( istream& is, set<UChar>& alphabet ){
     }
     UnicodeString us = TiCC::UnicodeFromUTF8( v[0] );
     us.toLower();
-    if ( alphabet.find( us[0] ) == alphabet.end() ){
-      alphabet.insert( us[0] );
+    if ( !alphabet.in_alphabet( us[0] ) ){
+      alphabet.add( us[0] );
       ++l_cnt;
     }
     us.toUpper();
-    if ( alphabet.find( us[0] ) == alphabet.end() ){
-      alphabet.insert( us[0] );
+    if ( !alphabet.in_alphabet( us[0] ) ){
+      alphabet.add( us[0] );
       ++u_cnt;
     }
     else {
@@ -177,13 +193,21 @@ bool depunct( const UnicodeString& us, UnicodeString& result ){
 static TiCC::UniFilter filter;
 
 bool normalize_weird( const UnicodeString& in, UnicodeString& result ){
-  result = filter.filter( in );
+  // an ICU transliterator may not be shared between threads, so every
+  // thread builds its own filter, from the rules of 'filter'
+  static thread_local TiCC::UniFilter thread_filter;
+  static thread_local bool initialized = false;
+  if ( !initialized ){
+    thread_filter.init( filter.get_rules(), "thread_filter" );
+    initialized = true;
+  }
+  result = thread_filter.filter( in );
   return result != in;
 }
 
 bool is_roman( const UnicodeString& word ){
   static UnicodeString pattern = "^M{0,4}(CM|CD|D?C{0,3})(XC|XL|L?X{0,3})(IX|IV|V?I{0,3})$";
-  static TiCC::UnicodeRegexMatcher roman_detect( pattern, "roman" );
+  static thread_local TiCC::UnicodeRegexMatcher roman_detect( pattern, "roman" );
   UnicodeString pre, post;
   bool debug = false; //(word == "IX");
   if ( debug ){
@@ -209,7 +233,7 @@ bool is_roman( const UnicodeString& word ){
 }
 
 S_Class classify( const UnicodeString& word,
-		  const set<UChar>& alphabet ){
+		  const char_table& alphabet ){
   int is_digit = 0;
   int is_punct = 0;
   int is_letter = 0;
@@ -230,25 +254,25 @@ S_Class classify( const UnicodeString& word,
   }
   for ( int i=0; i < word_len; ++i ){
     UChar uchar = word[i];
-    if ( u_isspace( uchar ) ){
+    if ( alphabet.is( uchar, CC_SPACE ) ){
       ++is_space; // ignored atm
     }
     else {
-      int8_t charT = u_charType( uchar );
-      if ( alphabet.empty() ){
+      int8_t charT = alphabet.type( uchar );
+      if ( alphabet.alphabet_size() == 0 ){
 	if ( verbose ){
 	  cerr << "bekijk karakter " << UnicodeString(uchar) << " van type " << toString(charT) << endl;
 	}
-	if ( ticc_isletter( charT ) ){
+	if ( alphabet.is( uchar, CC_LETTER ) ){
 	  ++is_letter;
 	}
-	else if ( ticc_isdigit( charT ) ){
+	else if ( alphabet.is( uchar, CC_DIGIT ) ){
 	  ++is_digit;
 	}
-	else if ( ticc_ispunct( charT ) ){
+	else if ( alphabet.is( uchar, CC_PUNCT ) ){
 	  ++is_punct;
 	}
-	else if ( ticc_isother( charT ) ){
+	else if ( alphabet.is( uchar, CC_OTHER ) ){
 	  ++is_out;
 	  // OUT
 	}
@@ -263,13 +287,13 @@ S_Class classify( const UnicodeString& word,
 	if ( verbose ){
 	  cerr << "bekijk karakter " << UnicodeString(uchar) << " van type " << toString(charT) << endl;
 	}
-	if ( alphabet.find( uchar ) != alphabet.end() ) {
+	if ( alphabet.in_alphabet( uchar ) ){
 	  if ( verbose ){
 	    cerr << "'" << UnicodeString(uchar) << "' is IN het alfabet" << endl;
 	  }
 	  ++is_letter;
 	}
-	else if ( charT == U_DECIMAL_DIGIT_NUMBER ){
+	else if ( alphabet.is( uchar, CC_DIGIT ) ){
 	  if ( verbose ){
 	    cerr << "'" << UnicodeString(uchar) << "' is DIGIT" << endl;
 	  }
@@ -359,7 +383,7 @@ S_Class classify( const UnicodeString& word,
 }
 
 S_Class classify( const UnicodeString& us,
-		  const set<UChar>& alphabet,
+		  const char_table& alphabet,
 		  UnicodeString& punct ){
   S_Class result = CLEAN;
   punct.remove();
@@ -414,7 +438,7 @@ bool isAcro( const vector<UnicodeString>& parts,
 	     set<UnicodeString>& result ){
   static UnicodeString pattern =  "(?:de|het|een)" + SEPARATOR
     + "(\\p{Lu}+)-{0,1}(?:\\p{L}*)";
-  static TiCC::UnicodeRegexMatcher acro_detect( pattern, "acro_detector" );
+  static thread_local TiCC::UnicodeRegexMatcher acro_detect( pattern, "acro_detector" );
   result.clear();
   for ( size_t i = 0; i < parts.size() -1; ++i ){
     UnicodeString us = parts[i] + SEPARATOR + parts[i+1];
@@ -434,7 +458,7 @@ bool isAcro( const vector<UnicodeString>& parts,
 
 bool isAcro( const UnicodeString& word ){
   static UnicodeString pattern2 = "^(\\p{Lu}{1,2}\\.{1,2}(\\p{Lu}{1,2}\\.{1,2})*)(\\p{Lu}{0,2})$";
-  static TiCC::UnicodeRegexMatcher acro_detect2( pattern2, "dot_alter" );
+  static thread_local TiCC::UnicodeRegexMatcher acro_detect2( pattern2, "dot_alter" );
   UnicodeString pre, post;
   // acro_detect2.set_debug(1);
   // cerr << "IS ACRO: test pattern = " << acro_detect2.Pattern() << endl;
@@ -455,8 +479,8 @@ UnicodeString filter_punct( const UnicodeString& us ){
 S_Class classify_n_gram( const vector<UnicodeString>& parts,
 			 UnicodeString& end_pun,
 			 unsigned int& lexclean,
-			 const map<UnicodeString,unsigned int>& decap_clean_words,
-			 const set<UChar>& alphabet ){
+			 const freq_table& decap_clean_words,
+			 const char_table& alphabet ){
   if ( verbose ){
     cerr << "classify a " << parts.size() << "-gram" << endl;
   }
@@ -587,16 +611,74 @@ S_Class classify_n_gram( const vector<UnicodeString>& parts,
   return end_cl;
 }
 
+struct clean_freq {
+  // the frequency of a clean word. Within a chunk of the lexicon, also the
+  // frequency at the first entry that was lexically clean is kept: that
+  // is where the sequential run decides on adding 'artifreq'.
+  clean_freq(): freq(0), bonus_at(0), bonus(false){};
+  unsigned int freq;
+  unsigned int bonus_at;
+  bool bonus;
+};
+
+class unk_tables {
+  // the results of classifying (a chunk of) the foreground lexicon.
+  // The chunks are classified in parallel, each in its own tables, and
+  // merged afterwards in the order of the lexicon, so the results are the
+  // same as when classifying the whole lexicon in one go.
+public:
+  void add_clean( const UnicodeString&, unsigned int, bool );
+  void merge( const unk_tables&, size_t );
+  unordered_map<UnicodeString,clean_freq,us_hash> clean_words;
+  freq_table unk_words;
+  unordered_map<UnicodeString,UnicodeString,us_hash> punct_words;
+  freq_table punct_acro_words;
+  freq_table compound_acro_words;
+};
+
+void unk_tables::add_clean( const UnicodeString& word,
+			    unsigned int freq,
+			    bool lexclean ){
+  clean_freq& cf = clean_words[word];
+  cf.freq += freq;
+  if ( lexclean && !cf.bonus ){
+    cf.bonus_at = cf.freq;
+    cf.bonus = true;
+  }
+}
+
+void unk_tables::merge( const unk_tables& part, size_t artifreq ){
+  // add the results of the next chunk. A word gets 'artifreq' added once,
+  // when at its first lexically clean entry the running total was still
+  // below 'artifreq'.
+  for ( const auto& it : part.clean_words ){
+    clean_freq& cf = clean_words[it.first];
+    if ( it.second.bonus
+	 && cf.freq + it.second.bonus_at < artifreq ){
+      cf.freq += artifreq;
+    }
+    cf.freq += it.second.freq;
+  }
+  for ( const auto& it : part.unk_words ){
+    unk_words[it.first] += it.second;
+  }
+  for ( const auto& it : part.punct_words ){
+    // the last one wins, as it would sequentially
+    punct_words[it.first] = it.second;
+  }
+  for ( const auto& it : part.punct_acro_words ){
+    punct_acro_words[it.first] += it.second;
+  }
+  for ( const auto& it : part.compound_acro_words ){
+    compound_acro_words[it.first] += it.second;
+  }
+}
+
 void classify_one_entry( const UnicodeString& orig_word, unsigned int freq,
-			 map<UnicodeString,unsigned int>& clean_words,
-			 const map<UnicodeString,unsigned int>& decap_clean_words,
-			 map<UnicodeString,unsigned int>& unk_words,
-			 map<UnicodeString,UnicodeString>& punct_words,
-			 map<UnicodeString,unsigned int>& punct_acro_words,
-			 map<UnicodeString,unsigned int>& compound_acro_words,
+			 unk_tables& tables,
+			 const freq_table& decap_clean_words,
 			 bool doAcro,
-			 const set<UChar>& alphabet,
-			 size_t artifreq ){
+			 const char_table& alphabet ){
   UnicodeString word;
   bool normalized = normalize_weird( orig_word, word );
   if ( verbose ){
@@ -640,27 +722,23 @@ void classify_one_entry( const UnicodeString& orig_word, unsigned int freq,
     break;
   case CLEAN:
     {
-      clean_words[word] += freq;
-      if ( clean_words[word] < artifreq
-	   && lexclean == parts.size() ){
-	clean_words[word] += artifreq;
-      }
+      tables.add_clean( word, freq, lexclean == parts.size() );
       if ( normalized ){
-	punct_words[orig_word] = word;
+	tables.punct_words[orig_word] = word;
       }
       set<UnicodeString> acros;
       if ( doAcro && isAcro( word ) ){
 	if ( verbose ){
 	  cerr << "CLEAN ACRO: " << word << endl;
 	}
-	punct_acro_words[word] += freq;
+	tables.punct_acro_words[word] += freq;
       }
       else if ( doAcro && isAcro( parts, acros ) ){
 	for ( const auto& acro : acros ){
 	  if ( verbose ){
 	    cerr << "CLEAN ACRO: (regex)" << word << "/" << acro << endl;
 	  }
-	  compound_acro_words[acro] += freq;
+	  tables.compound_acro_words[acro] += freq;
 	}
       }
       else if ( verbose ){
@@ -675,22 +753,22 @@ void classify_one_entry( const UnicodeString& orig_word, unsigned int freq,
 	if ( verbose ){
 	  cerr << "UNK ACRO: " << word << endl;
 	}
-	clean_words[word] += freq;
-	punct_acro_words[word] += freq;
+	tables.add_clean( word, freq, false );
+	tables.punct_acro_words[word] += freq;
       }
       else if ( doAcro && isAcro( parts, acros ) ){
 	for ( const auto& acro : acros ){
 	  if ( verbose ){
 	    cerr << "UNK ACRO: " << word << "/" << acro << endl;
 	  }
-	  compound_acro_words[acro] += freq;
+	  tables.compound_acro_words[acro] += freq;
 	}
       }
       else {
 	if ( verbose ){
 	  cerr << "UNK word: " << orig_word << endl;
 	}
-	unk_words[orig_word] += freq;
+	tables.unk_words[orig_word] += freq;
       }
     }
     break;
@@ -701,28 +779,24 @@ void classify_one_entry( const UnicodeString& orig_word, unsigned int freq,
 	if ( verbose ){
 	  cerr << "PUNCT ACRO: " << end_pun << endl;
 	}
-	punct_acro_words[end_pun] += freq;
-	punct_words[end_pun] = word;
-	clean_words[word] += freq;
+	tables.punct_acro_words[end_pun] += freq;
+	tables.punct_words[end_pun] = word;
+	tables.add_clean( word, freq, false );
       }
       else if ( doAcro && isAcro( parts, acros ) ){
 	for ( const auto& acro : acros ){
 	  if ( verbose ){
 	    cerr << "PUNCT ACRO: (regex) " << word << "/" << acro << endl;
 	  }
-	  compound_acro_words[acro] += freq;
+	  tables.compound_acro_words[acro] += freq;
 	}
       }
       else {
 	if ( verbose ){
 	  cerr << "PUNCT word: " << word << " depunct to: " << end_pun << endl;
 	}
-	clean_words[end_pun] += freq;
-	if ( clean_words[end_pun] < artifreq
-	     && lexclean == parts.size() ){
-	  clean_words[end_pun] += artifreq;
-	}
-	punct_words[orig_word] = end_pun;
+	tables.add_clean( end_pun, freq, lexclean == parts.size() );
+	tables.punct_words[orig_word] = end_pun;
       }
     }
     break;
@@ -731,6 +805,20 @@ void classify_one_entry( const UnicodeString& orig_word, unsigned int freq,
   }
 }
 
+typedef pair<const UnicodeString*,unsigned int> word_freq;
+
+void write_freq_sorted( ostream& os, vector<word_freq>& wf ){
+  sort_on_freq( wf );
+  for ( const auto& it : wf ){
+    os << *it.first << "\t" << it.second << endl;
+  }
+}
+
+void write_freq_sorted( ostream& os, const freq_table& table ){
+  for ( const auto& it : sorted_on_freq( table ) ){
+    os << *it.first << "\t" << it.second << endl;
+  }
+}
 
 UnicodeString default_filter = "æ >ae;"
   "Æ } [:Uppercase Letter:]* > AE;"
@@ -773,6 +861,9 @@ void usage( const string& name ){
   cerr << "\t\t see http://userguide.icu-project.org/transforms/general/rules for information about rules." << endl;
   cerr << "\t\t default the following filter is used: " << endl
        << default_filter << endl;
+  cerr << "\t-t <threads>\n\t--threads <threads> Number of threads to run on." << endl;
+  cerr << "\t\t\t If 'threads' has the value \"max\", the number of threads is set to a" << endl;
+  cerr << "\t\t\t reasonable value. (OMP_NUM_TREADS - 2)" << endl;
   cerr << "\t-h\t this message " << endl;
   cerr << "\t-v\t be verbose " << endl;
   cerr << "\t-V\t show version " << endl;
@@ -781,8 +872,8 @@ void usage( const string& name ){
 int main( int argc, char *argv[] ){
   TiCC::CL_Options opts;
   try {
-    opts.set_short_options( "vVho:" );
-    opts.set_long_options( "acro,alph:,corpus:,background:,artifrq:,filter:,help,version" );
+    opts.set_short_options( "vVho:t:" );
+    opts.set_long_options( "acro,alph:,corpus:,background:,artifrq:,filter:,help,version,threads:" );
     opts.parse_args( argc, argv );
   }
   catch( TiCC::OptionError& e ){
@@ -823,6 +914,33 @@ int main( int argc, char *argv[] ){
       exit( EXIT_FAILURE );
     }
   }
+  value = "1";
+  if ( !opts.extract( 't', value ) ){
+    opts.extract( "threads", value );
+  }
+  int numThreads=1;
+#ifdef HAVE_OPENMP
+  if ( TiCC::lowercase(value) == "max" ){
+    numThreads = omp_get_max_threads() - 2;
+  }
+  else {
+    if ( !TiCC::stringTo(value,numThreads) ) {
+      cerr << "illegal value for -t (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+  if ( numThreads < 1 ){
+    numThreads = 1;
+  }
+  omp_set_num_threads( numThreads );
+  cout << "running on " << numThreads << " threads." << endl;
+#else
+  if ( value != "1" ){
+    cerr << "unable to set number of threads!.\nNo OpenMP support available!"
+	 <<endl;
+    exit(EXIT_FAILURE);
+  }
+#endif
   string output_name;
   opts.extract( 'o', output_name );
   string filter_file_name;
@@ -893,7 +1011,7 @@ int main( int argc, char *argv[] ){
     }
   }
 
-  set<UChar> alphabet;
+  char_table alphabet;
 
   if ( !alphafile.empty() ){
     ifstream as( alphafile );
@@ -908,14 +1026,9 @@ int main( int argc, char *argv[] ){
     }
   }
 
-  map<UnicodeString,unsigned int> all_clean_words;
-  map<UnicodeString,unsigned int> fore_clean_words;
-  map<UnicodeString,unsigned int> decap_clean_words;
-  map<UnicodeString,unsigned int> unk_words;
-  map<UnicodeString,unsigned int> punct_acro_words;
-  map<UnicodeString,unsigned int> compound_acro_words;
-  map<UnicodeString,UnicodeString> punct_words;
-  map<UnicodeString,unsigned int> back_lexicon;
+  freq_table all_clean_words;
+  freq_table decap_clean_words;
+  freq_table back_lexicon;
   if ( !background_file.empty() ){
     if ( artifreq == 0 ){
       cerr << "a background file is specified (--background option), but artifreq is NOT set "
@@ -968,7 +1081,7 @@ int main( int argc, char *argv[] ){
   string line;
   size_t line_cnt = 0 ;
   size_t err_cnt = 0;
-  map<UnicodeString,unsigned> fore_lexicon;
+  freq_table fore_lexicon;
   while ( getline( is, line ) ){
     ++line_cnt;
     line = TiCC::trim( line );
@@ -998,20 +1111,34 @@ int main( int argc, char *argv[] ){
   }
   cout << "start classifying the foreground lexicon with "
        << fore_lexicon.size() << " entries"<< endl;
-  for ( const auto& wf : fore_lexicon ){
-    classify_one_entry( wf.first, wf.second,
-			fore_clean_words, decap_clean_words,
-			unk_words, punct_words,
-			punct_acro_words, compound_acro_words,
-			doAcro, alphabet, artifreq );
+  // the entries are classified in alphabetical order, as the results
+  // depend on the order
+  vector<const freq_table::value_type*> entries = sorted_on_word( fore_lexicon );
+  // a few chunks per thread, to even out the load
+  size_t chunks = 4 * numThreads;
+  size_t chunk_size = entries.size() / chunks + 1;
+  vector<unk_tables> parts( chunks );
+#pragma omp parallel for schedule(dynamic,1)
+  for ( size_t c=0; c < chunks; ++c ){
+    size_t end = min( entries.size(), (c+1) * chunk_size );
+    for ( size_t i=c*chunk_size; i < end; ++i ){
+      classify_one_entry( entries[i]->first, entries[i]->second,
+			  parts[c], decap_clean_words, doAcro, alphabet );
+    }
+  }
+  unk_tables fore;
+  for ( auto& part : parts ){
+    fore.merge( part, artifreq );
+    part = unk_tables();
   }
   cout << "generating output files" << endl;
   cout << "using artifrq=" << artifreq << endl;
   if ( !background_file.empty() ){
     ofstream fcs( fore_clean_file_name );
-    map<unsigned int, set<UnicodeString> > wf;
-    for ( const auto& it : fore_clean_words ){
-      unsigned int freq = it.second;
+    vector<word_freq> wf;
+    wf.reserve( fore.clean_words.size() );
+    for ( const auto& it : fore.clean_words ){
+      unsigned int freq = it.second.freq;
       auto back_it = back_lexicon.find( it.first );
       if ( back_it != back_lexicon.end() ){
 	// add background frequency to the foreground
@@ -1020,72 +1147,42 @@ int main( int argc, char *argv[] ){
       if ( freq > artifreq && (freq -  artifreq) > artifreq ){
       	freq -= artifreq;
       }
-      wf[freq].insert( it.first );
-    }
-    auto wit = wf.rbegin();
-    while ( wit != wf.rend() ){
-      for ( const auto& sit : wit->second ){
-	fcs << sit << "\t" << wit->first << endl;
-      }
-      ++wit;
+      wf.push_back( make_pair( &it.first, freq ) );
     }
+    write_freq_sorted( fcs, wf );
     cout << "created separate " << fore_clean_file_name << endl;
-    for ( const auto& it : fore_clean_words ){
+    for ( const auto& it : fore.clean_words ){
       unsigned int f1 = all_clean_words[it.first];
-      unsigned int freq = it.second;
+      unsigned int freq = it.second.freq;
       if ( freq > artifreq && f1 >= artifreq ){
 	freq -= artifreq;
       }
       all_clean_words[it.first] += freq;
     }
-    wf.clear();
-    for ( const auto& it : all_clean_words ){
-      wf[it.second].insert( it.first );
-    }
-    wit = wf.rbegin();
-    while ( wit != wf.rend() ){
-      for ( const auto& sit : wit->second ){
-	acs << sit << "\t" << wit->first << endl;
-      }
-      ++wit;
-    }
+    write_freq_sorted( acs, all_clean_words );
     cout << "created " << all_clean_file_name << endl;
   }
   else {
-    map<unsigned int, set<UnicodeString> > wf;
-    for ( const auto& it : fore_clean_words ){
-      wf[it.second].insert( it.first );
-    }
-    map<unsigned int, set<UnicodeString> >::const_reverse_iterator wit = wf.rbegin();
-    while ( wit != wf.rend() ){
-      for ( const auto& sit : wit->second ){
-	acs << sit << "\t" << wit->first << endl;
-      }
-      ++wit;
+    vector<word_freq> wf;
+    wf.reserve( fore.clean_words.size() );
+    for ( const auto& it : fore.clean_words ){
+      wf.push_back( make_pair( &it.first, it.second.freq ) );
     }
+    write_freq_sorted( acs, wf );
     cout << "created " << all_clean_file_name << endl;
   }
-  map<unsigned int, set<UnicodeString> > wf;
-  for ( const auto& uit : unk_words ){
-    wf[uit.second].insert( uit.first );
-  }
-  auto wit = wf.rbegin();
-  while ( wit != wf.rend() ){
-    for ( const auto& sit : wit->second ){
-      us << sit << "\t" << wit->first << endl;
-    }
-    ++wit;
-  }
+  write_freq_sorted( us, fore.unk_words );
   cout << "created " << unk_file_name << endl;
 
   if ( doAcro ){
-    for ( const auto& ait : punct_acro_words ){
+    for ( const auto& ait : fore.punct_acro_words ){
       UnicodeString ps = ait.first;
       UnicodeString us = filter_punct( ps );
-      if ( compound_acro_words.find( us ) != compound_acro_words.end() ){
+      if ( fore.compound_acro_words.find( us )
+	   != fore.compound_acro_words.end() ){
 	// the 'dotted' word is a true acronym
 	// add to the list
-	compound_acro_words[ps] += ait.second;
+	fore.compound_acro_words[ps] += ait.second;
       }
       else {
 	// mishit: add to the punct file??
@@ -1094,13 +1191,13 @@ int main( int argc, char *argv[] ){
       }
     }
     ofstream as( acro_file_name );
-    for ( const auto& ait : compound_acro_words ){
-      as << ait.first << "\t" << ait.second << endl;
+    for ( const auto& ait : sorted_on_word( fore.compound_acro_words ) ){
+      as << ait->first << "\t" << ait->second << endl;
     }
     cout << "created " << acro_file_name << endl;
   }
-  for ( const auto pit : punct_words ){
-    ps << pit.first << "\t" << pit.second << endl;
+  for ( const auto& pit : sorted_on_word( fore.punct_words ) ){
+    ps << pit->first << "\t" << pit->second << endl;
   }
   cout << "created " << punct_file_name << endl;
   cout << "done!" << endl;
@@ -9,11 +9,17 @@ using namespace std;
 using namespace TiCC;
 
 void usage( const string& name ){
-  cerr << name << " --vectors=vectorfile [FILES]" << endl;
+  cerr << name << " --vectors=vectorfile [--cache=cachefile] [--ann=indexfile [--ef=search]] [FILES]" << endl;
+  cerr << "\t--cache=cachefile\tread the vectors from the (mmap-ed) 'cachefile'.\n"
+       << "\t\tIt is created from 'vectorfile' when not present yet." << endl;
+  cerr << "\t--ann=indexfile\tuse an approximate nearest neighbour index,\n"
+       << "\t\tstored in 'indexfile'. It is created when not present yet." << endl;
+  cerr << "\t--ef=search\tthe search width for the index. (default 100)\n"
+       << "\t\tlarger is more accurate, but slower." << endl;
 }
 
 int main( int argc, char *argv[] ){
-  CL_Options opts( "hn:", "vectors:" );
+  CL_Options opts( "hn:", "vectors:,cache:,ann:,ef:" );
   try {
     opts.init(argc,argv);
   }
@@ -31,11 +37,19 @@ int main( int argc, char *argv[] ){
     cerr << "missing '--vectors' option" << endl;
     exit( EXIT_FAILURE );
   }
+  string cacheFile;
+  opts.extract( "cache", cacheFile );
   int NN = 40;
   string value;
   if ( opts.extract( 'n', value ) ){
     NN = stringTo<int>(value);
   }
+  string annFile;
+  opts.extract( "ann", annFile );
+  size_t ann_ef = 100;
+  if ( opts.extract( "ef", value ) ){
+    ann_ef = stringTo<size_t>(value);
+  }
   auto fileNames = opts.getMassOpts();
   if ( fileNames.empty() ){
     cerr << "missing input file(s)" << endl;
@@ -46,12 +60,27 @@ int main( int argc, char *argv[] ){
     exit( EXIT_FAILURE );
   }
   wordvec_tester WV;
-  if ( !WV.fill( vectorsFile ) ){
+  bool filled;
+  if ( cacheFile.empty() ){
+    filled = WV.fill( vectorsFile );
+  }
+  else {
+    filled = WV.use_cache( vectorsFile, cacheFile );
+  }
+  if ( !filled ){
     cerr << "fill failed from " << vectorsFile << endl;
     exit(EXIT_FAILURE);
   }
   else
     cerr << "filled with " << WV.size() << " vectors" << endl;
+  if ( !annFile.empty() ){
+    if ( !WV.use_index( annFile ) ){
+      cerr << "unable to use index file " << annFile << endl;
+      exit(EXIT_FAILURE);
+    }
+    WV.set_search_ef( ann_ef );
+    cerr << "using index " << annFile << endl;
+  }
   for ( auto const& name : fileNames ){
     ifstream is( name );
     if ( !is ){
@@ -0,0 +1,228 @@
+/*
+  Copyright (c) 2006 - 2018
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of ticcltools
+
+  ticcltools is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  ticcltools is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcltools/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+// benchmark: compare the lookups using the approximate nearest neighbour
+// index of wordvec_tester with the exact search over all the vectors.
+// reports the latencies and the recall of the index.
+// Not installed, build with 'make W2V-annbench'
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <set>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include "ticcutils/CommandLine.h"
+#include "ticcutils/StringOps.h"
+#include "ticcl/word2vec.h"
+
+using namespace std;
+using namespace TiCC;
+
+void usage( const string& name ){
+  cerr << "usage: " << name << " [options] --vectors=<vectorfile> queryfile"
+       << endl;
+  cerr << "\t'queryfile'\t contains one search term per line." << endl;
+  cerr << "\t-n <k>\t\t search the 'k' nearest neighbours. (default 20)"
+       << endl;
+  cerr << "\t--M=<m>\t\t the number of links per node in the index. (default 16)"
+       << endl;
+  cerr << "\t--efc=<ef>\t the search width while building. (default 200)"
+       << endl;
+  cerr << "\t--ef=<list>\t the search widths to test, separated by commas."
+       << endl;
+  cerr << "\t\t\t (default 20,50,100,200)" << endl;
+  cerr << "\t--ann=<file>\t load the index from 'file' when present, otherwise"
+       << endl;
+  cerr << "\t\t\t build it and save it there." << endl;
+  cerr << "\t-h or --help\t this message " << endl;
+}
+
+typedef chrono::steady_clock bench_clock;
+
+double elapsed( const bench_clock::time_point& start ){
+  return chrono::duration<double>( bench_clock::now() - start ).count();
+}
+
+void run( const wordvec_tester& WV,
+	  const vector<string>& queries,
+	  size_t k,
+	  vector<vector<word_dist>>& results,
+	  double& secs ){
+  results.resize( queries.size() );
+  auto start = bench_clock::now();
+  for ( size_t i=0; i < queries.size(); ++i ){
+    WV.lookup( queries[i], k, results[i] );
+  }
+  secs = elapsed( start );
+}
+
+double recall( const vector<vector<word_dist>>& exact,
+	       const vector<vector<word_dist>>& approx ){
+  size_t wanted = 0;
+  size_t found = 0;
+  for ( size_t i=0; i < exact.size(); ++i ){
+    set<string> truth;
+    for ( const auto& wd : exact[i] ){
+      if ( !wd.w.empty() ){
+	truth.insert( wd.w );
+      }
+    }
+    wanted += truth.size();
+    for ( const auto& wd : approx[i] ){
+      if ( truth.find( wd.w ) != truth.end() ){
+	++found;
+      }
+    }
+  }
+  return wanted > 0 ? double(found) / wanted : 1.0;
+}
+
+void report( const string& label, size_t queries, double secs ){
+  cout << label << "\t" << secs << " s\t"
+       << ( queries > 0 ? 1000.0 * secs / queries : 0 ) << " ms/query";
+}
+
+int main( int argc, char **argv ){
+  CL_Options opts( "hn:", "help,vectors:,M:,efc:,ef:,ann:" );
+  try {
+    opts.init(argc,argv);
+  }
+  catch( OptionError& e ){
+    cerr << e.what() << endl;
+    usage( opts.prog_name() );
+    exit( EXIT_FAILURE );
+  }
+  if ( opts.extract('h') || opts.extract("help") ){
+    usage( opts.prog_name() );
+    exit( EXIT_SUCCESS );
+  }
+  string vectorsFile;
+  if ( !opts.extract( "vectors", vectorsFile ) ){
+    cerr << "missing --vectors option" << endl;
+    usage( opts.prog_name() );
+    exit( EXIT_FAILURE );
+  }
+  string value;
+  size_t k = 20;
+  if ( opts.extract( 'n', value ) ){
+    if ( !stringTo( value, k ) ){
+      cerr << "illegal value for -n (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+  size_t M = 16;
+  if ( opts.extract( "M", value ) ){
+    if ( !stringTo( value, M ) || M < 2 ){
+      cerr << "illegal value for --M (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+  size_t efc = 200;
+  if ( opts.extract( "efc", value ) ){
+    if ( !stringTo( value, efc ) ){
+      cerr << "illegal value for --efc (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+  vector<size_t> efs = { 20, 50, 100, 200 };
+  if ( opts.extract( "ef", value ) ){
+    efs.clear();
+    for ( const auto& v : split_at( value, "," ) ){
+      size_t ef;
+      if ( !stringTo( v, ef ) ){
+	cerr << "illegal value for --ef (" << value << ")" << endl;
+	exit( EXIT_FAILURE );
+      }
+      efs.push_back( ef );
+    }
+  }
+  string annFile;
+  opts.extract( "ann", annFile );
+  vector<string> names = opts.getMassOpts();
+  if ( names.size() != 1 ){
+    cerr << "expected exactly one query file" << endl;
+    usage( opts.prog_name() );
+    exit( EXIT_FAILURE );
+  }
+  if ( !opts.empty() ){
+    cerr << "unsupported options : " << opts.toString() << endl;
+    usage( opts.prog_name() );
+    exit( EXIT_FAILURE );
+  }
+  wordvec_tester WV;
+  auto start = bench_clock::now();
+  if ( !WV.fill( vectorsFile ) ){
+    cerr << "fill failed from " << vectorsFile << endl;
+    exit( EXIT_FAILURE );
+  }
+  cout << "loaded " << WV.size() << " vectors of dimension "
+       << WV.dimension() << " in " << elapsed( start ) << " s" << endl;
+  ifstream is( names[0] );
+  if ( !is ){
+    cerr << "problem opening query file: " << names[0] << endl;
+    exit( EXIT_FAILURE );
+  }
+  vector<string> queries;
+  string line;
+  while ( getline( is, line ) ){
+    if ( !line.empty() ){
+      queries.push_back( line );
+    }
+  }
+  cout << "searching the " << k << " nearest neighbours of "
+       << queries.size() << " queries" << endl;
+
+  vector<vector<word_dist>> exact;
+  double secs;
+  run( WV, queries, k, exact, secs );
+  report( "exact", queries.size(), secs );
+  cout << endl;
+
+  start = bench_clock::now();
+  if ( annFile.empty() ){
+    WV.build_index( M, efc );
+    cout << "building the index took " << elapsed( start ) << " s" << endl;
+  }
+  else {
+    if ( !WV.use_index( annFile ) ){
+      cerr << "unable to use index file " << annFile << endl;
+      exit( EXIT_FAILURE );
+    }
+    cout << "loading/building the index took " << elapsed( start ) << " s"
+	 << endl;
+  }
+  for ( const auto& ef : efs ){
+    WV.set_search_ef( ef );
+    vector<vector<word_dist>> approx;
+    run( WV, queries, k, approx, secs );
+    report( "ef=" + toString( ef ), queries.size(), secs );
+    cout << "\trecall@" << k << "=" << recall( exact, approx ) << endl;
+  }
+  exit( EXIT_SUCCESS );
+}
@@ -9,7 +9,9 @@ using namespace std;
 using namespace TiCC;
 
 void usage( const string& name ){
-  cerr << name << " --vectors=vectorfile [FILES]" << endl;
+  cerr << name << " --vectors=vectorfile [--cache=cachefile] [FILES]" << endl;
+  cerr << "\t--cache=cachefile\tread the vectors from the (mmap-ed) 'cachefile'.\n"
+       << "\t\tIt is created from 'vectorfile' when not present yet." << endl;
 }
 
 bool fill( const string& freqsFile, map<string,size_t>& freqs ){
@@ -45,7 +47,7 @@ size_t lookup( const string& s, const map<string,size_t>& frqs ){
 }
 
 int main( int argc, char *argv[] ){
-  CL_Options opts( "h", "vectors:,freqs:" );
+  CL_Options opts( "h", "vectors:,cache:,freqs:" );
   try {
     opts.init(argc,argv);
   }
@@ -63,6 +65,8 @@ int main( int argc, char *argv[] ){
     cerr << "missing '--vectors' option" << endl;
     exit( EXIT_FAILURE );
   }
+  string cacheFile;
+  opts.extract( "cache", cacheFile );
   string freqsFile;
   opts.extract( "freqs", freqsFile );
   auto fileNames = opts.getMassOpts();
@@ -86,7 +90,14 @@ int main( int argc, char *argv[] ){
     }
   }
   wordvec_tester WV;
-  if ( !WV.fill( vectorsFile ) ){
+  bool filled;
+  if ( cacheFile.empty() ){
+    filled = WV.fill( vectorsFile );
+  }
+  else {
+    filled = WV.use_cache( vectorsFile, cacheFile );
+  }
+  if ( !filled ){
     cerr << "fill failed from " << vectorsFile << endl;
     exit(EXIT_FAILURE);
   }
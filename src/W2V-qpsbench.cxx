@@ -0,0 +1,194 @@
+/*
+  Copyright (c) 2006 - 2018
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of ticcltools
+
+  ticcltools is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  ticcltools is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcltools/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+// benchmark: the throughput (queries/sec) of the exact nearest neighbour
+// search of wordvec_tester, for several numbers of threads.
+// 'split' runs the queries one by one, each search divided over the threads.
+// 'queries' runs the queries in parallel, one search per thread.
+// 'batch' looks up all the queries at once, like TICCL-rank does.
+// Not installed, build with 'make W2V-qpsbench'
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include "config.h"
+#ifdef HAVE_OPENMP
+#include "omp.h"
+#endif
+#include "ticcutils/CommandLine.h"
+#include "ticcutils/StringOps.h"
+#include "ticcl/dotproduct.h"
+#include "ticcl/word2vec.h"
+
+using namespace std;
+using namespace TiCC;
+
+void usage( const string& name ){
+  cerr << "usage: " << name << " [options] --vectors=<vectorfile> queryfile"
+       << endl;
+  cerr << "\t'queryfile'\t contains one search term per line." << endl;
+  cerr << "\t-n <k>\t\t search the 'k' nearest neighbours. (default 20)"
+       << endl;
+  cerr << "\t-t <list>\t the numbers of threads to test, separated by commas."
+       << endl;
+  cerr << "\t\t\t (default 1 and the maximum)" << endl;
+  cerr << "\t-h or --help\t this message " << endl;
+}
+
+typedef chrono::steady_clock bench_clock;
+
+double elapsed( const bench_clock::time_point& start ){
+  return chrono::duration<double>( bench_clock::now() - start ).count();
+}
+
+void report( const string& label, size_t threads,
+	     size_t queries, size_t found, double secs ){
+  cout << label << "\tthreads=" << threads << "\t" << secs << " s\t"
+       << ( secs > 0 ? queries / secs : 0 ) << " queries/s"
+       << "\t(" << found << " found)" << endl;
+}
+
+int main( int argc, char **argv ){
+  CL_Options opts( "hn:t:", "help,vectors:" );
+  try {
+    opts.init(argc,argv);
+  }
+  catch( OptionError& e ){
+    cerr << e.what() << endl;
+    usage( opts.prog_name() );
+    exit( EXIT_FAILURE );
+  }
+  if ( opts.extract('h') || opts.extract("help") ){
+    usage( opts.prog_name() );
+    exit( EXIT_SUCCESS );
+  }
+  string vectorsFile;
+  if ( !opts.extract( "vectors", vectorsFile ) ){
+    cerr << "missing --vectors option" << endl;
+    usage( opts.prog_name() );
+    exit( EXIT_FAILURE );
+  }
+  string value;
+  size_t k = 20;
+  if ( opts.extract( 'n', value ) ){
+    if ( !stringTo( value, k ) ){
+      cerr << "illegal value for -n (" << value << ")" << endl;
+      exit( EXIT_FAILURE );
+    }
+  }
+  size_t max_threads = 1;
+#ifdef HAVE_OPENMP
+  max_threads = omp_get_max_threads();
+#endif
+  vector<size_t> thread_counts = { 1 };
+  if ( max_threads > 1 ){
+    thread_counts.push_back( max_threads );
+  }
+  if ( opts.extract( 't', value ) ){
+    thread_counts.clear();
+    for ( const auto& v : split_at( value, "," ) ){
+      size_t t;
+      if ( !stringTo( v, t ) || t < 1 ){
+	cerr << "illegal value for -t (" << value << ")" << endl;
+	exit( EXIT_FAILURE );
+      }
+      thread_counts.push_back( t );
+    }
+  }
+  vector<string> names = opts.getMassOpts();
+  if ( names.size() != 1 ){
+    cerr << "expected exactly one query file" << endl;
+    usage( opts.prog_name() );
+    exit( EXIT_FAILURE );
+  }
+  if ( !opts.empty() ){
+    cerr << "unsupported options : " << opts.toString() << endl;
+    usage( opts.prog_name() );
+    exit( EXIT_FAILURE );
+  }
+  wordvec_tester WV;
+  auto start = bench_clock::now();
+  if ( !WV.fill( vectorsFile ) ){
+    cerr << "fill failed from " << vectorsFile << endl;
+    exit( EXIT_FAILURE );
+  }
+  cout << "loaded " << WV.size() << " vectors of dimension "
+       << WV.dimension() << " in " << elapsed( start ) << " s" << endl;
+  cout << "dot product kernel: " << dot_product_kernel() << endl;
+  ifstream is( names[0] );
+  if ( !is ){
+    cerr << "problem opening query file: " << names[0] << endl;
+    exit( EXIT_FAILURE );
+  }
+  vector<string> queries;
+  string line;
+  while ( getline( is, line ) ){
+    if ( !line.empty() ){
+      queries.push_back( line );
+    }
+  }
+  cout << "searching the " << k << " nearest neighbours of "
+       << queries.size() << " queries" << endl;
+  for ( const auto& threads : thread_counts ){
+#ifdef HAVE_OPENMP
+    omp_set_num_threads( threads );
+#endif
+    size_t found = 0;
+    start = bench_clock::now();
+    for ( const auto& q : queries ){
+      vector<word_dist> result;
+      if ( WV.lookup( q, k, result ) ){
+	++found;
+      }
+    }
+    report( "split", threads, queries.size(), found, elapsed( start ) );
+    found = 0;
+    start = bench_clock::now();
+#pragma omp parallel for schedule(dynamic,1) reduction(+:found)
+    for ( size_t i=0; i < queries.size(); ++i ){
+      vector<word_dist> result;
+      if ( WV.lookup( queries[i], k, result ) ){
+	++found;
+      }
+    }
+    report( "queries", threads, queries.size(), found, elapsed( start ) );
+    found = 0;
+    start = bench_clock::now();
+    vector<vector<word_dist>> results;
+    WV.lookup( queries, k, results );
+    for ( const auto& result : results ){
+      if ( !result.empty() ){
+	++found;
+      }
+    }
+    report( "batch", threads, queries.size(), found, elapsed( start ) );
+  }
+  exit( EXIT_SUCCESS );
+}
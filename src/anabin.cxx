@@ -0,0 +1,178 @@
+/*
+  Copyright (c) 2006 - 2018
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of ticcltools
+
+  ticcltools is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  ticcltools is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcltools/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include "ticcutils/Unicode.h"
+#include "ticcl/anabin.h"
+
+using namespace std;
+using namespace icu;
+
+const char ANABIN_MAGIC[8] = { 'T', 'I', 'C', 'C', 'L', 'A', 'B', '1' };
+
+struct anabin_header {
+  char magic[8];
+  uint64_t num_keys;
+  uint64_t num_words;
+  uint64_t pool_size;
+};
+
+template <typename T>
+void write_array( ostream& os, const vector<T>& vec ){
+  if ( !vec.empty() ){
+    os.write( (const char*)&vec[0], vec.size() * sizeof(T) );
+  }
+}
+
+bool write_anabin( const string& file_name,
+		   const map<unsigned long,set<UnicodeString>>& anagrams ){
+  vector<int64_t> keys;
+  vector<uint64_t> first_word;
+  vector<uint64_t> word_pos;
+  vector<uint64_t> word_len;
+  string pool;
+  map<string,uint64_t> interned;
+  for ( const auto& it : anagrams ){
+    keys.push_back( it.first );
+    first_word.push_back( word_pos.size() );
+    for ( const auto& w : it.second ){
+      string s = TiCC::UnicodeToUTF8( w );
+      auto pos = interned.find( s );
+      if ( pos == interned.end() ){
+	pos = interned.insert( make_pair( s, pool.size() ) ).first;
+	pool += s;
+      }
+      word_pos.push_back( pos->second );
+      word_len.push_back( s.size() );
+    }
+  }
+  first_word.push_back( word_pos.size() );
+  anabin_header header;
+  memcpy( header.magic, ANABIN_MAGIC, sizeof(ANABIN_MAGIC) );
+  header.num_keys = keys.size();
+  header.num_words = word_pos.size();
+  header.pool_size = pool.size();
+  ofstream os( file_name, ios::binary );
+  if ( !os ){
+    return false;
+  }
+  os.write( (const char*)&header, sizeof(header) );
+  write_array( os, keys );
+  write_array( os, first_word );
+  write_array( os, word_pos );
+  write_array( os, word_len );
+  os.write( pool.c_str(), pool.size() );
+  return os.good();
+}
+
+anabin_reader::anabin_reader():
+  mapped(0),
+  mapped_size(0),
+  num_keys(0),
+  keys(0),
+  first_word(0),
+  word_pos(0),
+  word_len(0),
+  pool(0)
+{
+}
+
+anabin_reader::~anabin_reader(){
+  if ( mapped ){
+    munmap( mapped, mapped_size );
+  }
+}
+
+bool anabin_reader::is_anabin( const string& file_name ){
+  ifstream is( file_name, ios::binary );
+  char magic[sizeof(ANABIN_MAGIC)];
+  if ( !is.read( magic, sizeof(magic) ) ){
+    return false;
+  }
+  return memcmp( magic, ANABIN_MAGIC, sizeof(magic) ) == 0;
+}
+
+bool anabin_reader::open( const string& file_name ){
+  int fd = ::open( file_name.c_str(), O_RDONLY );
+  if ( fd < 0 ){
+    cerr << "unable to open " << file_name << endl;
+    return false;
+  }
+  struct stat st;
+  if ( fstat( fd, &st ) != 0
+       || (size_t)st.st_size < sizeof(anabin_header) ){
+    cerr << "invalid anagram hash file: " << file_name << endl;
+    close( fd );
+    return false;
+  }
+  void *data = mmap( 0, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+  close( fd );
+  if ( data == MAP_FAILED ){
+    cerr << "unable to mmap " << file_name << endl;
+    return false;
+  }
+  const anabin_header *header = (const anabin_header*)data;
+  const uint64_t words = header->num_words;
+  const uint64_t needed = sizeof(anabin_header)
+    + 8 * ( header->num_keys * 2 + 1 + words * 2 )
+    + header->pool_size;
+  if ( memcmp( header->magic, ANABIN_MAGIC, sizeof(ANABIN_MAGIC) ) != 0
+       || needed != (uint64_t)st.st_size ){
+    cerr << "invalid anagram hash file: " << file_name << endl;
+    munmap( data, st.st_size );
+    return false;
+  }
+  if ( mapped ){
+    munmap( mapped, mapped_size );
+  }
+  mapped = data;
+  mapped_size = st.st_size;
+  num_keys = header->num_keys;
+  keys = (const int64_t*)(header+1);
+  first_word = (const uint64_t*)(keys + num_keys);
+  word_pos = first_word + num_keys + 1;
+  word_len = word_pos + words;
+  pool = (const char*)(word_len + words);
+  return true;
+}
+
+size_t anabin_reader::find( int64_t key ) const {
+  // returns the index of 'key', or size() when it is not present
+  const int64_t *pos = lower_bound( keys, keys + num_keys, key );
+  if ( pos != keys + num_keys && *pos == key ){
+    return pos - keys;
+  }
+  return num_keys;
+}
@@ -0,0 +1,168 @@
+/*
+  Copyright (c) 2006 - 2018
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of ticcltools
+
+  ticcltools is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  ticcltools is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcltools/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+#include "ticcl/unicode.h"
+#include "ticcl/charclass.h"
+
+using namespace std;
+using namespace icu;
+
+const size_t TABLE_SIZE = 0x10000;
+
+static bool context_free_lower( UChar uc, UChar& low ){
+  // UnicodeString::toLower() works on whole strings. It may map one code
+  // unit to several, and some mappings depend on the surrounding characters
+  // (the Greek final sigma, and the Turkish and Lithuanian rules for the
+  // dotted i). Only when lowercasing 'uc' gives the same single code unit
+  // in every context, we may use the table instead.
+  if ( U16_IS_SURROGATE( uc ) ){
+    return false;
+  }
+  if ( !u_hasBinaryProperty( uc, UCHAR_CHANGES_WHEN_LOWERCASED )
+       && !u_hasBinaryProperty( uc, UCHAR_CASE_IGNORABLE ) ){
+    // the vast majority: never changed, and not part of any context
+    low = uc;
+    return true;
+  }
+  UnicodeString single( uc );
+  single.toLower();
+  if ( single.length() != 1 ){
+    return false;
+  }
+  low = single[0];
+  static const UnicodeString contexts[] = { "A", "I" };
+  for ( const auto& ctx : contexts ){
+    UnicodeString l_ctx = ctx;
+    l_ctx.toLower();
+    UnicodeString before = ctx + UnicodeString( uc );
+    UnicodeString after = UnicodeString( uc ) + ctx;
+    UnicodeString around = ctx + UnicodeString( uc ) + ctx;
+    before.toLower();
+    after.toLower();
+    around.toLower();
+    if ( before != l_ctx + single
+	 || after != single + l_ctx
+	 || around != l_ctx + single + l_ctx ){
+      return false;
+    }
+  }
+  return true;
+}
+
+char_table::char_table():
+  values( TABLE_SIZE, 0 ),
+  lowers( TABLE_SIZE, 0 ),
+  types( TABLE_SIZE, 0 ),
+  bits( TABLE_SIZE, 0 ),
+  alpha_cnt( 0 )
+{
+  for ( size_t i=0; i < TABLE_SIZE; ++i ){
+    UChar uc = (UChar)i;
+    int8_t charT = u_charType( uc );
+    types[i] = charT;
+    unsigned char cls = 0;
+    if ( u_isspace( uc ) ){
+      cls |= CC_SPACE;
+    }
+    if ( ticc_ispunct( charT ) ){
+      cls |= CC_PUNCT;
+    }
+    if ( ticc_isdigit( charT ) ){
+      cls |= CC_DIGIT;
+    }
+    if ( ticc_isletter( charT ) ){
+      cls |= CC_LETTER;
+    }
+    if ( ticc_isother( charT ) ){
+      cls |= CC_OTHER;
+    }
+    UChar low = uc;
+    if ( !context_free_lower( uc, low ) ){
+      cls |= CC_NOCASE;
+      low = uc;
+    }
+    lowers[i] = low;
+    bits[i] = cls;
+  }
+}
+
+void char_table::add( UChar uc, uint64_t value ){
+  // adding a character twice just replaces its value
+  if ( !( bits[uc] & CC_ALPHA ) ){
+    bits[uc] |= CC_ALPHA;
+    ++alpha_cnt;
+  }
+  values[uc] = value;
+}
+
+bool char_table::simple_lower( const UnicodeString& us ) const {
+  // true when lower() on every code unit of 'us' gives the same result
+  // as UnicodeString::toLower()
+  const UChar *buf = us.getBuffer();
+  const int len = us.length();
+  for ( int i=0; i < len; ++i ){
+    if ( bits[buf[i]] & CC_NOCASE ){
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t anagram_hash( const UnicodeString& s, const char_table& alphabet ){
+  static const uint64_t HonderdHash = 100UL*100*100*100*100;
+  static const uint64_t HonderdEenHash = 101UL*101*101*101*101;
+  bool simple = alphabet.simple_lower( s );
+  UnicodeString lowered;
+  if ( !simple ){
+    lowered = s;
+    lowered.toLower();
+  }
+  const UnicodeString& us = simple ? s : lowered;
+  const UChar *buf = us.getBuffer();
+  const int len = us.length();
+  uint64_t result = 0;
+  bool multPunct = false;
+  for ( int i=0; i < len; ++i ){
+    UChar uc = simple ? alphabet.lower( buf[i] ) : buf[i];
+    if ( alphabet.in_alphabet( uc ) ){
+      result += alphabet.value( uc );
+    }
+    else if ( alphabet.is( uc, CC_SPACE ) ){
+      continue;
+    }
+    else if ( alphabet.is( uc, CC_PUNCT ) ){
+      if ( !multPunct ){
+	result += HonderdHash;
+	multPunct = true;
+      }
+    }
+    else {
+      result += HonderdEenHash;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,145 @@
+/*
+  Copyright (c) 2006 - 2018
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of ticcltools
+
+  ticcltools is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  ticcltools is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcltools/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+#include "ticcl/dotproduct.h"
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define TICCL_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+typedef float (*dot_function)( const float *, const float *, size_t );
+
+static float dot_scalar( const float *v1, const float *v2, size_t len ){
+  // four partial sums, so the compiler may still vectorise this a bit
+  float s0 = 0;
+  float s1 = 0;
+  float s2 = 0;
+  float s3 = 0;
+  size_t i = 0;
+  for ( ; i + 4 <= len; i += 4 ){
+    s0 += v1[i] * v2[i];
+    s1 += v1[i+1] * v2[i+1];
+    s2 += v1[i+2] * v2[i+2];
+    s3 += v1[i+3] * v2[i+3];
+  }
+  for ( ; i < len; ++i ){
+    s0 += v1[i] * v2[i];
+  }
+  return ( s0 + s1 ) + ( s2 + s3 );
+}
+
+#ifdef TICCL_X86_KERNELS
+
+__attribute__((target("avx2,fma")))
+static float dot_avx2( const float *v1, const float *v2, size_t len ){
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for ( ; i + 16 <= len; i += 16 ){
+    acc0 = _mm256_fmadd_ps( _mm256_loadu_ps( v1 + i ),
+			    _mm256_loadu_ps( v2 + i ), acc0 );
+    acc1 = _mm256_fmadd_ps( _mm256_loadu_ps( v1 + i + 8 ),
+			    _mm256_loadu_ps( v2 + i + 8 ), acc1 );
+  }
+  for ( ; i + 8 <= len; i += 8 ){
+    acc0 = _mm256_fmadd_ps( _mm256_loadu_ps( v1 + i ),
+			    _mm256_loadu_ps( v2 + i ), acc0 );
+  }
+  acc0 = _mm256_add_ps( acc0, acc1 );
+  __m128 sum = _mm_add_ps( _mm256_castps256_ps128( acc0 ),
+			   _mm256_extractf128_ps( acc0, 1 ) );
+  sum = _mm_add_ps( sum, _mm_movehl_ps( sum, sum ) );
+  sum = _mm_add_ss( sum, _mm_shuffle_ps( sum, sum, 1 ) );
+  float result = _mm_cvtss_f32( sum );
+  for ( ; i < len; ++i ){
+    result += v1[i] * v2[i];
+  }
+  return result;
+}
+
+// _mm512_reduce_add_ps() gives bogus 'uninitialized' warnings with some
+// GCC versions
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+__attribute__((target("avx512f")))
+static float dot_avx512( const float *v1, const float *v2, size_t len ){
+  __m512 acc0 = _mm512_setzero_ps();
+  __m512 acc1 = _mm512_setzero_ps();
+  size_t i = 0;
+  for ( ; i + 32 <= len; i += 32 ){
+    acc0 = _mm512_fmadd_ps( _mm512_loadu_ps( v1 + i ),
+			    _mm512_loadu_ps( v2 + i ), acc0 );
+    acc1 = _mm512_fmadd_ps( _mm512_loadu_ps( v1 + i + 16 ),
+			    _mm512_loadu_ps( v2 + i + 16 ), acc1 );
+  }
+  for ( ; i + 16 <= len; i += 16 ){
+    acc0 = _mm512_fmadd_ps( _mm512_loadu_ps( v1 + i ),
+			    _mm512_loadu_ps( v2 + i ), acc0 );
+  }
+  if ( i < len ){
+    // the last few elements, with a masked load
+    __mmask16 mask = (__mmask16)( ( 1U << ( len - i ) ) - 1 );
+    acc1 = _mm512_fmadd_ps( _mm512_maskz_loadu_ps( mask, v1 + i ),
+			    _mm512_maskz_loadu_ps( mask, v2 + i ), acc1 );
+  }
+  return _mm512_reduce_add_ps( _mm512_add_ps( acc0, acc1 ) );
+}
+#pragma GCC diagnostic pop
+
+#endif // TICCL_X86_KERNELS
+
+struct dot_kernel {
+  dot_function function;
+  const char *name;
+};
+
+static dot_kernel select_kernel(){
+#ifdef TICCL_X86_KERNELS
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx512f" ) ){
+    return { dot_avx512, "avx512" };
+  }
+  if ( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" ) ){
+    return { dot_avx2, "avx2" };
+  }
+#endif
+  return { dot_scalar, "scalar" };
+}
+
+static const dot_kernel& kernel(){
+  static const dot_kernel the_kernel = select_kernel();
+  return the_kernel;
+}
+
+float dot_product( const float *v1, const float *v2, size_t len ){
+  return kernel().function( v1, v2, len );
+}
+
+const char *dot_product_kernel(){
+  return kernel().name;
+}
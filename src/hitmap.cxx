@@ -0,0 +1,122 @@
+/*
+  Copyright (c) 2006 - 2018
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of ticcltools
+
+  ticcltools is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  ticcltools is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcltools/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+#include "config.h"
+
+#if HAVE_ROARING
+
+#include <string>
+#include <utility>
+#include "ticcl/hitmap.h"
+
+using namespace std;
+
+hit_bitmaps::hit_bitmaps( size_t threads ):
+  tables( threads > 0 ? threads : 1 ){
+}
+
+void hit_bitmaps::add( size_t thread,
+		       vector<pair<int64_t,int64_t>>& hits ){
+  // move the (key,value) pairs in 'hits' into the table of 'thread'.
+  // 'hits' is emptied, to give back its memory right away
+  map<int64_t,Roaring64Map>& table = tables[thread];
+  auto it = hits.begin();
+  while ( it != hits.end() ){
+    // the hits mostly come in runs with the same key
+    Roaring64Map& bm = table[it->first];
+    int64_t key = it->first;
+    while ( it != hits.end() && it->first == key ){
+      bm.add( static_cast<uint64_t>( it->second ) );
+      ++it;
+    }
+  }
+  vector<pair<int64_t,int64_t>>().swap( hits );
+}
+
+void hit_bitmaps::merge(){
+  // OR the tables together in pairs, in parallel, until everything is in
+  // tables[0]
+  for ( size_t step=1; step < tables.size(); step *= 2 ){
+#pragma omp parallel for schedule(dynamic,1)
+    for ( size_t i=0; i < tables.size(); i += 2*step ){
+      if ( i + step < tables.size() ){
+	map<int64_t,Roaring64Map>& to = tables[i];
+	map<int64_t,Roaring64Map>& from = tables[i+step];
+	for ( auto& it : from ){
+	  auto pos = to.find( it.first );
+	  if ( pos == to.end() ){
+	    to.insert( make_pair( it.first, std::move( it.second ) ) );
+	  }
+	  else {
+	    pos->second |= it.second;
+	  }
+	}
+	from.clear();
+      }
+    }
+  }
+}
+
+size_t hit_bitmaps::size_in_bytes() const {
+  size_t result = 0;
+  for ( const auto& table : tables ){
+    for ( const auto& it : table ){
+      result += it.second.getSizeInBytes();
+    }
+  }
+  return result;
+}
+
+void hit_bitmaps::write_text( ostream& os ) const {
+  // the format of TICCL-indexer: key#value,value,...
+  // with the keys and the values sorted
+  for ( const auto& it : tables[0] ){
+    os << it.first << "#";
+    bool first = true;
+    for ( const auto& val : it.second ){
+      if ( !first ){
+	os << ",";
+      }
+      os << static_cast<int64_t>( val );
+      first = false;
+    }
+    os << endl;
+  }
+}
+
+void hit_bitmaps::write_roaring( ostream& os ) const {
+  // the format of TICCL-indexerNT-roaring, as read by TICCL-LDcalc-roaring:
+  // key#size serialized_bitmap
+  for ( const auto& it : tables[0] ){
+    size_t expected = it.second.getSizeInBytes();
+    string bytes( expected, '\0' );
+    size_t size = it.second.write( &bytes[0] );
+    os << it.first << "#" << size << " " << bytes.substr( 0, size ) << endl;
+  }
+}
+
+#endif // HAVE_ROARING
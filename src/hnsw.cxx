@@ -0,0 +1,416 @@
+/*
+  Copyright (c) 2006 - 2018
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of ticcltools
+
+  ticcltools is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  ticcltools is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcltools/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+#include <cstring>
+#include <cmath>
+#include <random>
+#include <queue>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include "ticcl/dotproduct.h"
+#include "ticcl/hnsw.h"
+
+using namespace std;
+
+const char HNSW_MAGIC[8] = { 'T', 'I', 'C', 'C', 'L', 'H', 'N', '1' };
+
+struct hnsw_header {
+  char magic[8];
+  uint64_t num_nodes;
+  uint64_t dim;
+  uint64_t M;
+  uint64_t M0;
+  uint64_t signature;
+  uint32_t entry_point;
+  int32_t max_level;
+};
+
+class visited_set {
+  // a small open addressing hash set for the nodes visited during a search.
+  // A search only visits a tiny part of the graph, so this is cheaper than
+  // a flag per node.
+ public:
+  visited_set(): table( 1024, EMPTY ), count(0) {};
+  bool insert( uint32_t node ){
+    // returns false when 'node' was already present
+    if ( 2 * ( count + 1 ) > table.size() ){
+      grow();
+    }
+    size_t mask = table.size() - 1;
+    size_t pos = ( node * 0x9E3779B1U ) & mask;
+    while ( table[pos] != EMPTY ){
+      if ( table[pos] == node ){
+	return false;
+      }
+      pos = ( pos + 1 ) & mask;
+    }
+    table[pos] = node;
+    ++count;
+    return true;
+  }
+ private:
+  static const uint32_t EMPTY = 0xFFFFFFFF;
+  void grow(){
+    vector<uint32_t> old( table.size() * 2, EMPTY );
+    old.swap( table );
+    count = 0;
+    for ( const auto& node : old ){
+      if ( node != EMPTY ){
+	insert( node );
+      }
+    }
+  }
+  vector<uint32_t> table;
+  size_t count;
+};
+
+struct worse_first {
+  bool operator()( const pair<float,uint32_t>& lhs,
+		   const pair<float,uint32_t>& rhs ) const {
+    return lhs.first > rhs.first;
+  }
+};
+
+hnsw_index::hnsw_index():
+  dim(0),
+  M(0),
+  M0(0),
+  entry_point(0),
+  max_level(-1)
+{
+}
+
+void hnsw_index::clear(){
+  vectors.clear();
+  levels.clear();
+  links0.clear();
+  upper.clear();
+  entry_point = 0;
+  max_level = -1;
+}
+
+float hnsw_index::similarity( const float *query, uint32_t node ) const {
+  return dot_product( query, vectors[node], dim );
+}
+
+uint32_t *hnsw_index::link_list( uint32_t node, int level ){
+  // element 0 is the number of links, followed by the links themselves
+  if ( level == 0 ){
+    return &links0[node * (M0+1)];
+  }
+  return &upper[node][(level-1) * (M+1)];
+}
+
+const uint32_t *hnsw_index::link_list( uint32_t node, int level ) const {
+  if ( level == 0 ){
+    return &links0[node * (M0+1)];
+  }
+  return &upper[node][(level-1) * (M+1)];
+}
+
+void hnsw_index::search_layer( const float *query,
+			       uint32_t entry,
+			       size_t ef,
+			       int level,
+			       vector<candidate>& found ) const {
+  // the classic best first search on one level of the graph.
+  // returns the 'ef' nearest nodes found, most similar first
+  visited_set visited;
+  priority_queue<candidate> todo;  // most similar on top
+  priority_queue<candidate,vector<candidate>,worse_first> best; // worst on top
+  float sim = similarity( query, entry );
+  visited.insert( entry );
+  todo.push( make_pair( sim, entry ) );
+  best.push( make_pair( sim, entry ) );
+  while ( !todo.empty() ){
+    candidate current = todo.top();
+    if ( current.first < best.top().first && best.size() >= ef ){
+      break;
+    }
+    todo.pop();
+    const uint32_t *links = link_list( current.second, level );
+    for ( uint32_t i=1; i <= links[0]; ++i ){
+      uint32_t node = links[i];
+      if ( !visited.insert( node ) ){
+	continue;
+      }
+      sim = similarity( query, node );
+      if ( best.size() < ef || sim > best.top().first ){
+	todo.push( make_pair( sim, node ) );
+	best.push( make_pair( sim, node ) );
+	if ( best.size() > ef ){
+	  best.pop();
+	}
+      }
+    }
+  }
+  found.resize( best.size() );
+  for ( size_t i = found.size(); i > 0; --i ){
+    found[i-1] = best.top();
+    best.pop();
+  }
+}
+
+uint32_t hnsw_index::greedy_search( const float *query,
+				    uint32_t entry,
+				    int level ) const {
+  // on the upper levels, we just walk to the most similar node
+  float best = similarity( query, entry );
+  bool changed = true;
+  while ( changed ){
+    changed = false;
+    const uint32_t *links = link_list( entry, level );
+    for ( uint32_t i=1; i <= links[0]; ++i ){
+      float sim = similarity( query, links[i] );
+      if ( sim > best ){
+	best = sim;
+	entry = links[i];
+	changed = true;
+      }
+    }
+  }
+  return entry;
+}
+
+void hnsw_index::select_neighbours( vector<candidate>& cands,
+				    size_t max ) const {
+  // the neighbour selection heuristic from the paper: take the candidates
+  // in order of similarity, but skip those that are closer to an already
+  // selected neighbour than to the node itself. This keeps the graph
+  // connected between clusters.
+  // 'cands' must be sorted, most similar first.
+  if ( cands.size() <= max ){
+    return;
+  }
+  vector<candidate> result;
+  for ( const auto& cand : cands ){
+    if ( result.size() >= max ){
+      break;
+    }
+    bool good = true;
+    for ( const auto& sel : result ){
+      if ( similarity( vectors[cand.second], sel.second ) > cand.first ){
+	good = false;
+	break;
+      }
+    }
+    if ( good ){
+      result.push_back( cand );
+    }
+  }
+  cands.swap( result );
+}
+
+void hnsw_index::connect( uint32_t from, uint32_t to, int level ){
+  // add a link from 'from' to 'to'. When 'from' has too many links, the
+  // selection heuristic decides which ones to keep
+  uint32_t *links = link_list( from, level );
+  const size_t max = max_links( level );
+  if ( links[0] < max ){
+    links[++links[0]] = to;
+    return;
+  }
+  vector<candidate> cands;
+  const float *vec = vectors[from];
+  cands.push_back( make_pair( similarity( vec, to ), to ) );
+  for ( uint32_t i=1; i <= links[0]; ++i ){
+    cands.push_back( make_pair( similarity( vec, links[i] ), links[i] ) );
+  }
+  sort( cands.begin(), cands.end(), greater<candidate>() );
+  select_neighbours( cands, max );
+  links[0] = cands.size();
+  for ( size_t i=0; i < cands.size(); ++i ){
+    links[i+1] = cands[i].second;
+  }
+}
+
+void hnsw_index::insert( uint32_t node, size_t ef_construction ){
+  const int level = levels[node];
+  if ( level > 0 ){
+    upper[node].resize( level * (M+1), 0 );
+  }
+  if ( max_level < 0 ){
+    entry_point = node;
+    max_level = level;
+    return;
+  }
+  const float *query = vectors[node];
+  uint32_t entry = entry_point;
+  for ( int lc = max_level; lc > level; --lc ){
+    entry = greedy_search( query, entry, lc );
+  }
+  vector<candidate> found;
+  for ( int lc = min( level, max_level ); lc >= 0; --lc ){
+    search_layer( query, entry, ef_construction, lc, found );
+    entry = found[0].second;
+    select_neighbours( found, M );
+    uint32_t *links = link_list( node, lc );
+    links[0] = found.size();
+    for ( size_t i=0; i < found.size(); ++i ){
+      links[i+1] = found[i].second;
+    }
+    for ( const auto& it : found ){
+      connect( it.second, node, lc );
+    }
+  }
+  if ( level > max_level ){
+    entry_point = node;
+    max_level = level;
+  }
+}
+
+void hnsw_index::build( const vector<const float*>& vecs,
+			size_t dimension,
+			size_t m,
+			size_t ef_construction ){
+  clear();
+  vectors = vecs;
+  dim = dimension;
+  M = m;
+  M0 = 2 * m;
+  const size_t size = vectors.size();
+  levels.resize( size );
+  links0.assign( size * (M0+1), 0 );
+  upper.resize( size );
+  // a fixed seed, so the same model always gives the same graph
+  mt19937 rng( 4711 );
+  uniform_real_distribution<double> uniform( 0.0, 1.0 );
+  const double mult = 1.0 / log( double(M) );
+  for ( size_t i=0; i < size; ++i ){
+    levels[i] = int( -log( 1.0 - uniform( rng ) ) * mult );
+  }
+  for ( size_t i=0; i < size; ++i ){
+    insert( i, ef_construction );
+  }
+}
+
+void hnsw_index::search( const float *query,
+			 size_t k,
+			 size_t ef,
+			 vector<pair<float,uint32_t>>& result ) const {
+  // find the 'k' most similar nodes, most similar first. A larger 'ef'
+  // gives a better recall, but a slower search
+  result.clear();
+  if ( max_level < 0 ){
+    return;
+  }
+  uint32_t entry = entry_point;
+  for ( int lc = max_level; lc > 0; --lc ){
+    entry = greedy_search( query, entry, lc );
+  }
+  search_layer( query, entry, max( ef, k ), 0, result );
+  if ( result.size() > k ){
+    result.resize( k );
+  }
+}
+
+template <typename T>
+bool write_vector( ostream& os, const vector<T>& vec ){
+  if ( !vec.empty() ){
+    os.write( (const char*)&vec[0], vec.size() * sizeof(T) );
+  }
+  return os.good();
+}
+
+template <typename T>
+bool read_vector( istream& is, vector<T>& vec ){
+  if ( !vec.empty() ){
+    is.read( (char*)&vec[0], vec.size() * sizeof(T) );
+  }
+  return is.good();
+}
+
+bool hnsw_index::save( const string& file_name, uint64_t signature ) const {
+  ofstream os( file_name, ios::binary );
+  if ( !os ){
+    return false;
+  }
+  hnsw_header header;
+  memcpy( header.magic, HNSW_MAGIC, sizeof(HNSW_MAGIC) );
+  header.num_nodes = vectors.size();
+  header.dim = dim;
+  header.M = M;
+  header.M0 = M0;
+  header.signature = signature;
+  header.entry_point = entry_point;
+  header.max_level = max_level;
+  os.write( (const char*)&header, sizeof(header) );
+  write_vector( os, levels );
+  write_vector( os, links0 );
+  for ( const auto& up : upper ){
+    write_vector( os, up );
+  }
+  return os.good();
+}
+
+bool hnsw_index::load( const string& file_name,
+		       const vector<const float*>& vecs,
+		       size_t dimension,
+		       uint64_t signature ){
+  clear();
+  ifstream is( file_name, ios::binary );
+  if ( !is ){
+    return false;
+  }
+  hnsw_header header;
+  if ( !is.read( (char*)&header, sizeof(header) )
+       || memcmp( header.magic, HNSW_MAGIC, sizeof(HNSW_MAGIC) ) != 0 ){
+    cerr << "not a valid index file: " << file_name << endl;
+    return false;
+  }
+  if ( header.num_nodes != vecs.size()
+       || header.dim != dimension
+       || header.signature != signature ){
+    cerr << "the index in " << file_name
+	 << " doesn't belong to these vectors" << endl;
+    return false;
+  }
+  M = header.M;
+  M0 = header.M0;
+  dim = dimension;
+  const size_t size = header.num_nodes;
+  levels.resize( size );
+  links0.resize( size * (M0+1) );
+  upper.resize( size );
+  bool ok = read_vector( is, levels ) && read_vector( is, links0 );
+  for ( size_t i=0; ok && i < size; ++i ){
+    if ( levels[i] > 0 ){
+      upper[i].resize( levels[i] * (M+1) );
+      ok = read_vector( is, upper[i] );
+    }
+  }
+  if ( !ok ){
+    cerr << "problem reading index file: " << file_name << endl;
+    clear();
+    return false;
+  }
+  vectors = vecs;
+  entry_point = header.entry_point;
+  max_level = header.max_level;
+  return true;
+}
@@ -0,0 +1,184 @@
+/*
+  Copyright (c) 2006 - 2018
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of ticcltools
+
+  ticcltools is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  ticcltools is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcltools/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+#include <cstring>
+#include <climits>
+#include <vector>
+#include <algorithm>
+#include "ticcl/levenshtein.h"
+
+using namespace std;
+
+typedef unsigned long long bitVec;
+
+const int MAX_BITS = 64;
+
+class peq_table {
+  // for every character of a pattern (at most 64 long) a bitvector with
+  // a bit set on every position where that character occurs.
+  // a small open addressing hash on the stack, so no allocation needed
+public:
+  peq_table( const UChar *pat, int len ){
+    memset( masks, 0, sizeof(masks) );
+    bitVec bit = 1;
+    for ( int i=0; i < len; ++i ){
+      size_t pos = pat[i] & MASK;
+      while ( masks[pos] != 0 && keys[pos] != pat[i] ){
+	pos = (pos+1) & MASK;
+      }
+      keys[pos] = pat[i];
+      masks[pos] |= bit;
+      bit <<= 1;
+    }
+  }
+  bitVec get( UChar uc ) const {
+    size_t pos = uc & MASK;
+    while ( masks[pos] != 0 ){
+      if ( keys[pos] == uc ){
+	return masks[pos];
+      }
+      pos = (pos+1) & MASK;
+    }
+    return 0;
+  }
+private:
+  static const size_t SIZE = 2*MAX_BITS;
+  static const size_t MASK = SIZE-1;
+  bitVec masks[SIZE];
+  UChar keys[SIZE];
+};
+
+static unsigned int myers_ld( const UChar *pat, int m,
+			      const UChar *text, int n,
+			      unsigned int limit ){
+  // Myers' bit-parallel algorithm, as formulated by Hyyrö.
+  // assumes 0 < m <= 64 and m <= n
+  const peq_table peq( pat, m );
+  const bitVec last = 1ULL << (m-1);
+  bitVec Pv = ~0ULL;
+  bitVec Mv = 0;
+  unsigned int score = m;
+  for ( int j=0; j < n; ++j ){
+    const bitVec Eq = peq.get( text[j] );
+    const bitVec Xv = Eq | Mv;
+    const bitVec Xh = (((Eq & Pv) + Pv) ^ Pv) | Eq;
+    bitVec Ph = Mv | ~(Xh | Pv);
+    bitVec Mh = Pv & Xh;
+    if ( Ph & last ){
+      ++score;
+    }
+    else if ( Mh & last ){
+      --score;
+    }
+    // every remaining column can lower the score with at most 1
+    const unsigned int remaining = n - j - 1;
+    if ( score > limit && score - limit > remaining ){
+      return limit + 1;
+    }
+    Ph = (Ph << 1) | 1;
+    Mh <<= 1;
+    Pv = Mh | ~(Xv | Ph);
+    Mv = Ph & Xv;
+  }
+  return score;
+}
+
+static unsigned int dp_ld( const UChar *s1, int len1,
+			   const UChar *s2, int len2,
+			   unsigned int limit ){
+  // the classic dynamic programming approach, used for long strings only.
+  // stops when a complete row exceeds the limit
+  const size_t STACK_SIZE = 256;
+  unsigned int stack_buf[2*STACK_SIZE];
+  vector<unsigned int> heap_buf;
+  unsigned int *prevCol = stack_buf;
+  if ( (size_t)len2+1 > STACK_SIZE ){
+    heap_buf.resize( 2*(len2+1) );
+    prevCol = &heap_buf[0];
+  }
+  unsigned int *col = prevCol + len2 + 1;
+  for ( int j = 0; j <= len2; ++j ){
+    prevCol[j] = j;
+  }
+  for ( int i = 0; i < len1; ++i ) {
+    col[0] = i+1;
+    unsigned int row_min = col[0];
+    for ( int j = 0; j < len2; ++j ){
+      col[j+1] = min( min( 1 + col[j], 1 + prevCol[1 + j]),
+		      prevCol[j] + (s1[i]==s2[j] ? 0 : 1) );
+      row_min = min( row_min, col[j+1] );
+    }
+    if ( row_min > limit ){
+      return limit + 1;
+    }
+    swap( col, prevCol );
+  }
+  return prevCol[len2];
+}
+
+unsigned int ldCompare( const UChar *s1, int len1,
+			const UChar *s2, int len2,
+			unsigned int limit ){
+  if ( len1 > len2 ){
+    // use the shortest string as the 'pattern'
+    swap( s1, s2 );
+    swap( len1, len2 );
+  }
+  if ( (unsigned int)(len2 - len1) > limit ){
+    return limit + 1;
+  }
+  // common pre- and suffixes don't contribute to the distance
+  while ( len1 > 0 && *s1 == *s2 ){
+    ++s1;
+    ++s2;
+    --len1;
+    --len2;
+  }
+  while ( len1 > 0 && s1[len1-1] == s2[len2-1] ){
+    --len1;
+    --len2;
+  }
+  unsigned int result;
+  if ( len1 == 0 ){
+    result = len2;
+  }
+  else if ( len1 <= MAX_BITS ){
+    result = myers_ld( s1, len1, s2, len2, limit );
+  }
+  else {
+    result = dp_ld( s1, len1, s2, len2, limit );
+  }
+  if ( result > limit ){
+    return limit + 1;
+  }
+  return result;
+}
+
+unsigned int ldCompare( const UChar *s1, int len1,
+			const UChar *s2, int len2 ){
+  return ldCompare( s1, len1, s2, len2, UINT_MAX - 1 );
+}
@@ -0,0 +1,69 @@
+/*
+  Copyright (c) 2006 - 2018
+  CLST  - Radboud University
+  ILK   - Tilburg University
+
+  This file is part of ticcltools
+
+  ticcltools is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  ticcltools is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ticcltools/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+#include <iostream>
+#include "config.h"
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
+#include "ticcl/threadstats.h"
+
+using namespace std;
+
+int thread_num(){
+#ifdef HAVE_OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+double seconds_since( const chrono::steady_clock::time_point& start ){
+  return chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+}
+
+void show_progress( atomic<size_t>& count ){
+  size_t current = ++count;
+  if ( current % 100 == 0 ){
+#pragma omp critical(progress)
+    {
+      cout << ".";
+      cout.flush();
+      if ( current % 5000 == 0 ){
+	cout << endl << current << endl;
+      }
+    }
+  }
+}
+
+void show_thread_stats( const vector<double>& busy, double wall ){
+  cout << endl << "thread statistics (wall time " << wall << " sec)" << endl;
+  for ( size_t i=0; i < busy.size(); ++i ){
+    cout << "thread " << i << "\tbusy: " << busy[i]
+	 << " sec\tidle: " << wall - busy[i] << " sec" << endl;
+  }
+}
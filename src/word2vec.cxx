@@ -1,69 +1,530 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <iostream>
 #include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <cmath>
+#include <algorithm>
+#include <fstream>
+#include "config.h"
+#ifdef HAVE_OPENMP
+#include "omp.h"
+#endif
 #include "ticcutils/StringOps.h"
+#include "ticcl/dotproduct.h"
 #include "ticcl/word2vec.h"
 
 using namespace std;
 
-bool wordvec_tester::fill( const string& name ){
-  FILE *f = fopen( name.c_str(), "rb");
-  if (f == NULL) {
-    cerr << "unable to open " << name << endl;
+// the rows of the matrix are aligned on a cache line
+const size_t ROW_ALIGN = 64 / sizeof(float);
+
+// don't bother to start threads for the exact search of small models
+const size_t MIN_PARALLEL_ROWS = 20000;
+
+// the size of the blocks of rows in a batched search. (about half an L2
+// cache)
+const size_t BLOCK_BYTES = 128 * 1024;
+
+const char WORDVEC_MAGIC[8] = { 'T', 'I', 'C', 'C', 'L', 'W', 'V', '1' };
+
+struct wordvec_header {
+  char magic[8];
+  uint64_t num_words;
+  uint64_t dim;
+  uint64_t stride;
+  uint64_t pool_size;
+};
+
+static size_t matrix_offset( size_t num_words, size_t pool_size ){
+  // where the matrix starts in a cache file
+  const size_t align = ROW_ALIGN * sizeof(float);
+  size_t pos = sizeof(wordvec_header)
+    + ( num_words + 1 ) * sizeof(uint64_t) + pool_size;
+  return ( ( pos + align - 1 ) / align ) * align;
+}
+
+wordvec_tester::wordvec_tester():
+  matrix(0),
+  stride(0),
+  storage(0),
+  mapped(0),
+  mapped_size(0),
+  _dim(0),
+  ann_ef(100)
+{
+}
+
+wordvec_tester::~wordvec_tester(){
+  clear();
+}
+
+void wordvec_tester::clear(){
+  free( storage );
+  storage = 0;
+  if ( mapped ){
+    munmap( mapped, mapped_size );
+    mapped = 0;
+    mapped_size = 0;
+  }
+  matrix = 0;
+  stride = 0;
+  _dim = 0;
+  vocab.clear();
+  row_words.clear();
+  index.clear();
+}
+
+static bool read_number( const char *& pos, const char *end,
+			 unsigned long& value ){
+  while ( pos < end && isspace( (unsigned char)*pos ) ){
+    ++pos;
+  }
+  if ( pos == end || !isdigit( (unsigned char)*pos ) ){
     return false;
   }
+  value = 0;
+  while ( pos < end && isdigit( (unsigned char)*pos ) ){
+    value = value * 10 + ( *pos - '0' );
+    ++pos;
+  }
+  return true;
+}
+
+bool wordvec_tester::read_model( const char *data, size_t size ){
+  // parse a binary word2vec model:
+  // a line with the number of words and the dimension, then for every word
+  // the word, a space, and 'dimension' floats
+  const char *pos = data;
+  const char *end = data + size;
   unsigned long words = 0;
-  unsigned long size = 0;
-  if ( fscanf(f, "%lud", &words) != 1 ){
+  unsigned long dim = 0;
+  if ( !read_number( pos, end, words ) ){
     cerr << "reading #words failed" << endl;
-    fclose(f);
     return false;
   }
-  if ( fscanf(f, "%lud", &size) != 1 ){
+  if ( !read_number( pos, end, dim ) ){
     cerr << "reading #dimension failed" << endl;
-    fclose(f);
     return false;
   }
-  _dim = size;
+  _dim = dim;
+  stride = ( ( _dim + ROW_ALIGN - 1 ) / ROW_ALIGN ) * ROW_ALIGN;
+  void *mem = 0;
+  if ( posix_memalign( &mem, ROW_ALIGN * sizeof(float),
+		       max<size_t>( words * stride, 1 ) * sizeof(float) ) != 0 ){
+    cerr << "unable to allocate memory for " << words << " vectors of size "
+	 << _dim << endl;
+    return false;
+  }
+  storage = (float*)mem;
+  matrix = storage;
+  memset( storage, 0, words * stride * sizeof(float) );
+  row_words.reserve( words );
+  vocab.reserve( words );
+  const size_t vec_size = _dim * sizeof(float);
   for ( unsigned b = 0; b < words; b++) {
-    string word;
-    while (1) {
-      int kar = fgetc(f);
-      if ( feof(f) || kar == EOF || kar == ' ' )
-	break;
-      if ( kar != '\n' ){
-	word += kar;
-      }
+    // the word runs upto the next space. newlines are skipped
+    while ( pos < end && *pos == '\n' ){
+      ++pos;
     }
-    vector<float> vec( _dim );
-    for ( size_t a = 0; a < _dim; a++) {
-      float val;
-      if ( fread(&val, sizeof(float), 1, f ) != 1 ){
-	cerr << "reading float failed" << endl;
-	exit(1);
-      }
-      vec[a] = val;
+    const char *space = (const char*)memchr( pos, ' ', end - pos );
+    if ( !space || (size_t)( end - space - 1 ) < vec_size ){
+      cerr << "reading float failed" << endl;
+      exit(1);
+    }
+    string word( pos, space - pos );
+    if ( word.find( '\n' ) != string::npos ){
+      word.erase( remove( word.begin(), word.end(), '\n' ), word.end() );
+    }
+    pos = space + 1;
+    // copy the vector directly in the next free row
+    float *vec = storage + row_words.size() * stride;
+    memcpy( vec, pos, vec_size );
+    pos += vec_size;
+    if ( !vocab.insert( make_pair( word, row_words.size() ) ).second ){
+      // a duplicate. the first one wins, the row is reused
+      memset( vec, 0, vec_size );
+      continue;
     }
+    row_words.push_back( word );
     // normalize the vector
-    float len = 0;
-    for ( size_t i = 0; i < _dim; ++i )
-      len += vec[i] * vec[i];
-    len = sqrt(len);
+    float len = sqrt( dot_product( vec, vec, _dim ) );
     for ( size_t i = 0; i < _dim; ++i ){
       vec[i] /= len;
     }
-    // ansd insert in the vocabulary
-    vocab.insert( make_pair( word, vec ) );
   }
-  fclose(f);
   return true;
 }
 
-bool wordvec_tester::lookup( const string& sentence, size_t num_vec,
-			     vector<word_dist>& result ) const {
+bool wordvec_tester::read_cache( const char *data, size_t size ){
+  // use a cache file. Only the words are copied, the vectors stay in the
+  // mapped file.
+  const wordvec_header *header = (const wordvec_header*)data;
+  const uint64_t words = header->num_words;
+  const size_t offset = matrix_offset( words, header->pool_size );
+  if ( header->stride % ROW_ALIGN != 0
+       || header->stride < header->dim
+       || offset + words * header->stride * sizeof(float) != size ){
+    return false;
+  }
+  const uint64_t *word_pos = (const uint64_t*)(header+1);
+  const char *pool = (const char*)(word_pos + words + 1);
+  _dim = header->dim;
+  stride = header->stride;
+  matrix = (const float*)( data + offset );
+  row_words.reserve( words );
+  vocab.reserve( words );
+  for ( size_t r = 0; r < words; ++r ){
+    if ( word_pos[r] > word_pos[r+1] || word_pos[r+1] > header->pool_size ){
+      return false;
+    }
+    row_words.push_back( string( pool + word_pos[r],
+				 word_pos[r+1] - word_pos[r] ) );
+    vocab.insert( make_pair( row_words.back(), r ) );
+  }
+  return true;
+}
+
+bool wordvec_tester::is_cache( const string& name ){
+  ifstream is( name, ios::binary );
+  char magic[sizeof(WORDVEC_MAGIC)];
+  if ( !is.read( magic, sizeof(magic) ) ){
+    return false;
+  }
+  return memcmp( magic, WORDVEC_MAGIC, sizeof(magic) ) == 0;
+}
+
+bool wordvec_tester::fill( const string& name ){
+  // read a binary word2vec model, or a cache file
+  clear();
+  int fd = ::open( name.c_str(), O_RDONLY );
+  if ( fd < 0 ){
+    cerr << "unable to open " << name << endl;
+    return false;
+  }
+  struct stat st;
+  if ( fstat( fd, &st ) != 0 || st.st_size == 0 ){
+    cerr << "unable to read " << name << endl;
+    close( fd );
+    return false;
+  }
+  void *data = mmap( 0, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+  close( fd );
+  if ( data == MAP_FAILED ){
+    cerr << "unable to mmap " << name << endl;
+    return false;
+  }
+  mapped = data;
+  mapped_size = st.st_size;
+  if ( mapped_size >= sizeof(wordvec_header)
+       && memcmp( data, WORDVEC_MAGIC, sizeof(WORDVEC_MAGIC) ) == 0 ){
+    if ( !read_cache( (const char*)data, mapped_size ) ){
+      cerr << "invalid word vector cache file: " << name << endl;
+      clear();
+      return false;
+    }
+    return true;
+  }
+  // a model is read only once, from front to back, and then copied
+  madvise( data, mapped_size, MADV_SEQUENTIAL );
+  bool result = read_model( (const char*)data, mapped_size );
+  munmap( mapped, mapped_size );
+  mapped = 0;
+  mapped_size = 0;
+  if ( !result ){
+    clear();
+  }
+  return result;
+}
+
+bool wordvec_tester::save_cache( const string& name ) const {
+  // store the words and the normalised matrix, in the format read_cache()
+  // expects
+  vector<uint64_t> word_pos;
+  string pool;
+  for ( const auto& word : row_words ){
+    word_pos.push_back( pool.size() );
+    pool += word;
+  }
+  word_pos.push_back( pool.size() );
+  wordvec_header header;
+  memcpy( header.magic, WORDVEC_MAGIC, sizeof(WORDVEC_MAGIC) );
+  header.num_words = row_words.size();
+  header.dim = _dim;
+  header.stride = stride;
+  header.pool_size = pool.size();
+  ofstream os( name, ios::binary );
+  if ( !os ){
+    cerr << "unable to save word vectors in " << name << endl;
+    return false;
+  }
+  os.write( (const char*)&header, sizeof(header) );
+  os.write( (const char*)&word_pos[0], word_pos.size() * sizeof(uint64_t) );
+  os.write( pool.c_str(), pool.size() );
+  const size_t pos = sizeof(header)
+    + word_pos.size() * sizeof(uint64_t) + pool.size();
+  const string padding( matrix_offset( row_words.size(), pool.size() ) - pos,
+			0 );
+  os.write( padding.c_str(), padding.size() );
+  if ( !row_words.empty() ){
+    os.write( (const char*)matrix,
+	      row_words.size() * stride * sizeof(float) );
+  }
+  if ( !os.good() ){
+    cerr << "unable to save word vectors in " << name << endl;
+    return false;
+  }
+  return true;
+}
+
+bool wordvec_tester::use_cache( const string& model, const string& cache ){
+  // read the vectors from the cache file. When there is no such file yet,
+  // read the model and create the cache for the next time.
+  if ( is_cache( cache ) ){
+    return fill( cache );
+  }
+  return fill( model ) && save_cache( cache );
+}
+
+const float *wordvec_tester::find( const string& word ) const {
+  auto const it = vocab.find( word );
+  if ( it == vocab.end() ){
+    return 0;
+  }
+  return row( it->second );
+}
+
+static void keep_best( vector<pair<float,uint32_t>>& best,
+		       size_t num_vec,
+		       float dist,
+		       uint32_t r ){
+  // insert (dist,r) in 'best', which holds the at most 'num_vec' largest
+  // distances seen so far, largest first
+  if ( best.size() == num_vec ){
+    if ( num_vec == 0 || dist <= best.back().first ){
+      return;
+    }
+    best.pop_back();
+  }
+  auto pos = best.end();
+  while ( pos != best.begin() && (pos-1)->first < dist ){
+    --pos;
+  }
+  best.insert( pos, make_pair( dist, r ) );
+}
+
+void wordvec_tester::exact_nearest( const float *vec,
+				    const vector<size_t>& skip,
+				    size_t num_vec,
+				    vector<pair<float,uint32_t>>& result ) const {
+  // compare 'vec' with ALL the vectors in the matrix, and keep the
+  // 'num_vec' most similar ones. Large models are split over the threads,
+  // which each keep their own best ones.
   result.clear();
-  //  cerr << "looking up: '" << sentence << "'" << endl;
-  vector<string> words;
+  const size_t rows = row_words.size();
+  size_t num_threads = 1;
+#ifdef HAVE_OPENMP
+  if ( rows >= MIN_PARALLEL_ROWS && !omp_in_parallel() ){
+    num_threads = omp_get_max_threads();
+  }
+#endif
+  vector<vector<pair<float,uint32_t>>> partial( num_threads );
+#pragma omp parallel for num_threads(num_threads) schedule(static,1)
+  for ( size_t t = 0; t < num_threads; ++t ){
+    vector<pair<float,uint32_t>>& best = partial[t];
+    best.reserve( num_vec + 1 );
+    const size_t first = rows * t / num_threads;
+    const size_t last = rows * (t+1) / num_threads;
+    for ( size_t r = first; r < last; ++r ){
+      float dist = dot_product( vec, row(r), _dim );
+      if ( dist > 0
+	   && ( best.size() < num_vec || dist > best.back().first ) ){
+	bool hit = false;
+	for ( const auto& s : skip ){
+	  if ( s == r )
+	    hit = true;
+	}
+	if ( hit ) continue;
+	keep_best( best, num_vec, dist, r );
+      }
+    }
+  }
+  for ( const auto& best : partial ){
+    for ( const auto& it : best ){
+      keep_best( result, num_vec, it.first, it.second );
+    }
+  }
+}
+
+vector<size_t> wordvec_tester::rows_of( const vector<string>& words ) const {
+  vector<size_t> result;
+  for ( const auto& w : words ){
+    auto const it = vocab.find( w );
+    if ( it != vocab.end() ){
+      result.push_back( it->second );
+    }
+  }
+  return result;
+}
+
+void wordvec_tester::to_result( const vector<pair<float,uint32_t>>& found,
+				const vector<size_t>& skip,
+				size_t num_vec,
+				vector<word_dist>& result ) const {
+  // the first 'num_vec' of 'found' that are not in 'skip', as words
+  result.clear();
+  result.resize( num_vec, {"", 0.0 } );
+  size_t pos = 0;
+  for ( const auto& it : found ){
+    if ( pos == num_vec ){
+      break;
+    }
+    bool hit = false;
+    for ( const auto& s : skip ){
+      if ( s == it.second )
+	hit = true;
+    }
+    if ( hit || it.first <= 0 ) continue;
+    result[pos].w = row_words[it.second];
+    result[pos].d = it.first;
+    ++pos;
+  }
+}
+
+void wordvec_tester::nearest( const vector<float>& vec,
+			      const vector<string>& skip,
+			      size_t num_vec,
+			      vector<word_dist>& result ) const {
+  // find the 'num_vec' words closest to 'vec', but not those in 'skip'
+  vector<size_t> skip_rows = rows_of( skip );
+  vector<pair<float,uint32_t>> found;
+  if ( has_index() ){
+    // ask for some extra neighbours, as the skipped words may be among them
+    index.search( vec.data(), num_vec + skip_rows.size(), ann_ef, found );
+  }
+  else {
+    exact_nearest( vec.data(), skip_rows, num_vec, found );
+  }
+  to_result( found, skip_rows, num_vec, result );
+}
+
+void wordvec_tester::exact_nearest( const vector<vector<float>>& queries,
+				    const vector<vector<size_t>>& skips,
+				    size_t num_vec,
+				    vector<vector<pair<float,uint32_t>>>& results ) const {
+  // the exact search for a batch of queries, in one sweep over the matrix.
+  // The matrix is processed in blocks of rows that fit in the cache, and
+  // every block is compared with all the queries before moving on. Each
+  // thread takes its own part of the rows, and keeps its own best lists.
+  const size_t rows = row_words.size();
+  const size_t num_queries = queries.size();
+  results.assign( num_queries, vector<pair<float,uint32_t>>() );
+  if ( rows == 0 ){
+    return;
+  }
+  const size_t block_rows = max<size_t>( 16,
+					 BLOCK_BYTES / ( stride * sizeof(float) ) );
+  size_t num_threads = 1;
+#ifdef HAVE_OPENMP
+  if ( !omp_in_parallel() ){
+    num_threads = omp_get_max_threads();
+  }
+#endif
+  typedef vector<vector<pair<float,uint32_t>>> best_lists;
+  vector<best_lists> partial( num_threads, best_lists( num_queries ) );
+#pragma omp parallel for num_threads(num_threads) schedule(static,1)
+  for ( size_t t = 0; t < num_threads; ++t ){
+    best_lists& best = partial[t];
+    const size_t first = rows * t / num_threads;
+    const size_t last = rows * (t+1) / num_threads;
+    for ( size_t block = first; block < last; block += block_rows ){
+      const size_t block_end = min( block + block_rows, last );
+      for ( size_t q = 0; q < num_queries; ++q ){
+	const float *vec = queries[q].data();
+	vector<pair<float,uint32_t>>& q_best = best[q];
+	for ( size_t r = block; r < block_end; ++r ){
+	  float dist = dot_product( vec, row(r), _dim );
+	  if ( dist > 0
+	       && ( q_best.size() < num_vec || dist > q_best.back().first ) ){
+	    bool hit = false;
+	    for ( const auto& s : skips[q] ){
+	      if ( s == r )
+		hit = true;
+	    }
+	    if ( hit ) continue;
+	    keep_best( q_best, num_vec, dist, r );
+	  }
+	}
+      }
+    }
+  }
+  for ( const auto& best : partial ){
+    for ( size_t q = 0; q < num_queries; ++q ){
+      for ( const auto& it : best[q] ){
+	keep_best( results[q], num_vec, it.first, it.second );
+      }
+    }
+  }
+}
+
+vector<const float*> wordvec_tester::row_pointers() const {
+  vector<const float*> result( row_words.size() );
+  for ( size_t r = 0; r < result.size(); ++r ){
+    result[r] = row( r );
+  }
+  return result;
+}
+
+uint64_t wordvec_tester::signature() const {
+  // a FNV-1a hash over the words in file order, to check that an index
+  // file belongs to this model
+  uint64_t result = 14695981039346656037UL;
+  for ( const auto& word : row_words ){
+    for ( const auto& c : word ){
+      result = ( result ^ (unsigned char)c ) * 1099511628211UL;
+    }
+    result = ( result ^ ' ' ) * 1099511628211UL;
+  }
+  return result ^ ( row_words.size() * 31 + _dim );
+}
+
+void wordvec_tester::build_index( size_t M, size_t ef_construction ){
+  index.build( row_pointers(), _dim, M, ef_construction );
+}
+
+bool wordvec_tester::save_index( const string& name ) const {
+  if ( !index.save( name, signature() ) ){
+    cerr << "unable to save index in " << name << endl;
+    return false;
+  }
+  return true;
+}
+
+bool wordvec_tester::load_index( const string& name ){
+  return index.load( name, row_pointers(), _dim, signature() );
+}
+
+bool wordvec_tester::use_index( const string& name ){
+  // load the index from file 'name'. When there is no such file yet, build
+  // the index and save it there for the next time.
+  ifstream is( name );
+  if ( is ){
+    is.close();
+    return load_index( name );
+  }
+  build_index();
+  return save_index( name );
+}
+
+bool wordvec_tester::query_vector( const string& sentence,
+				   vector<float>& vec,
+				   vector<string>& words ) const {
+  // the normalised sum of the vectors of the words in 'sentence'
+  words.clear();
   size_t num_words = TiCC::split( sentence, words );
   if ( num_words < 1 ){
     cerr << "empty searchterm" << endl;
@@ -71,57 +532,73 @@ bool wordvec_tester::lookup( const string& sentence, size_t num_vec,
   }
 
   // create an aggregated vector of all the words
-  vector<float> vec( _dim, 0 );
+  vec.assign( _dim, 0 );
   for ( size_t b = 0; b < num_words; ++b ) {
-    auto const it = vocab.find( words[b] );
-    if ( it == vocab.end() ){
+    const float *wv = find( words[b] );
+    if ( !wv ){
       //      cerr << "couldn't find " << words[a] << endl;
       return false;
     }
     for ( size_t a = 0; a < _dim; ++a ){
-      vec[a] += it->second[a];
+      vec[a] += wv[a];
     }
   }
 
   // normalize the created vector
-  float len = 0;
-  for ( size_t a = 0; a < _dim; ++a ) {
-    len += vec[a] * vec[a];
-  }
-  len = sqrt(len);
+  float len = sqrt( dot_product( vec.data(), vec.data(), _dim ) );
   for ( size_t a = 0; a < _dim; ++a ) {
     vec[a] /= len;
   }
+  return true;
+}
 
-  // now compare with ALL the vectors in de vocabulary
-  // keep de 'num_vec' largest
+bool wordvec_tester::lookup( const string& sentence, size_t num_vec,
+			     vector<word_dist>& result ) const {
+  result.clear();
+  //  cerr << "looking up: '" << sentence << "'" << endl;
+  vector<string> words;
+  vector<float> vec;
+  if ( !query_vector( sentence, vec, words ) ){
+    return false;
+  }
+  nearest( vec, words, num_vec, result );
+  return true;
+}
 
-  result.resize( num_vec, {"", 0.0 } );
-  for ( const auto& it: vocab ) {
-    bool hit = false;
-    for ( size_t b = 0; b < num_words; ++b ){
-      if ( words[b] == it.first )
-	hit = true;
+void wordvec_tester::lookup( const vector<string>& sentences,
+			     size_t num_vec,
+			     vector<vector<word_dist>>& results ) const {
+  // lookup() for a batch of queries. results[i] is empty when sentences[i]
+  // can't be looked up.
+  results.assign( sentences.size(), vector<word_dist>() );
+  vector<size_t> todo;
+  vector<vector<float>> queries;
+  vector<vector<size_t>> skips;
+  for ( size_t i=0; i < sentences.size(); ++i ){
+    vector<string> words;
+    vector<float> vec;
+    if ( query_vector( sentences[i], vec, words ) ){
+      todo.push_back( i );
+      queries.push_back( vec );
+      skips.push_back( rows_of( words ) );
     }
-    if ( hit ) continue;
-    float dist = 0;
-    for ( size_t a = 0; a < _dim; ++a ){
-      dist += vec[a] * it.second[a];
-    }
-    for ( size_t a = 0; a < num_vec; ++a ) {
-      if (dist > result[a].d ) {
-	// larger so shift the rest to the back
-	// and insert
-	for ( size_t d = num_vec - 1; d > a; d--) {
-	  result[d] = result[d-1];
-	}
-	result[a].w = it.first;
-	result[a].d = dist;
-	break;
-      }
+  }
+  if ( has_index() ){
+    // the index is fast enough per query. just divide them over the threads
+#pragma omp parallel for schedule(dynamic,16)
+    for ( size_t i=0; i < todo.size(); ++i ){
+      vector<pair<float,uint32_t>> found;
+      index.search( queries[i].data(), num_vec + skips[i].size(), ann_ef,
+		    found );
+      to_result( found, skips[i], num_vec, results[todo[i]] );
     }
+    return;
+  }
+  vector<vector<pair<float,uint32_t>>> found;
+  exact_nearest( queries, skips, num_vec, found );
+  for ( size_t i=0; i < todo.size(); ++i ){
+    to_result( found[i], skips[i], num_vec, results[todo[i]] );
   }
-  return true;
 }
 
 bool wordvec_tester::analogy( const vector<string>& words,
@@ -135,63 +612,33 @@ bool wordvec_tester::analogy( const vector<string>& words,
     // create an aggregated vector of all the words
   vector<float> vec( _dim, 0 );
 
-  auto const& it0 = vocab.find( words[0] );
-  if ( it0 == vocab.end() ){
+  const float *v0 = find( words[0] );
+  if ( !v0 ){
     //      cerr << "couldn't find " << words[0] << endl;
     return false;
   }
-  auto const& it1 = vocab.find( words[1] );
-  if ( it1 == vocab.end() ){
+  const float *v1 = find( words[1] );
+  if ( !v1 ){
     //      cerr << "couldn't find " << words[1] << endl;
     return false;
   }
-  auto const& it2 = vocab.find( words[2] );
-  if ( it2 == vocab.end() ){
+  const float *v2 = find( words[2] );
+  if ( !v2 ){
     //      cerr << "couldn't find " << words[2] << endl;
     return false;
   }
 
   for ( size_t a = 0; a < _dim; ++a ){
-    vec[a] += it1->second[a] - it0->second[a] + it2->second[a];
+    vec[a] += v1[a] - v0[a] + v2[a];
   }
 
   // normalize the created vector
-  float len = 0;
-  for ( size_t a = 0; a < _dim; ++a ) {
-    len += vec[a] * vec[a];
-  }
-  len = sqrt(len);
+  float len = sqrt( dot_product( vec.data(), vec.data(), _dim ) );
   for ( size_t a = 0; a < _dim; ++a ) {
     vec[a] /= len;
   }
 
-  // now compare with ALL the vectors in de vocabulary
-  // keep de 'num_vec' largest
-  result.resize( num_vec, {"", 0.0 } );
-  for ( const auto& it: vocab ) {
-    if ( it.first == it0->first
-	 || it.first == it1->first
-	 || it.first == it2->first ){
-      //      cerr << "skip " << it.first << endl;
-      continue;
-    }
-    float dist = 0;
-    for ( size_t a = 0; a < _dim; ++a ){
-      dist += vec[a] * it.second[a];
-    }
-    for ( size_t a = 0; a < num_vec; ++a ) {
-      if (dist > result[a].d ) {
-	// larger so shift the rest to the back
-	// and insert
-	for ( size_t d = num_vec - 1; d > a; d--) {
-	  result[d] = result[d-1];
-	}
-	result[a].w = it.first;
-	result[a].d = dist;
-	break;
-      }
-    }
-  }
+  nearest( vec, words, num_vec, result );
   return true;
 }
 
@@ -213,43 +660,33 @@ double wordvec_tester::distance( const string& s1, const string& s2 ) const {
   // create an aggregated vector of all the words
   vector<float> vec1( _dim, 0 );
   for ( auto const& w : words1 ) {
-    auto const& it = vocab.find( w );
-    if ( it == vocab.end() ){
+    const float *wv = find( w );
+    if ( !wv ){
       throw "unknown word '" + w + "'";
     }
     for ( size_t a = 0; a < _dim; ++a ){
-      vec1[a] += it->second[a];
+      vec1[a] += wv[a];
     }
   }
   vector<float> vec2( _dim, 0 );
   for ( auto const& w : words2 ) {
-    auto const& it = vocab.find( w );
-    if ( it == vocab.end() ){
+    const float *wv = find( w );
+    if ( !wv ){
       throw "unknown word '" + w + "'";
     }
     for ( size_t a = 0; a < _dim; ++a ){
-      vec2[a] += it->second[a];
+      vec2[a] += wv[a];
     }
   }
 
   // normalize the created vectors
-  float len1 = 0;
-  float len2 = 0;
-  for ( size_t a = 0; a < _dim; ++a ) {
-    len1 += vec1[a] * vec1[a];
-    len2 += vec2[a] * vec2[a];
-  }
-  len1 = sqrt(len1);
-  len2 = sqrt(len2);
+  float len1 = sqrt( dot_product( vec1.data(), vec1.data(), _dim ) );
+  float len2 = sqrt( dot_product( vec2.data(), vec2.data(), _dim ) );
   for ( size_t a = 0; a < _dim; ++a ) {
     vec1[a] /= len1;
     vec2[a] /= len2;
   }
 
   // now inproduct the two vectors
-  double result = 0.0;
-  for ( size_t a = 0; a < _dim; ++a ){
-    result += vec1[a] * vec2[a];
-  }
-  return result;
+  return dot_product( vec1.data(), vec2.data(), _dim );
 }
@@ -0,0 +1,77 @@
+#!/bin/bash
+# benchmark for TICCL-chain on a large ranked file, made of many renamed
+# copies of OUTreference/BOOK/book.ranked
+# usage: benchchain.sh [copies] [repeats]
+# the executables are taken from $BINDIR, or else from the PATH
+# when $OLDBINDIR is set, the TICCL-chain from there is timed too, and the
+# outputs of both versions are compared
+
+if [ "$1" != "" ]
+then
+    copies=$1
+else
+    copies=250
+fi
+
+if [ "$2" != "" ]
+then
+    repeats=$2
+else
+    repeats=3
+fi
+
+if [ "$BINDIR" != "" ]
+then
+    bindir=$BINDIR
+else
+    bindir=`dirname \`which TICCL-chain\``
+fi
+
+if [ ! -x $bindir/TICCL-chain ]
+then
+    echo "cannot find executables "
+    exit
+fi
+
+outdir=OUT/benchchain
+refdir=OUTreference/BOOK
+
+mkdir -p $outdir
+
+echo "preparing input file..."
+# every copy gets its own words, by adding the copy number to them
+awk -F'#' -v copies=$copies '
+{ lines[NR] = $0 }
+END {
+  for ( c=1; c <= copies; ++c ){
+    for ( i=1; i <= NR; ++i ){
+      split( lines[i], p, "#" );
+      print p[1] "_" c "#" p[2] "#" p[3] "_" c "#" p[4] "#" p[5] "#" p[6];
+    }
+  }
+}' $refdir/book.ranked > $outdir/big.ranked
+echo "chaining `wc -l < $outdir/big.ranked` ranked records"
+
+# run <bindir> <output name>
+run(){
+    dir=$1
+    name=$2
+    for (( r=1; r<=$repeats; r++ ))
+    do
+	start=`date +%s%N`
+	$dir/TICCL-chain -o $outdir/$name.chained $outdir/big.ranked > /dev/null 2>&1
+	end=`date +%s%N`
+	echo -e "$dir/TICCL-chain\trun $r\t$(( (end-start)/1000000 )) ms"
+    done
+}
+
+run $bindir new
+if [ "$OLDBINDIR" != "" ]
+then
+    run $OLDBINDIR old
+    cmp -s $outdir/new.chained $outdir/old.chained
+    if [ $? -ne 0 ]
+    then
+	echo "chained output differs: $outdir/new.chained $outdir/old.chained"
+    fi
+fi
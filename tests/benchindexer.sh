@@ -0,0 +1,77 @@
+#!/bin/bash
+# thread scaling benchmark for TICCL-indexer and TICCL-indexerNT
+# usage: benchindexer.sh [max_threads]
+# the executables are taken from $BINDIR, or else from the PATH
+
+if [ "$1" != "" ]
+then
+    maxthreads=$1
+else
+    maxthreads=`nproc`
+fi
+
+if [ "$BINDIR" != "" ]
+then
+    bindir=$BINDIR
+else
+    bindir=`dirname \`which TICCL-indexer\``
+fi
+
+if [ ! -x $bindir/TICCL-indexer ]
+then
+    echo "cannot find executables "
+    exit
+fi
+
+outdir=OUT/bench
+datadir=DATA
+foliadir=BOOK
+
+mkdir -p $outdir
+
+echo "preparing input files..."
+cp $datadir/nld.aspell.dict $outdir/dict
+$bindir/TICCL-lexstat --separator=_ --clip=20 --LD=2 $outdir/dict > /dev/null 2>&1
+$bindir/TICCL-stats -R -X -t max -e folia.xml$ -o $outdir/book $foliadir > /dev/null 2>&1
+cp $outdir/book.wordfreqlist.1.tsv $outdir/book.tsv
+$bindir/TICCL-unk --acro --artifrq 0 $outdir/book.tsv > /dev/null 2>&1
+# use the dictionary as background lexicon, so not every anagram value
+# is a focus. Otherwise hits missed near the borders of the chunks would
+# still be found from the other side, and go unnoticed
+awk '{print $0"\t100000000"}' $outdir/dict > $outdir/dict.tsv
+$bindir/TICCL-anahash --alph $outdir/dict.clip20.lc.chars --artifrq 100000000 --background $outdir/dict.tsv $outdir/book.tsv.clean > /dev/null 2>&1
+
+if [ $? -ne 0 ]
+then
+    echo "failed to create input files"
+    exit
+fi
+
+# run <program> <extension>
+run(){
+    prog=$1
+    ext=$2
+    for (( t=1; t<=$maxthreads; t++ ))
+    do
+	start=`date +%s%N`
+	$bindir/$prog -t $t --hash $outdir/book.tsv.clean.anahash --charconf $outdir/dict.clip20.ld2.charconfus --foci $outdir/book.tsv.clean.corpusfoci -o $outdir/t$t > /dev/null 2>&1
+	status=$?
+	end=`date +%s%N`
+	echo -e "$prog\tthreads=$t\t$(( (end-start)/1000000 )) ms"
+	if [ $status -ne 0 ]
+	then
+	    echo "$prog failed with $t threads"
+	fi
+	if [ $t -gt 1 ]
+	then
+	    cmp -s $outdir/t1.$ext $outdir/t$t.$ext
+	    if [ $? -ne 0 ]
+	    then
+		echo "output differs from the 1 thread run: $outdir/t$t.$ext"
+	    fi
+	fi
+    done
+}
+
+run TICCL-indexerNT indexNT
+run TICCL-indexer index
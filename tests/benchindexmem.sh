@@ -0,0 +1,94 @@
+#!/bin/bash
+# memory benchmark for the result storage of TICCL-indexer and
+# TICCL-indexerNT: the result vectors against the roaring bitmaps (--roaring)
+# usage: benchindexmem.sh [threads]
+# the executables are taken from $BINDIR, or else from the PATH
+# the input files are those made by benchindexer.sh, run that one first
+# the peak memory use (RSS) is measured with GNU time (/usr/bin/time), or
+# else with python3. Without both, it is not reported
+
+if [ "$1" != "" ]
+then
+    threads=$1
+else
+    threads=1
+fi
+
+if [ "$BINDIR" != "" ]
+then
+    bindir=$BINDIR
+else
+    bindir=`dirname \`which TICCL-indexer\``
+fi
+
+if [ ! -x $bindir/TICCL-indexer ]
+then
+    echo "cannot find executables "
+    exit
+fi
+
+indir=OUT/bench
+outdir=OUT/benchmem
+
+if [ ! -f $indir/book.tsv.clean.anahash ]
+then
+    echo "cannot find input files, run benchindexer.sh first"
+    exit
+fi
+
+mkdir -p $outdir
+
+# run <program> <label> <options>
+run(){
+    prog=$1
+    label=$2
+    shift 2
+    cmd=( $bindir/$prog -t $threads "$@" --hash $indir/book.tsv.clean.anahash --charconf $indir/dict.clip20.ld2.charconfus --foci $indir/book.tsv.clean.corpusfoci -o $outdir/$label )
+    start=`date +%s%N`
+    if [ -x /usr/bin/time ]
+    then
+	/usr/bin/time -f "%M" -o $outdir/$label.rss "${cmd[@]}" > /dev/null 2>&1
+	rss="`cat $outdir/$label.rss` KB"
+    elif which python3 > /dev/null 2>&1
+    then
+	# ru_maxrss of the children, in KB on Linux
+	python3 -c 'import resource,subprocess,sys
+subprocess.call(sys.argv[2:],stdout=subprocess.DEVNULL,stderr=subprocess.DEVNULL)
+open(sys.argv[1],"w").write("%d\n" % resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss)' $outdir/$label.rss "${cmd[@]}"
+	rss="`cat $outdir/$label.rss` KB"
+    else
+	"${cmd[@]}" > /dev/null 2>&1
+	rss="unknown"
+    fi
+    end=`date +%s%N`
+    echo -e "$prog\t$label\t$(( (end-start)/1000000 )) ms\tpeak RSS: $rss"
+}
+
+# compare <file1> <file2>
+compare(){
+    cmp -s $1 $2
+    if [ $? -ne 0 ]
+    then
+	echo "results differ: $1 $2"
+    fi
+}
+
+run TICCL-indexer vector
+run TICCL-indexerNT vector
+$bindir/TICCL-indexer --help 2>&1 | grep -q roaring
+if [ $? -ne 0 ]
+then
+    echo "no roaring support, no bitmaps to compare with"
+    exit
+fi
+run TICCL-indexer text --roaring --text
+run TICCL-indexer roaring --roaring
+compare $outdir/vector.index $outdir/text.index
+run TICCL-indexerNT text --roaring --text
+run TICCL-indexerNT roaring --roaring
+compare $outdir/vector.indexNT $outdir/text.indexNT
+if [ -x $bindir/TICCL-indexerNT-roaring ]
+then
+    run TICCL-indexerNT-roaring old-roaring
+    compare $outdir/roaring.indexNT.R $outdir/old-roaring.indexNT.R
+fi
@@ -0,0 +1,78 @@
+#!/bin/bash
+# benchmark for TICCL-rank on a large LDcalc file, created from DATA and BOOK
+# usage: benchrank.sh [repeats]
+# the executables are taken from $BINDIR, or else from the PATH
+# when $OLDBINDIR is set, the TICCL-rank from there is timed too, and the
+# outputs of both versions are compared
+
+if [ "$1" != "" ]
+then
+    repeats=$1
+else
+    repeats=3
+fi
+
+if [ "$BINDIR" != "" ]
+then
+    bindir=$BINDIR
+else
+    bindir=`dirname \`which TICCL-rank\``
+fi
+
+if [ ! -x $bindir/TICCL-rank ]
+then
+    echo "cannot find executables "
+    exit
+fi
+
+outdir=OUT/benchrank
+datadir=DATA
+foliadir=BOOK
+
+mkdir -p $outdir
+
+echo "preparing input files..."
+cp $datadir/nld.aspell.dict $outdir/dict
+$bindir/TICCL-lexstat --separator=_ --clip=20 --LD=2 $outdir/dict > /dev/null 2>&1
+$bindir/TICCL-stats -R -X -t max -e folia.xml$ -o $outdir/book $foliadir > /dev/null 2>&1
+cp $outdir/book.wordfreqlist.1.tsv $outdir/book.tsv
+$bindir/TICCL-unk --acro --artifrq 0 $outdir/book.tsv > /dev/null 2>&1
+$bindir/TICCL-anahash --alph $outdir/dict.clip20.lc.chars --artifrq 100000000 $outdir/book.tsv.clean > /dev/null 2>&1
+$bindir/TICCL-indexer -t max --hash $outdir/book.tsv.clean.anahash --charconf $outdir/dict.clip20.ld2.charconfus --foci $outdir/book.tsv.clean.corpusfoci -o $outdir/book > /dev/null 2>&1
+$bindir/TICCL-LDcalc --index $outdir/book.index --hash $outdir/book.tsv.clean.anahash --clean $outdir/book.tsv.clean --alph $outdir/dict.clip20.lc.chars --LD 3 -t max --artifrq 100000000 -o $outdir/book.ldcalc > /dev/null 2>&1
+
+if [ $? -ne 0 ]
+then
+    echo "failed to create input files"
+    exit
+fi
+echo "ranking `wc -l < $outdir/book.ldcalc` LDcalc records"
+
+# run <bindir> <output name>
+run(){
+    dir=$1
+    name=$2
+    for (( r=1; r<=$repeats; r++ ))
+    do
+	start=`date +%s%N`
+	$dir/TICCL-rank --alph $outdir/dict.clip20.lc.chars --charconf $outdir/dict.clip20.ld2.charconfus -o $outdir/$name --debugfile $outdir/$name.debug --artifrq 0 --clip 5 --skipcols=10,11 $outdir/book.ldcalc > /dev/null 2>&1
+	end=`date +%s%N`
+	echo -e "$dir/TICCL-rank\trun $r\t$(( (end-start)/1000000 )) ms"
+    done
+}
+
+run $bindir new
+if [ "$OLDBINDIR" != "" ]
+then
+    run $OLDBINDIR old
+    cmp -s $outdir/new.ranked $outdir/old.ranked
+    if [ $? -ne 0 ]
+    then
+	echo "ranked output differs: $outdir/new.ranked $outdir/old.ranked"
+    fi
+    cmp -s $outdir/new.debug $outdir/old.debug
+    if [ $? -ne 0 ]
+    then
+	echo "debug output differs: $outdir/new.debug $outdir/old.debug"
+    fi
+fi
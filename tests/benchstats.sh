@@ -0,0 +1,88 @@
+#!/bin/bash
+# benchmark for the XML input of TICCL-stats: the streaming reader against
+# the DOM reader (--dom), on one large FoLiA file made from the BOOK files
+# usage: benchstats.sh [copies] [threads]
+# the executables are taken from $BINDIR, or else from the PATH
+# the peak memory use (RSS) is only reported when GNU time is available as
+# /usr/bin/time
+
+if [ "$1" != "" ]
+then
+    copies=$1
+else
+    copies=12
+fi
+
+if [ "$2" != "" ]
+then
+    threads=$2
+else
+    threads=1
+fi
+
+if [ "$BINDIR" != "" ]
+then
+    bindir=$BINDIR
+else
+    bindir=`dirname \`which TICCL-stats\``
+fi
+
+if [ ! -x $bindir/TICCL-stats ]
+then
+    echo "cannot find executables "
+    exit
+fi
+
+outdir=OUT/benchstats
+foliadir=BOOK
+
+mkdir -p $outdir/in
+
+echo "preparing input file..."
+first=`ls $foliadir/*.folia.xml | head -1`
+big=$outdir/in/big.folia.xml
+sed -n '1,/<text /p' $first > $big
+# the texts of all BOOK files, 'copies' times. Without the xml:id
+# attributes, as these would not be unique anymore
+for (( c=1; c<=$copies; c++ ))
+do
+    for f in $foliadir/*.folia.xml
+    do
+	sed -e '1,/<text /d' -e '/<\/text>/,$d' -e 's/ xml:id="[^"]*"//g' $f
+    done
+done >> $big
+echo "  </text>" >> $big
+echo "</FoLiA>" >> $big
+# the same contents, as separate files, for the threads
+for (( t=2; t<=$threads; t++ ))
+do
+    cp $big $outdir/in/big$t.folia.xml
+done
+bytes=`cat $outdir/in/*.folia.xml | wc -c`
+echo "counting $(( bytes/1000000 )) MB of FoLiA on $threads thread(s)"
+
+# run <label> <options>
+run(){
+    label=$1
+    shift
+    start=`date +%s%N`
+    if [ -x /usr/bin/time ]
+    then
+	/usr/bin/time -f "%M" -o $outdir/$label.rss $bindir/TICCL-stats -X -t $threads "$@" -e folia.xml$ -o $outdir/$label $outdir/in > /dev/null 2>&1
+	rss="`cat $outdir/$label.rss` KB"
+    else
+	$bindir/TICCL-stats -X -t $threads "$@" -e folia.xml$ -o $outdir/$label $outdir/in > /dev/null 2>&1
+	rss="unknown"
+    fi
+    end=`date +%s%N`
+    ms=$(( (end-start)/1000000 ))
+    echo -e "$label\t$ms ms\t$(( bytes/1000/(ms+1) )) MB/s\tpeak RSS: $rss"
+}
+
+run stream
+run dom --dom
+cmp -s $outdir/stream.wordfreqlist.1.tsv $outdir/dom.wordfreqlist.1.tsv
+if [ $? -ne 0 ]
+then
+    echo "results differ: $outdir/stream.wordfreqlist.1.tsv $outdir/dom.wordfreqlist.1.tsv"
+fi
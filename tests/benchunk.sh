@@ -0,0 +1,102 @@
+#!/bin/bash
+# end-to-end benchmark for TICCL-unk and TICCL-lexclean on a large lexicon,
+# made of the words of DATA/nld.aspell.dict with all kinds of variations
+# usage: benchunk.sh [entries] [threads]
+# the executables are taken from $BINDIR, or else from the PATH
+# when $OLDBINDIR is set, the executables from there are timed too, and the
+# outputs of both versions are compared
+
+if [ "$1" != "" ]
+then
+    entries=$1
+else
+    entries=10000000
+fi
+
+if [ "$2" != "" ]
+then
+    threads=$2
+else
+    threads=1
+fi
+# older versions of TICCL-unk have no -t option
+if [ $threads -ne 1 ]
+then
+    topt="-t $threads"
+fi
+
+if [ "$BINDIR" != "" ]
+then
+    bindir=$BINDIR
+else
+    bindir=`dirname \`which TICCL-unk\``
+fi
+
+if [ ! -x $bindir/TICCL-unk ] || [ ! -x $bindir/TICCL-lexclean ]
+then
+    echo "cannot find executables "
+    exit
+fi
+
+outdir=OUT/benchunk
+datadir=DATA
+alphabet=OUTreference/BOOK/dict.lc.chars
+
+mkdir -p $outdir
+
+echo "preparing input file..."
+# cycle through the dictionary, adding numbers, capitals and punctuation
+awk -v entries=$entries '
+{ words[NR] = $1 }
+END {
+  n = 0;
+  for ( c=1; n < entries; ++c ){
+    for ( i=1; i <= NR && n < entries; ++i ){
+      w = words[i];
+      f = (i*c) % 997 + 1;
+      if ( c % 5 == 1 ) print w c "\t" f;
+      else if ( c % 5 == 2 ) print toupper(substr(w,1,1)) substr(w,2) "_" c "\t" f;
+      else if ( c % 5 == 3 ) print "," w c "-\t" f;
+      else if ( c % 5 == 4 ) print w "." c "\t" f;
+      else print w "#" c "\t" f;
+      ++n;
+    }
+  }
+}' $datadir/nld.aspell.dict > $outdir/big.tsv
+echo "a lexicon of `wc -l < $outdir/big.tsv` entries"
+# for TICCL-lexclean: the letters, the digits and '_' are clean
+cp $alphabet $outdir/alphabet
+for c in 0 1 2 3 4 5 6 7 8 9 _
+do
+    echo -e "$c\t1\t1" >> $outdir/alphabet
+done
+
+# run <bindir> <output dir>
+run(){
+    dir=$1
+    name=$2
+    mkdir -p $outdir/$name
+    ln -sf ../big.tsv $outdir/$name/big.tsv
+    start=`date +%s%N`
+    $dir/TICCL-unk $topt --background $datadir/nld.aspell.dict --artifrq 100000000 --acro -o $outdir/$name/unk $outdir/big.tsv > /dev/null 2>&1
+    end=`date +%s%N`
+    echo -e "$dir/TICCL-unk\t$(( (end-start)/1000000 )) ms"
+    start=`date +%s%N`
+    $dir/TICCL-lexclean -a $outdir/alphabet $outdir/$name/big.tsv > /dev/null 2>&1
+    end=`date +%s%N`
+    echo -e "$dir/TICCL-lexclean\t$(( (end-start)/1000000 )) ms"
+}
+
+run $bindir new
+if [ "$OLDBINDIR" != "" ]
+then
+    run $OLDBINDIR old
+    for f in unk.clean unk.fore.clean unk.unk unk.punct unk.acro big.tsv.cleaned big.tsv.dirty
+    do
+	cmp -s $outdir/new/$f $outdir/old/$f
+	if [ $? -ne 0 ]
+	then
+	    echo "output differs: $outdir/new/$f $outdir/old/$f"
+	fi
+    done
+fi